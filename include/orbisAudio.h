@@ -10,6 +10,7 @@
 
 #pragma once
 #include <stdint.h>
+#include <stddef.h>
 
 //#include <types/kernel.h>  // ScePthread and (not really needed) "friends"
 #include <pthread.h>         // posix threads and standard friends
@@ -28,12 +29,54 @@ extern "C" {
 #define ORBISAUDIO_CHANNEL_VOICE		2
 #define ORBISAUDIO_CHANNEL_PERSONAL		3
 #define ORBISAUDIO_CHANNEL_AUX			4
-#define ORBISAUDIO_NUM_BUFFERS			2
+#define ORBISAUDIO_CHANNEL_MASTER		5 // mixer output, only valid in mixer mode
+#define ORBISAUDIO_NUM_BUFFERS			2 // default queue depth
+#define ORBISAUDIO_MIN_BUFFERS			2
+#define ORBISAUDIO_MAX_BUFFERS			8
 #define ORBISAUDIO_VOLUME_MAX			32768
 #define ORBISAUDIO_VOLUME_FLAG_LEFT_CHANNEL	0
 #define ORBISAUDIO_VOLUME_FLAG_RIGHT_CHANNEL	1
 #define ORBISAUDIO_FORMAT_S16_MONO		0
 #define ORBISAUDIO_FORMAT_S16_STEREO		1
+#define ORBISAUDIO_FORMAT_S16_8CH		2 // L R C LFE Ls Rs Lb Rb, ITU downmixed to a stereo port; 5.1 leaves Lb Rb silent
+#define ORBISAUDIO_FORMAT_FLOAT_MONO		3 // float formats are converted to s16 by the library
+#define ORBISAUDIO_FORMAT_FLOAT_STEREO		4
+#define ORBISAUDIO_FORMAT_FLOAT_8CH		5
+#define ORBISAUDIO_FORMAT_FLOAT_STEREO_PLANAR	8 // all left samples of a block, then all right samples
+#define ORBISAUDIO_OUTPUT_FREQUENCY		48000 // ports always run at this rate, other rates are resampled
+#define ORBISAUDIO_RESAMPLE_FAST		0 // 8 taps
+#define ORBISAUDIO_RESAMPLE_MEDIUM		1 // 16 taps
+#define ORBISAUDIO_RESAMPLE_BEST		2 // 32 taps
+#define ORBISAUDIO_BACKEND_DEFAULT		0 // sce on PS4, libao with HAVE_LIBAO, null otherwise
+#define ORBISAUDIO_BACKEND_SCE			1
+#define ORBISAUDIO_BACKEND_LIBAO		2
+#define ORBISAUDIO_BACKEND_NULL			3 // discards blocks, paced in real time
+#define ORBISAUDIO_BACKEND_NULL_FAST		4 // discards blocks as fast as possible
+#define ORBISAUDIO_BACKEND_WAV			5 // one wav file per port
+#define ORBISAUDIO_BACKEND_OFFLINE		6 // no audio threads, orbisAudioRenderOffline renders on the calling thread
+#define ORBISAUDIO_PACING_POLL			0 // legacy: fixed 1 ms sleep after every block
+#define ORBISAUDIO_PACING_DEADLINE		1 // sleep until the next block is due
+#define ORBISAUDIO_PACING_BLOCKING		2 // no sleep, rely on the blocking output call
+#define ORBISAUDIO_ARENA_CHANNEL_SIZE		(512 * 1024) // default arena bytes per channel: queue, resampler and ring
+#define ORBISAUDIO_ARENA_LOCK			1 // lock the arena in memory
+#define ORBISAUDIO_MAX_VOICES			1024 // per channel
+#define ORBISAUDIO_STREAM_CHUNK_BYTES		(32 * 1024) // one read of the stream thread
+#define ORBISAUDIO_STREAM_CHUNKS		4 // chunks read ahead, from the channel's arena region
+#define ORBISAUDIO_STREAM_MMAP			1 // map the file instead of reading it
+#define ORBISAUDIO_STREAM_LOOP			2 // loop the file, over its smpl loop if it has one
+#define ORBISAUDIO_RATE_MAX_PPM			5000 // rate control never moves the resampling ratio further than 0.5%
+#define ORBISAUDIO_VOLUME_RAMP_MS		10 // default time a volume change takes
+#define ORBISAUDIO_FADE_MS			5 // pause fades out and resume fades in over this long
+#define ORBISAUDIO_CONTROL_QUEUE		32 // pause, resume, volume and callback changes waiting for a block boundary, power of two
+#define ORBISAUDIO_DSP_BANDS			8 // biquads in a DSP chain
+#define ORBISAUDIO_DSP_LOOKAHEAD		64 // frames the limiter sees ahead, also the latency it adds
+#define ORBISAUDIO_EQ_OFF			0
+#define ORBISAUDIO_EQ_PEAK			1
+#define ORBISAUDIO_EQ_LOWSHELF			2
+#define ORBISAUDIO_EQ_HIGHSHELF			3
+#define ORBISAUDIO_EQ_LOWPASS			4
+#define ORBISAUDIO_EQ_HIGHPASS			5
+#define ORBISAUDIO_TAP_BLOCKS			16 // default blocks an output tap holds for its writer thread
 
 typedef struct OrbisAudioStereoSample
 {
@@ -46,29 +89,239 @@ typedef struct OrbisAudioMonoSample
   short ch;
 } OrbisAudioMonoSample;
 
+typedef struct OrbisAudioSurroundSample
+{
+  short l;
+  short r;
+  short c;
+  short lfe;
+  short ls;
+  short rs;
+  short lb;
+  short rb;
+} OrbisAudioSurroundSample;
+
 typedef union OrbisAudioSample
 {
   OrbisAudioStereoSample stereo;
   OrbisAudioMonoSample mono;
+  OrbisAudioSurroundSample surround;
 } OrbisAudioSample;
 
 typedef void (*OrbisAudioCallback)(OrbisAudioSample *buffer,unsigned int samples,void *user_data);
+// receives every block an output tap recorded, s16 in the port format, on the tap writer thread
+typedef void (*OrbisAudioTapSink)(const short *buf, unsigned int frames, unsigned int channels, void *user_data);
+// receives every block orbisAudioRenderOffline renders, for channel or ORBISAUDIO_CHANNEL_MASTER, on the calling thread
+typedef void (*OrbisAudioOfflineSink)(unsigned int channel, const short *buf, unsigned int frames, unsigned int channels, void *user_data);
+
+#define ORBISAUDIO_STATS_BUCKETS		16 // bucket 0: < 1 us, bucket k: [2^(k-1), 2^k) us, last one open ended
+
+// written only by the channel (or mixer) thread, readable at any time with orbisAudioGetStats
+typedef struct OrbisAudioStats
+{
+	uint64_t blocksPlayed;
+	uint64_t underruns;         // push ring ran dry, block padded with silence
+	uint64_t lateDeadlines;     // wakeups a whole block or more behind the deadline
+	uint64_t callbackHist[ORBISAUDIO_STATS_BUCKETS];  // callback execution time, log2 us
+	uint64_t submitHist[ORBISAUDIO_STATS_BUCKETS];    // start of rendering a block to its submit, log2 us
+	uint64_t outputBlockedUs;   // total time spent inside the output call
+	uint64_t maxLatenessUs;
+	uint64_t meanLatenessUs;    // filled in by orbisAudioGetStats
+	uint64_t latenessSumUs;
+	uint64_t latenessCount;
+	uint64_t voicesStolen;      // voices cut short to start a new one on a full pool
+	uint64_t tapBlocks;         // blocks handed to the output tap
+	uint64_t tapDropped;        // blocks the output tap missed, its writer was behind
+} OrbisAudioStats;
+
+// playback position of a port, see orbisAudioGetClock
+typedef struct OrbisAudioClock
+{
+	uint64_t samples;        // played out at timeUs, at the port rate
+	uint64_t timeUs;         // orbisAudioGetTimeUs of the submit it was taken at
+	unsigned int queued;     // submitted but not yet played at timeUs
+	unsigned int frequency;  // port rate
+} OrbisAudioClock;
+
+typedef struct OrbisAudioRing
+{
+	short *data;
+	unsigned int frames;     // capacity, power of two
+	unsigned int frameSize;  // shorts per frame
+	// free running counters, each written by one side only, kept on separate cache lines
+	unsigned int head __attribute__((aligned(64)));
+	unsigned int tail __attribute__((aligned(64)));
+} OrbisAudioRing;
+
+/*
+ * Sound encodings. IMA ADPCM comes in blocks of ORBISAUDIO_ADPCM_BLOCK_FRAMES
+ * frames, each one a 4 byte header per channel (s16 predictor, step index,
+ * pad) then every channel's 4 bit codes in turn, low nibble first. Made with
+ * orbisAudioAdpcmEncode, decoded by the voice pool as it plays.
+ */
+#define ORBISAUDIO_ENCODING_PCM16		0 // s16, channels interleaved
+#define ORBISAUDIO_ENCODING_ADPCM		1
+#define ORBISAUDIO_ADPCM_BLOCK_FRAMES	256
+
+// one pending control change, see orbisAudioControl.c
+typedef struct OrbisAudioControl
+{
+	uint32_t stamp;          // lap of the queue the slot is free for, plus one once it is filled
+	int type;
+	unsigned int l;
+	unsigned int r;
+	OrbisAudioCallback callback;
+	void *userData;
+} OrbisAudioControl;
+
+// one shot or looping sample data for the voice pool, owned by the caller while voices use it
+typedef struct OrbisAudioSound
+{
+	const short *data;       // as encoding says, ADPCM blocks are cast to short
+	unsigned int frames;
+	unsigned int frequency;
+	unsigned int channels;   // 1 or 2
+	unsigned int encoding;   // ORBISAUDIO_ENCODING_*
+	unsigned int loopStart;  // frame a looping voice jumps back to at the end
+	unsigned int loopEnd;    // frame after the loop, 0 for the end of the sound
+	int priority;            // a full pool steals voices of lower or equal priority
+} OrbisAudioSound;
+
+// listener for orbisAudioEmitterUpdate, right handed: right is forward x up
+typedef struct OrbisAudioListener
+{
+	float position[3];
+	float velocity[3];       // units per second
+	float forward[3];
+	float up[3];
+	float minDistance;       // full gain up to here, above 0
+	float maxDistance;       // attenuation stops here
+	float rolloff;           // inverse distance rolloff, 1 halves the gain at twice minDistance
+	float speedOfSound;      // in the same units, 0 turns Doppler off
+} OrbisAudioListener;
+
+// emitters as arrays of count, one per playing voice; the optional arrays may be NULL
+typedef struct OrbisAudioEmitters
+{
+	const int *voices;       // handles from orbisAudioVoicePlay
+	const float *x, *y, *z;  // positions
+	const float *vx, *vy, *vz; // velocities, optional
+	const float *gain;       // optional, 1 when NULL
+	const float *pitch;      // optional, 1 when NULL, scaled by Doppler
+	unsigned int count;
+} OrbisAudioEmitters;
+
+/*
+ * Sound bank file, little endian. A header, an index of count entries at
+ * indexOffset, then every payload 64 byte aligned. Built offline with
+ * tools/orbisAudioBankPack, mapped and played in place at runtime.
+ */
+#define ORBISAUDIO_BANK_MAGIC			0x4b42414f // "OABK"
+#define ORBISAUDIO_BANK_VERSION			1
+#define ORBISAUDIO_BANK_ALIGN			64
+#define ORBISAUDIO_BANK_NAME_LEN		32
+
+typedef struct OrbisAudioBankHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t count;
+	uint32_t indexOffset;
+	uint64_t size;           // whole file
+	uint8_t  reserved[40];
+} OrbisAudioBankHeader;
+
+typedef struct OrbisAudioBankEntry
+{
+	char     name[ORBISAUDIO_BANK_NAME_LEN]; // nul terminated
+	uint64_t offset;         // payload, from the start of the file
+	uint32_t bytes;
+	uint32_t frames;
+	uint32_t frequency;
+	uint16_t channels;
+	uint16_t format;         // ORBISAUDIO_ENCODING_*
+	uint32_t loopStart;
+	uint32_t loopEnd;        // 0 when the sound doesn't loop
+	int32_t  priority;
+	uint32_t reserved;
+} OrbisAudioBankEntry;
+
+typedef struct OrbisAudioBank OrbisAudioBank;
+
+typedef struct OrbisAudioVoicePool OrbisAudioVoicePool;
+typedef struct OrbisAudioStream OrbisAudioStream;
+typedef struct OrbisAudioResampler OrbisAudioResampler;
+typedef struct OrbisAudioDsp OrbisAudioDsp;
+typedef struct OrbisAudioTap OrbisAudioTap;
+typedef void (*OrbisAudioResamplerPullFn)(short *buf, unsigned int frames, void *ctx);
 
 typedef struct OrbisAudioChannel
 {
 	//ScePthread threadHandle;
 	pthread_t threadHandle;
+	unsigned int index;      // ORBISAUDIO_CHANNEL_*, lets the thread find its own context
 	int audioHandle;
 	unsigned int leftVol;
 	unsigned int rightVol;
 	OrbisAudioCallback callback;
 	void *userData;
-	short *sampleBuffer[2];
-	unsigned int samples[2];
+	short *sampleBuffer[ORBISAUDIO_MAX_BUFFERS];
+	unsigned int samples[ORBISAUDIO_MAX_BUFFERS];
+	unsigned int numBuffers; // one held by the device, one rendering, the rest queued
+	OrbisAudioRing *ring;    // push API source, used when there is no callback
+	OrbisAudioResampler *resampler; // source rate to port rate, NULL when they match
+	OrbisAudioVoicePool *voices;    // sound effects mixed on top of the callback or ring
+	OrbisAudioStream *stream;       // file streamed by the read ahead thread, used when there is no callback or ring
+	OrbisAudioDsp *dsp;             // insert chain run on every block after the channel gain, NULL when there is none
+	OrbisAudioTap *tap;             // records the blocks submitted, NULL until a tap is opened
+	unsigned int sourceFrequency;
+	int resampleQuality;
 	unsigned char paused;
-	unsigned char stereo;
+	unsigned char stereo;    // port format, always s16
+	unsigned char format;    // ORBISAUDIO_FORMAT_* the callback, ring or caller blocks are in
+	unsigned char upmix;     // mono source played on a stereo port
+	unsigned int rateTarget; // ring fill in frames rate control holds, 0 when it is off
+	int ratePpm;             // current ratio adjustment, input consumed faster when positive
+	unsigned int rateFill;   // smoothed ring fill the controller last saw
+	float rateFillAvg;       // controller state, only touched by the rendering thread
+	float rateInteg;
+	float *convertBuffer;    // source block before conversion, float formats only
+	uint32_t dither[8];      // TPDF dither generator state
+	unsigned char stop;      // stops this channel's thread only
+	unsigned char offline;   // rendered by orbisAudioRenderOffline instead of a thread
+	unsigned char callerDriven; // blocks come from orbisAudioPlayBlock, never from a callback
 	unsigned int currentBuffer;
 	int orbisaudiochannel_initialized;
+	unsigned int frequency;
+	int pacing;
+	uint64_t nextDeadline;   // monotonic us when the next block is due
+	uint64_t lastLateness;   // us between deadline and actual wakeup
+	uint64_t blocks;         // blocks submitted so far
+	uint64_t renderStart[ORBISAUDIO_MAX_BUFFERS];  // when each queued block started rendering
+	OrbisAudioStats stats;
+	uint32_t clockSeq;       // seqlock over the clock, odd while the submitting thread updates it
+	uint64_t clockSamples;   // played out when the last block was submitted
+	uint64_t clockTimeUs;
+	unsigned int clockQueued;
+	uint64_t clockSubmitted; // samples handed to the port, only touched by the submitting thread
+	OrbisAudioControl control[ORBISAUDIO_CONTROL_QUEUE]; // filled by any thread, applied by the one rendering the channel
+	uint32_t controlHead;    // tickets handed out to callers
+	uint32_t controlTail;    // next command to apply, rendering thread only
+	uint32_t controlDone;    // commands applied so far
+	unsigned int rampMs;     // time a volume change takes
+	unsigned int volFrom[2]; // volume ramp from here to leftVol/rightVol, at the port rate
+	unsigned int volPos;
+	unsigned int volFrames;
+	unsigned int fadeFrom;   // pause/resume fade, ORBISAUDIO_VOLUME_MAX is fully in
+	unsigned int fadeTo;
+	unsigned int fadePos;
+	unsigned int fadeFrames;
+	unsigned char pausing;   // fading out, paused when the fade ends
+	OrbisAudioCallback xfadeCallback; // callback fading in over the current one, at the source rate
+	void *xfadeUserData;
+	unsigned int xfadePos;
+	unsigned int xfadeFrames;
+	short *crossfadeBuffer;  // one port format block of the incoming callback
 }OrbisAudioChannel;
 
 typedef struct OrbisAudioConfig
@@ -76,24 +329,148 @@ typedef struct OrbisAudioConfig
 	OrbisAudioChannel *channels[ORBISAUDIO_CHANNELS];
 	unsigned char orbisaudio_stop;
 	int orbisaudio_initialized;
+	OrbisAudioChannel *master;   // mixer output port, NULL unless in mixer mode
+	unsigned int masterVol;      // last orbisAudioSetMasterVolume, the mixer ramps to it
 } OrbisAudioConfig;
 
 
+int orbisAudioSetBackend(int backend, const char *path); // before orbisAudioInit, path is for the wav sink and may hold a %d
+int orbisAudioSetArena(void *mem, size_t size, int flags); // before orbisAudioInit, mem NULL allocates size bytes once
+size_t orbisAudioGetArenaSize(size_t channelBytes);
 int orbisAudioInit();
 void orbisAudioFinish();
 int orbisAudioGetStatus();
 int orbisAudioGetChannelStatus(int chan);
 int orbisAudioGetHandle(int chan);
 int orbisAudioPlayBlock(unsigned int channel,unsigned int vol1,unsigned int vol2,void *buf);
+// caller driven: blocks go out as handed to orbisAudioPlayBlock, so frequency must be ORBISAUDIO_OUTPUT_FREQUENCY
 int orbisAudioInitChannelWithoutCallback(unsigned int channel, unsigned int samples, unsigned int frequency, int format);
 int orbisAudioInitChannel(unsigned int channel, unsigned int samples, unsigned int frequency, int format);
+// pause, resume, callback, pacing and volume changes are queued and return a sequence number, 0 on error
 int orbisAudioPause(unsigned int channel);
 int orbisAudioResume(unsigned int channel);
 int orbisAudioStop();
+int orbisAudioFinishChannel(unsigned int channel);
 int orbisAudioSetCallback(unsigned int channel,OrbisAudioCallback callback,void *userdata);
+int orbisAudioSetPacing(unsigned int channel, int mode);
+int orbisAudioSetVolume(unsigned int channel, unsigned int l, unsigned int r);
+int orbisAudioSetVolumeRamp(unsigned int channel, unsigned int ms);
+// fades to a new callback, so not on channels fed by orbisAudioPlayBlock: those get 0
+int orbisAudioCrossfade(unsigned int channel, OrbisAudioCallback callback, void *userdata, unsigned int ms);
+int orbisAudioControlDone(unsigned int channel, int seq);
+int orbisAudioControlWait(unsigned int channel, int seq);
+int orbisAudioSetNumBuffers(unsigned int channel, unsigned int num);
+int orbisAudioGetLatency(unsigned int channel, unsigned int *samples, unsigned int *usec);
+int orbisAudioGetStats(unsigned int channel, OrbisAudioStats *stats);
+// audio clock, lock free from any thread: samples played at a timestamp, and extrapolated to now
+uint64_t orbisAudioGetTimeUs(void);
+int orbisAudioGetClock(unsigned int channel, OrbisAudioClock *clock);
+uint64_t orbisAudioGetPlayedSamples(unsigned int channel);
+int orbisAudioSetResampleQuality(unsigned int channel, int quality);
+int orbisAudioSetUpmix(unsigned int channel, int upmix);
+// rate control: a ring fed on the producer's own clock is resampled by up to ORBISAUDIO_RATE_MAX_PPM to hold its fill at target
+int orbisAudioSetRateControl(unsigned int channel, unsigned int targetFrames);
+int orbisAudioGetRateControl(unsigned int channel, float *ratio, unsigned int *fill);
+
+// push API: feed a channel from any one producer thread instead of a callback
+int orbisAudioInitRing(unsigned int channel, unsigned int frames);
+int orbisAudioPushSamples(unsigned int channel, const void *buf, unsigned int n);
+int orbisAudioGetRingFill(unsigned int channel);
+int orbisAudioGetRingFree(unsigned int channel);
 int orbisAudioInitWithConf(OrbisAudioConfig *conf);
 OrbisAudioConfig *orbisAudioGetConf();
 
+// offline backend: render seconds of every channel, or of the mixer, as fast as the cpu allows; the same calls
+// between renders give the same samples. Returns the frames rendered per channel, whole blocks
+int orbisAudioRenderOffline(double seconds, OrbisAudioOfflineSink sink, void *userdata);
+
+// mixer mode: channels initialized after this are summed into one stereo port by one thread; the port
+// runs at ORBISAUDIO_OUTPUT_FREQUENCY whatever frequency says, inputs at other rates are resampled
+int orbisAudioInitMixer(unsigned int samples, unsigned int frequency);
+// queued and ramped like orbisAudioSetVolume, orbisAudioSetVolumeRamp(ORBISAUDIO_CHANNEL_MASTER, ms) sets the ramp
+int orbisAudioSetMasterVolume(unsigned int vol);
+
+// voice pool: sound effects mixed into a channel by its own thread, driven from any one game thread
+int orbisAudioInitVoices(unsigned int channel, unsigned int voices);
+int orbisAudioVoicePlay(unsigned int channel, const OrbisAudioSound *sound, float gain, float pan, float pitch, int loop);
+int orbisAudioVoiceSet(unsigned int channel, int voice, float gain, float pan, float pitch);
+int orbisAudioVoiceStop(unsigned int channel, int voice);
+int orbisAudioVoiceIsPlaying(unsigned int channel, int voice);
+// 3D emitters: distance attenuation, equal power pan and Doppler for every emitter in one pass, applied to
+// their voices like orbisAudioVoiceSet from the same thread; returns the emitters queued, fewer when the queue is full
+int orbisAudioEmitterUpdate(unsigned int channel, const OrbisAudioListener *listener, const OrbisAudioEmitters *emitters);
+int orbisAudioEmitterCompute(const OrbisAudioListener *listener, const OrbisAudioEmitters *emitters, float *gainL, float *gainR, float *pitch);
+int orbisAudioEmitterComputeRef(const OrbisAudioListener *listener, const OrbisAudioEmitters *emitters, float *gainL, float *gainR, float *pitch);
+
+// DSP insert chain: DC blocker, EQ and limiter on every block a channel or the mixer renders, or a caller driven channel
+// is handed by orbisAudioPlayBlock, any one thread changes its settings;
+// chains from orbisAudioDspCreate run wherever orbisAudioDspProcess is called
+OrbisAudioDsp *orbisAudioInitDsp(unsigned int channel);
+OrbisAudioDsp *orbisAudioDspCreate(unsigned int frequency, unsigned int channels, unsigned int maxFrames);
+void orbisAudioDspDestroy(OrbisAudioDsp *dsp);
+int orbisAudioDspSetEq(OrbisAudioDsp *dsp, unsigned int band, int type, float frequency, float gainDb, float q);
+int orbisAudioDspSetLimiter(OrbisAudioDsp *dsp, int enable, float ceilingDb, float releaseMs);
+int orbisAudioDspSetDcBlock(OrbisAudioDsp *dsp, int enable);
+int orbisAudioDspSetBypass(OrbisAudioDsp *dsp, int bypass);
+void orbisAudioDspProcess(OrbisAudioDsp *dsp, short *buf, unsigned int frames);
+
+// output tap: records every block a channel, mixer input or the master submits, after gain and DSP, without
+// copying it on the audio thread; a writer thread of its own drains it to a wav file or a sink, a writer that
+// falls behind costs dropped blocks (see OrbisAudioStats) not a stall. blocks is fixed by a channel's first tap
+int orbisAudioTapOpen(unsigned int channel, const char *path, unsigned int blocks);
+int orbisAudioTapOpenSink(unsigned int channel, OrbisAudioTapSink sink, void *userdata, unsigned int blocks);
+int orbisAudioTapClose(unsigned int channel);
+
+// file streaming: wav data in the channel's source format and rate, read ahead by a thread of its own
+int orbisAudioStreamOpen(unsigned int channel, const char *path, int flags);
+int orbisAudioStreamQueue(unsigned int channel, const char *path, int flags);
+int orbisAudioStreamSetLoop(unsigned int channel, int loop, unsigned int start, unsigned int end);
+int orbisAudioStreamClose(unsigned int channel);
+int orbisAudioStreamIsPlaying(unsigned int channel);
+
+// sound banks: mapped read only, sounds point straight into the mapping
+OrbisAudioBank *orbisAudioBankOpen(const char *path);
+void orbisAudioBankClose(OrbisAudioBank *bank);
+unsigned int orbisAudioBankCount(const OrbisAudioBank *bank);
+const OrbisAudioSound *orbisAudioBankSound(const OrbisAudioBank *bank, unsigned int index);
+int orbisAudioBankFind(const OrbisAudioBank *bank, const char *name);
+int orbisAudioBankPrefetch(const OrbisAudioBank *bank, unsigned int index);
+
+// IMA ADPCM, see ORBISAUDIO_ENCODING_ADPCM
+size_t orbisAudioAdpcmBytes(unsigned int frames, unsigned int channels);
+int orbisAudioAdpcmEncode(void *dst, const short *src, unsigned int frames, unsigned int channels);
+int orbisAudioAdpcmDecode(short *dst, const OrbisAudioSound *sound, unsigned int first, unsigned int frames);
+
+// streaming resampler, pulls input blocks of inBlock frames from pull as needed
+OrbisAudioResampler *orbisAudioResamplerCreate(unsigned int inRate, unsigned int outRate, unsigned int channels, int quality, unsigned int inBlock);
+void orbisAudioResamplerProcess(OrbisAudioResampler *rs, short *out, unsigned int frames, OrbisAudioResamplerPullFn pull, void *ctx);
+void orbisAudioResamplerReset(OrbisAudioResampler *rs);
+void orbisAudioResamplerSetRatio(OrbisAudioResampler *rs, double ratio);
+void orbisAudioResamplerDestroy(OrbisAudioResampler *rs);
+
+// sample kernels, *Ref are the scalar reference versions
+void orbisAudioMixS16(short *dst, const short *src, unsigned int count);
+void orbisAudioMixS16Ref(short *dst, const short *src, unsigned int count);
+void orbisAudioMixMonoS16(short *dst, const short *src, unsigned int frames);
+void orbisAudioMixMonoS16Ref(short *dst, const short *src, unsigned int frames);
+void orbisAudioGainS16(short *dst, const short *src, unsigned int frames, int stereo, unsigned int l, unsigned int r);
+void orbisAudioGainS16Ref(short *dst, const short *src, unsigned int frames, int stereo, unsigned int l, unsigned int r);
+// gain moving linearly from l0/r0 at the first frame towards l1/r1, per sample
+void orbisAudioGainRampS16(short *dst, const short *src, unsigned int frames, int stereo, unsigned int l0, unsigned int r0, unsigned int l1, unsigned int r1);
+void orbisAudioGainRampS16Ref(short *dst, const short *src, unsigned int frames, int stereo, unsigned int l0, unsigned int r0, unsigned int l1, unsigned int r1);
+void orbisAudioExpandMonoS16(short *dst, const short *src, unsigned int frames);
+void orbisAudioExpandMonoS16Ref(short *dst, const short *src, unsigned int frames);
+// float [-1, 1] to s16 with clipping, dither is 8 lanes of generator state or NULL to just round
+void orbisAudioConvertF32ToS16(short *dst, const float *src, unsigned int count, uint32_t *dither);
+void orbisAudioConvertF32ToS16Ref(short *dst, const float *src, unsigned int count, uint32_t *dither);
+void orbisAudioInterleaveF32ToS16(short *dst, const float *l, const float *r, unsigned int frames, uint32_t *dither);
+void orbisAudioInterleaveF32ToS16Ref(short *dst, const float *l, const float *r, unsigned int frames, uint32_t *dither);
+// 7.1 to stereo, ITU-R BS.775 coefficients normalized so a 5.1 mix never clips, LFE dropped; dst may be src
+void orbisAudioDownmix8S16(short *dst, const short *src, unsigned int frames);
+void orbisAudioDownmix8S16Ref(short *dst, const short *src, unsigned int frames);
+void orbisAudioDownmix8F32(float *dst, const float *src, unsigned int frames);
+void orbisAudioDownmix8F32Ref(float *dst, const float *src, unsigned int frames);
+
 #ifdef __cplusplus
 }
 #endif
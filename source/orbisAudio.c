@@ -9,82 +9,68 @@
 */
 
 #include <stdio.h>
+#if defined (__PS4__)
 #include <user_mem.h>
+#endif
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
 #include <unistd.h>  // sleep()
 #include <pthread.h>
+#include <time.h>    // clock_gettime()
+#include <math.h>    // lrintf()
 
 #include "orbisAudio.h"
+#include "orbisAudioInternal.h"
 
 
+// monotonic clock in microseconds, used to pace channel threads
+uint64_t orbisAudioGetTimeUs(void)
+{
 #if defined (__PS4__)
-
-#include <ps4sdk.h>
-#include <debugnet.h>
-#define  fprintf  debugNetPrintf
-#define  ERROR    DEBUGNET_ERROR
-#define  DEBUG    DEBUGNET_DEBUG
-#define  INFO     DEBUGNET_INFO
-
-
-#elif defined HAVE_LIBAO // on pc
-
-#include <stdio.h>
-#define  debugNetPrintf  fprintf
-#define  ERROR           stderr
-#define  DEBUG           stdout
-#define  INFO            stdout
-
-// we wrap sce calls below to use default audio device!
-#define  sceKernelUsleep  usleep
-#include <ao/ao.h>
-ao_device *device         = NULL;
-int        default_driver = -1;
-ao_sample_format format;
-
-// -- libao init --
-int sceAudioOutInit(void)
-{
-    // -- Setup for default audio driver --
-    ao_initialize();
-    // alsa pulls pulseaudio-alsa-plugin!
-    default_driver     = ao_driver_id("alsa"); // or let 'ao_default_driver_id();' autoselect default
-    format.bits        = 16;
-    format.channels    = 2;
-    format.rate        = 48000;
-    format.byte_format = AO_FMT_LITTLE;
-
-    return 1;
+    return sceKernelGetProcessTime();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
 }
 
-// -- libao open driver --
-int sceAudioOutOpen(int unused, int localChannel, int zero, int numSamples, int frequency, int unused_format)
+// duration of one block of this channel in microseconds
+static uint64_t orbisAudioBlockPeriodUs(OrbisAudioChannel *ch)
 {
-    device = ao_open_live(default_driver, &format, NULL );
-    if(device == NULL) { fprintf(ERROR, "Error opening device.\n"); return -1; }
-
-    return default_driver;
+    unsigned int frequency = ch->frequency ? ch->frequency : 48000;
+    return (uint64_t)ch->samples[ch->currentBuffer] * 1000000 / frequency;
 }
 
-// -- libao play audio --
-int sceAudioOutOutput(int audioHandle, void *buf)
+/*
+ * Wait until the next block of this channel is due. In deadline mode we sleep
+ * up to the computed deadline, in blocking mode we only account for it and
+ * let the output call do the waiting. Lateness of every wakeup is recorded.
+ */
+void orbisAudioWaitDeadline(OrbisAudioChannel *ch)
 {
-    ao_play(device, (char *)buf, 1024 *2 * sizeof(short)); return 1;
-}
+    uint64_t period = orbisAudioBlockPeriodUs(ch);
+    uint64_t now    = orbisAudioGetTimeUs();
 
-// -- libao end --
-void sceAudioOutClose(int audioHandle)
-{
-    ao_close(device);
-    ao_shutdown();
-}
-#endif
+    if(ch->nextDeadline == 0) ch->nextDeadline = now;
 
+    if(ch->pacing == ORBISAUDIO_PACING_DEADLINE && now < ch->nextDeadline)
+    {
+        sceKernelUsleep(ch->nextDeadline - now);
+        now = orbisAudioGetTimeUs();
+    }
+
+    ch->lastLateness = (now > ch->nextDeadline) ? now - ch->nextDeadline : 0;
+    if(ch->lastLateness > ch->stats.maxLatenessUs) __atomic_store_n(&ch->stats.maxLatenessUs, ch->lastLateness, __ATOMIC_RELAXED);
+    if(ch->lastLateness >= period) orbisAudioStatAdd(&ch->stats.lateDeadlines, 1);
+    orbisAudioStatAdd(&ch->stats.latenessSumUs, ch->lastLateness);
+    orbisAudioStatAdd(&ch->stats.latenessCount, 1);
 
-//static pthread_mutex_t wait_mutex;
-static unsigned int localChannel = 0;
+    ch->nextDeadline += period;
+    // more than a whole block behind: resync instead of bursting to catch up
+    if(now > ch->nextDeadline) ch->nextDeadline = now + period;
+}
 
 OrbisAudioConfig *orbisAudioConf=NULL;
 int orbisaudio_external_conf=-1;
@@ -95,28 +81,56 @@ OrbisAudioConfig *orbisAudioGetConf()
     else               return NULL; 
 }
 
+// logical channel or, in mixer mode, ORBISAUDIO_CHANNEL_MASTER
+OrbisAudioChannel *orbisAudioGetChannel(unsigned int channel)
+{
+    if(!orbisAudioConf) return NULL;
+    if(channel <  ORBISAUDIO_CHANNELS)      return orbisAudioConf->channels[channel];
+    if(channel == ORBISAUDIO_CHANNEL_MASTER) return orbisAudioConf->master;
+    return NULL;
+}
+
 int orbisAudioCreateBuffersChannel(unsigned int channel, unsigned int samples, unsigned int format)
 {
     int size = 0;
-    switch(format)
-    {
-        case ORBISAUDIO_FORMAT_S16_MONO:   size = sizeof(OrbisAudioMonoSample);   break;
-        case ORBISAUDIO_FORMAT_S16_STEREO: size = sizeof(OrbisAudioStereoSample);
-        default: break;
-    }
+    int port;
+
+    if(!orbisAudioFormatChannels(format)) { fprintf(ERROR, "[orbisAudio] audio channel %u format %u is not supported\n", channel, format); return -1; }
     if(orbisAudioConf)
     {
         if(orbisAudioConf->channels[channel])
         {
             if(orbisAudioConf->channels[channel]->orbisaudiochannel_initialized == -1)
             {
-                for(int i=0; i<ORBISAUDIO_NUM_BUFFERS; i++) // double buffers
+                // ports are always s16 mono or stereo: mono sources may be expanded, 8 channel ones are downmixed
+                port = (orbisAudioFormatChannels(format) >= 2 || orbisAudioConf->channels[channel]->upmix) ? ORBISAUDIO_FORMAT_S16_STEREO : ORBISAUDIO_FORMAT_S16_MONO;
+                size = orbisAudioFormatFrameBytes(port);
+
+                for(unsigned int i=0; i<orbisAudioConf->channels[channel]->numBuffers; i++)
                 {
-                    orbisAudioConf->channels[channel]->sampleBuffer[i] = (short*)malloc(size * samples);
+                    orbisAudioConf->channels[channel]->sampleBuffer[i] = (short*)orbisAudioArenaAlloc(channel, size * samples);
                     orbisAudioConf->channels[channel]->samples     [i] = samples;
+                    if(!orbisAudioConf->channels[channel]->sampleBuffer[i]) return -1;
                     fprintf(DEBUG, "[orbisAudio] buffer %d for audio channel %d created (%db)\n", i, channel, size * samples);
                 }
-                orbisAudioConf->channels[channel]->stereo = format;
+                orbisAudioConf->channels[channel]->crossfadeBuffer = (short *)orbisAudioArenaAlloc(channel, size * samples);
+                if(!orbisAudioConf->channels[channel]->crossfadeBuffer) return -1;
+                // sources that don't fit the port block are staged here: float ones and 8 channel s16
+                if(orbisAudioFormatIsFloat(format) || orbisAudioFormatChannels(format) > 2)
+                {
+                    orbisAudioConf->channels[channel]->convertBuffer = (float *)orbisAudioArenaAlloc(channel, samples * orbisAudioFormatFrameBytes(format));
+                    if(!orbisAudioConf->channels[channel]->convertBuffer) return -1;
+                    for(unsigned int k=0; k<8; k++) orbisAudioConf->channels[channel]->dither[k] = 0x9E3779B9u * (channel * 8 + k + 1);
+                }
+                orbisAudioConf->channels[channel]->stereo = port;
+                orbisAudioConf->channels[channel]->format = format;
+                memset(&orbisAudioConf->channels[channel]->stats, 0, sizeof(OrbisAudioStats));
+                orbisAudioConf->channels[channel]->clockSubmitted = 0;
+                orbisAudioConf->channels[channel]->clockSamples   = 0;
+                orbisAudioConf->channels[channel]->clockTimeUs    = 0;
+                orbisAudioConf->channels[channel]->clockQueued    = 0;
+                orbisAudioFadeReset(orbisAudioConf->channels[channel]);
+                orbisAudioConf->channels[channel]->callerDriven = 0;
                 //fprintf(DEBUG, "setting format:%d\n", format);
             }
             else fprintf(DEBUG, "[orbisAudio] audio channel %d was already initialized\n", channel);
@@ -128,25 +142,66 @@ int orbisAudioCreateBuffersChannel(unsigned int channel, unsigned int samples, u
     return 0;
 }
 
+/*
+ * Convert one source block to the port's s16 format: dither and clip float
+ * samples, interleave planar ones, expand mono to a stereo port and downmix
+ * 8 channels to it. For a mono source src may be the upper half of dst.
+ */
+void orbisAudioConvertBlock(OrbisAudioChannel *ch, short *dst, const void *src, unsigned int frames)
+{
+    switch(ch->format)
+    {
+        case ORBISAUDIO_FORMAT_S16_MONO:
+            orbisAudioExpandMonoS16(dst, src, frames);
+            break;
+        case ORBISAUDIO_FORMAT_FLOAT_MONO:
+            if(ch->upmix)
+            {
+                orbisAudioConvertF32ToS16(dst + frames, src, frames, ch->dither);
+                orbisAudioExpandMonoS16(dst, dst + frames, frames);
+            }
+            else orbisAudioConvertF32ToS16(dst, src, frames, ch->dither);
+            break;
+        case ORBISAUDIO_FORMAT_FLOAT_STEREO:
+            orbisAudioConvertF32ToS16(dst, src, frames * 2, ch->dither);
+            break;
+        case ORBISAUDIO_FORMAT_FLOAT_STEREO_PLANAR:
+            orbisAudioInterleaveF32ToS16(dst, src, (const float *)src + frames, frames, ch->dither);
+            break;
+        case ORBISAUDIO_FORMAT_S16_8CH:
+            orbisAudioDownmix8S16(dst, src, frames);
+            break;
+        case ORBISAUDIO_FORMAT_FLOAT_8CH:
+            // src is the convert buffer or a caller's block, either way the stereo float fits in the convert buffer
+            orbisAudioDownmix8F32(ch->convertBuffer, src, frames);
+            orbisAudioConvertF32ToS16(dst, ch->convertBuffer, frames * 2, ch->dither);
+            break;
+        default:
+            break;
+    }
+}
+
 int orbisAudioCreateConf()
 {   
     if(!orbisAudioConf)
     {
-        orbisAudioConf = (OrbisAudioConfig *)malloc(sizeof(OrbisAudioConfig));
-        memset(orbisAudioConf, 0, sizeof(OrbisAudioConfig));
+        // the config and every channel come from the arena, each channel on cache lines of its own
+        orbisAudioConf = (OrbisAudioConfig *)orbisAudioArenaAllocGlobal(sizeof(OrbisAudioConfig));
         if(orbisAudioConf)
         {
+            memset(orbisAudioConf, 0, sizeof(OrbisAudioConfig));
             for(int i=0;i<ORBISAUDIO_CHANNELS;i++)
             {
-                orbisAudioConf->channels[i] = (OrbisAudioChannel *)malloc(sizeof(OrbisAudioChannel));
-                memset(orbisAudioConf->channels[i], 0, sizeof(OrbisAudioChannel));
+                orbisAudioConf->channels[i] = (OrbisAudioChannel *)orbisAudioArenaAllocGlobal(sizeof(OrbisAudioChannel));
                 if(orbisAudioConf->channels[i])
                 {
+                    memset(orbisAudioConf->channels[i], 0, sizeof(OrbisAudioChannel));
+                    orbisAudioConf->channels[i]->index        =  i;
                     orbisAudioConf->channels[i]->audioHandle  = -1;
                     orbisAudioConf->channels[i]->threadHandle =  0;
                     orbisAudioConf->channels[i]->leftVol      = ORBISAUDIO_VOLUME_MAX;
                     orbisAudioConf->channels[i]->rightVol     = ORBISAUDIO_VOLUME_MAX;
-                    for(int j=0;j<ORBISAUDIO_NUM_BUFFERS;j++)
+                    for(int j=0;j<ORBISAUDIO_MAX_BUFFERS;j++)
                     {
                         orbisAudioConf->channels[i]->sampleBuffer[j] = NULL;
                         orbisAudioConf->channels[i]->samples     [j] = 0;
@@ -155,6 +210,10 @@ int orbisAudioCreateConf()
                     orbisAudioConf->channels[i]->userData      = NULL;
                     orbisAudioConf->channels[i]->paused        = 1;
                     orbisAudioConf->channels[i]->currentBuffer = 0;
+                    orbisAudioConf->channels[i]->numBuffers    = ORBISAUDIO_NUM_BUFFERS;
+                    orbisAudioConf->channels[i]->pacing        = ORBISAUDIO_PACING_POLL;
+                    orbisAudioConf->channels[i]->resampleQuality = ORBISAUDIO_RESAMPLE_MEDIUM;
+                    orbisAudioConf->channels[i]->rampMs        = ORBISAUDIO_VOLUME_RAMP_MS;
                     orbisAudioConf->channels[i]->orbisaudiochannel_initialized = -1;
                 }
             }
@@ -163,7 +222,7 @@ int orbisAudioCreateConf()
             return 0;
         }
     }
-    if(orbisAudioConf->orbisaudio_initialized == 1) return 1;
+    if(orbisAudioConf && orbisAudioConf->orbisaudio_initialized == 1) return 1;
 
     return -1; // something weird happened
 }
@@ -194,8 +253,7 @@ int orbisAudioInitWithConf(OrbisAudioConfig *conf)
 
 int orbisAudioPlayBlock(unsigned int channel,unsigned int vol1,unsigned int vol2,void *buf)
 {
-    //int vols[2]={vol1,vol2};
-    if (channel > ORBISAUDIO_CHANNELS) return 0;
+    if (channel >= ORBISAUDIO_CHANNELS) return 0;
 
     if(orbisAudioConf)
     {
@@ -204,94 +262,315 @@ int orbisAudioPlayBlock(unsigned int channel,unsigned int vol1,unsigned int vol2
             if(orbisAudioConf->channels[channel]->orbisaudiochannel_initialized == 1
             && orbisAudioConf->orbisaudio_stop != 1)
             {
-                // sceAudioOutSetVolume(orbisAudioConf->channels[channel]->audioHandle,ORBISAUDIO_VOLUME_FLAG_LEFT_CHANNEL|ORBISAUDIO_VOLUME_FLAG_RIGHT_CHANNEL,vols);
-                return sceAudioOutOutput(orbisAudioConf->channels[channel]->audioHandle, buf);
+                OrbisAudioChannel *ch = orbisAudioConf->channels[channel];
+                OrbisAudioDsp     *dsp = ch->callerDriven ? __atomic_load_n(&ch->dsp, __ATOMIC_ACQUIRE) : NULL;
+                unsigned int i;
+
+                // caller driven channels have no rendering thread, the caller's submit is their block boundary;
+                // blocks of the others were faded when rendered, so all of this is theirs alone
+                if(ch->callerDriven) orbisAudioControlApply(ch);
+
+                for(i=0; i<ch->numBuffers; i++) if(buf == ch->sampleBuffer[i]) break;
+
+                // a caller's block in another format is converted into the next queue slot
+                if(i == ch->numBuffers && ch->format != ch->stereo)
+                {
+                    orbisAudioConvertBlock(ch, ch->sampleBuffer[ch->currentBuffer], buf, ch->samples[0]);
+                    buf = ch->sampleBuffer[ch->currentBuffer];
+                    ch->currentBuffer = (ch->currentBuffer + 1) % ch->numBuffers;
+                    i = 0;
+                }
+
+                // paused: the port keeps getting blocks, silent ones, and the caller's is dropped
+                if(ch->callerDriven && ch->paused)
+                {
+                    buf = ch->sampleBuffer[ch->currentBuffer];
+                    memset(buf, 0, ch->samples[0] * sizeof(short) * (ch->stereo + 1));
+                    ch->currentBuffer = (ch->currentBuffer + 1) % ch->numBuffers;
+                }
+                // software gain and pan, then the channel volume and pause/resume fades:
+                // our own buffers are scaled in place, a caller's block into the next queue slot instead
+                else if(vol1 < ORBISAUDIO_VOLUME_MAX || vol2 < ORBISAUDIO_VOLUME_MAX || (ch->callerDriven && !orbisAudioFadeIsUnity(ch)) || dsp)
+                {
+                    short *dst = buf;
+
+                    if(i == ch->numBuffers)
+                    {
+                        dst = ch->sampleBuffer[ch->currentBuffer];
+                        ch->currentBuffer = (ch->currentBuffer + 1) % ch->numBuffers;
+                    }
+                    orbisAudioGainS16(dst, buf, ch->samples[0], ch->stereo, vol1, vol2);
+                    if(ch->callerDriven) orbisAudioFadeGain(ch, dst, ch->samples[0]);
+                    buf = dst;
+                }
+                // and the insert chain after the gain, as rendered blocks get it
+                if(dsp) orbisAudioDspProcess(dsp, buf, ch->samples[0]);
+                return orbisAudioOutputBlock(ch, buf);
             }
         }
     }
     return -1;
 }
 
-void * orbisAudioChannelThread(void *argp)
+static void orbisAudioStatHist(uint64_t *hist, uint64_t us)
 {
-    fprintf(DEBUG, "-- audio thread --\n");
-    int i, ret;
+    unsigned int bucket = us ? 64 - __builtin_clzll(us) : 0;
 
-    OrbisAudioCallback callback = NULL;
-    // sound samples are shorts, s16le
-    void              *buf;
-    unsigned int       samples;
-    unsigned int       channel = *((unsigned int*)argp);
+    if(bucket >= ORBISAUDIO_STATS_BUCKETS) bucket = ORBISAUDIO_STATS_BUCKETS - 1;
+    orbisAudioStatAdd(&hist[bucket], 1);
+}
 
-//long *p = (long*)argp;
-//fprintf(2,"localChannel:%ld %d '%.16x' %p %lx %zu %.16x, %.16x\n", *p, (int)channel, channel, argp, (long)argp, sizeof(long), *(int*)argp, *((int*)argp));
+/*
+ * Publish the playback clock after a block went to the port. When the output
+ * call returns the device still holds the block just given to it, everything
+ * before it has played. Seqlock: odd while the fields change, readers retry.
+ */
+static void orbisAudioClockUpdate(OrbisAudioChannel *ch, unsigned int samples)
+{
+    uint32_t seq = ch->clockSeq;
 
-    if(channel != 0
-    || channel != localChannel)
-    {
-    //printf("wtf! localChannel:%u '%.8x' %p %p %.8lx\n", channel, channel, argp, argp, *(long*)argp);
+    ch->clockSubmitted += samples;
 
-        channel = 0; // fix it, must be 0!
+    __atomic_store_n(&ch->clockSeq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&ch->clockSamples, ch->clockSubmitted - samples, __ATOMIC_RELAXED);
+    __atomic_store_n(&ch->clockTimeUs, orbisAudioGetTimeUs(), __ATOMIC_RELAXED);
+    __atomic_store_n(&ch->clockQueued, samples, __ATOMIC_RELAXED);
+    __atomic_store_n(&ch->clockSeq, seq + 2, __ATOMIC_RELEASE);
+}
+
+// submit one block to the channel's port, accounting the time spent blocked in it
+int orbisAudioOutputBlock(OrbisAudioChannel *ch, void *buf)
+{
+    uint64_t start = orbisAudioGetTimeUs();
+    uint64_t *renderStart = &ch->renderStart[ch->currentBuffer];
+    int ret;
+
+    // blocks rendered by the library carry their render start, caller blocks don't
+    if(*renderStart && buf == ch->sampleBuffer[ch->currentBuffer])
+    {
+        orbisAudioStatHist(ch->stats.submitHist, start - *renderStart);
+        *renderStart = 0;
     }
-    //static pthread_mutex_t wait_mutex = PTHREAD_MUTEX_INITIALIZER;
-    for(i=0; i<ORBISAUDIO_NUM_BUFFERS; i++)
+
+    ret = orbisAudioBackendOutput(ch->audioHandle, buf);
+
+    orbisAudioStatAdd(&ch->stats.outputBlockedUs, orbisAudioGetTimeUs() - start);
+    if(ret >= 0)
     {
-        size_t size = 0;
-//fprintf(DEBUG, "\n%u %p, %u, i:%d, size: %zu, %p\n", channel, argp, *(unsigned int*)argp, i, size, orbisAudioConf);
+        orbisAudioStatAdd(&ch->stats.blocksPlayed, 1);
+        orbisAudioClockUpdate(ch, ch->samples[ch->currentBuffer]);
+
+        // a block the library rendered itself is flipped into the tap, a caller's is copied
+        if(__atomic_load_n(&ch->tap, __ATOMIC_RELAXED))
+            orbisAudioTapSubmit(ch, (buf == ch->sampleBuffer[ch->currentBuffer] && (ch->threadHandle || ch->offline)) ? &ch->sampleBuffer[ch->currentBuffer] : NULL, buf);
+    }
+
+    return ret;
+}
 
-//fprintf(DEBUG, "i:%d stereo:%d\n", i, orbisAudioConf->channels[channel]->stereo);
-        switch(orbisAudioConf->channels[channel]->stereo)
+// fill one block of a channel at its source rate, from the user callback, the push ring, a stream or with silence
+static void orbisAudioRenderSource(OrbisAudioChannel *ch, void *buf, unsigned int samples)
+{
+    OrbisAudioCallback callback = ch->callback;
+    OrbisAudioRing    *ring     = __atomic_load_n(&ch->ring, __ATOMIC_ACQUIRE);
+    OrbisAudioStream  *stream   = __atomic_load_n(&ch->stream, __ATOMIC_ACQUIRE);
+    void              *src      = buf;
+
+    // float sources render into the convert buffer, an s16 mono one into the upper half of its stereo block
+    if(ch->format != ch->stereo) src = ch->convertBuffer ? (void *)ch->convertBuffer : (void *)((short *)buf + samples);
+
+    if(callback && !ch->paused)
+    {
+        /* Use user callback to fill buffer */
+        uint64_t start = orbisAudioGetTimeUs();
+        callback(src, samples, ch->userData);
+        orbisAudioStatHist(ch->stats.callbackHist, orbisAudioGetTimeUs() - start);
+    }
+    else if(ring && !ch->paused)
+    {
+        /* Drain pushed samples, an underrun plays silence instead of stalling */
+        unsigned int n = orbisAudioRingPop(ring, src, samples);
+        if(n < samples)
+        {
+            memset((short *)src + n * ring->frameSize, 0, (samples - n) * ring->frameSize * sizeof(short));
+            orbisAudioStatAdd(&ch->stats.underruns, 1);
+        }
+    }
+    else if(stream && !ch->paused)
+    {
+        /* Copy what the stream thread read ahead, no file I/O here */
+        unsigned int frameBytes = orbisAudioFormatFrameBytes(ch->format);
+        int          starved;
+        unsigned int n = orbisAudioStreamPop(stream, src, samples, &starved);
+        if(n < samples)
         {
-            case  0: size = sizeof(OrbisAudioMonoSample);   break;
-            case  1: size = sizeof(OrbisAudioStereoSample);
-            default: break;
+            memset((char *)src + n * frameBytes, 0, (samples - n) * frameBytes);
+            if(starved) orbisAudioStatAdd(&ch->stats.underruns, 1);
         }
-    //fprintf(DEBUG, "size: %zu * %d\n", size, orbisAudioConf->channels[channel]->samples[i]);
-        size *= orbisAudioConf->channels[channel]->samples[i];
-//fprintf(DEBUG, "i:%d, size: %zu %p\n", i, size, orbisAudioConf->channels[channel]->sampleBuffer[i]);
-        //pthread_mutex_lock(&wait_mutex);
-        memset(orbisAudioConf->channels[channel]->sampleBuffer[i], 0, size);
-        //pthread_mutex_unlock(&wait_mutex);
     }
-    //pthread_mutex_unlock(&wait_mutex);
+    else
+    {
+        /* Fill buffer with silence (stereo/mono) */
+        memset(buf, 0, samples * sizeof(short) * (ch->stereo + 1));
+        src = buf;
+    }
+    if(src != buf) orbisAudioConvertBlock(ch, buf, src, samples);
+
+    /* A callback fading in over the source */
+    if(ch->xfadeCallback && !ch->paused) orbisAudioFadeCrossfadeBlock(ch, buf, samples);
+
+    /* Sound effects go on top */
+    if(ch->voices && !ch->paused) orbisAudioVoiceRender(ch, buf, samples);
+}
+
+static void orbisAudioRenderPull(short *buf, unsigned int frames, void *ctx)
+{
+    orbisAudioRenderSource((OrbisAudioChannel *)ctx, buf, frames);
+}
+
+/*
+ * Rate control for rings fed on the producer's own clock: a PI controller on
+ * the smoothed ring fill nudges the resampling ratio so the fill settles at
+ * rateTarget. The error is in seconds of audio so the loop behaves the same
+ * for any target: 10 ms off reaches the limit, steady drift is integrated out
+ * within a few seconds, critically damped or close to it.
+ */
+static void orbisAudioRateControl(OrbisAudioChannel *ch, OrbisAudioRing *ring, unsigned int samples)
+{
+    unsigned int target = __atomic_load_n(&ch->rateTarget, __ATOMIC_RELAXED);
+    float        rate   = ch->sourceFrequency ? ch->sourceFrequency : ORBISAUDIO_OUTPUT_FREQUENCY;
+    float        limit  = ORBISAUDIO_RATE_MAX_PPM * 1e-6f;
+    float        err, ratio;
+
+    // the producer pushes in bursts, only the trend matters
+    ch->rateFillAvg += ((float)orbisAudioRingFill(ring) - ch->rateFillAvg) * 0.05f;
+    err = (ch->rateFillAvg - target) / rate;
+
+    ch->rateInteg += 0.1f * err * samples / rate;
+    if(ch->rateInteg >  limit) ch->rateInteg =  limit;
+    if(ch->rateInteg < -limit) ch->rateInteg = -limit;
+
+    ratio = 0.5f * err + ch->rateInteg;
+    if(ratio >  limit) ratio =  limit;
+    if(ratio < -limit) ratio = -limit;
+
+    orbisAudioResamplerSetRatio(ch->resampler, 1.0 + ratio);
+    __atomic_store_n(&ch->ratePpm, (int)lrintf(ratio * 1e6f), __ATOMIC_RELAXED);
+    __atomic_store_n(&ch->rateFill, (unsigned int)ch->rateFillAvg, __ATOMIC_RELAXED);
+}
+
+// fill one block of a channel at port rate
+void orbisAudioRenderChannel(OrbisAudioChannel *ch, void *buf, unsigned int samples)
+{
+    OrbisAudioRing *ring = __atomic_load_n(&ch->ring, __ATOMIC_ACQUIRE);
+    OrbisAudioDsp  *dsp;
+
+    if(ch->resampler && ring && ch->rateTarget && !ch->paused && !ch->callback) orbisAudioRateControl(ch, ring, samples);
+
+    if(ch->resampler && !ch->paused && orbisAudioChannelHasSource(ch))
+        orbisAudioResamplerProcess(ch->resampler, buf, samples, orbisAudioRenderPull, ch);
+    else
+        orbisAudioRenderSource(ch, buf, samples);
+
+    // channel volume with its ramps and the pause/resume fades
+    orbisAudioFadeGain(ch, buf, samples);
+
+    dsp = __atomic_load_n(&ch->dsp, __ATOMIC_ACQUIRE);
+    if(dsp) orbisAudioDspProcess(dsp, buf, samples);
+}
+
+// the source keeps its own rate and block size, only the port runs at portFrequency
+int orbisAudioCreateResamplerChannel(OrbisAudioChannel *ch, unsigned int frequency, unsigned int portFrequency)
+{
+    ch->sourceFrequency = frequency;
+    ch->ratePpm         = 0;
+    ch->rateFill        = 0;
+    ch->rateFillAvg     = ch->rateTarget;
+    ch->rateInteg       = 0.0f;
+    // rate control needs a resampler even at the port rate
+    if(frequency == portFrequency && !ch->rateTarget) return 0;
+
+    ch->resampler = orbisAudioResamplerInit(orbisAudioArenaAlloc(ch->index, orbisAudioResamplerBytes(ch->stereo + 1, ch->resampleQuality, ch->samples[0])),
+                                            frequency, portFrequency, ch->stereo + 1, ch->resampleQuality, ch->samples[0]);
+    if(!ch->resampler) { fprintf(ERROR, "[orbisAudio] can't resample %u Hz to %u Hz\n", frequency, portFrequency); return -1; }
+
+    fprintf(DEBUG, "[orbisAudio] audio channel %u resampled from %u Hz to %u Hz\n", ch->index, frequency, portFrequency);
+    return 0;
+}
+
+// clear the queue and render the blocks kept ahead of the device, numBuffers-2 of them
+void orbisAudioChannelPrime(OrbisAudioChannel *ch)
+{
+    unsigned int slot;
 
-    fprintf(DEBUG, "[orbisAudio] orbisAudioChannelThread %d %d ready to have a lot of fun!\n", orbisAudioConf->orbisaudio_stop, orbisAudioConf->channels[channel]->paused);
-    // reset state and start it
-    orbisAudioConf->orbisaudio_stop = 0;
+    for(slot=0; slot<ch->numBuffers; slot++)
+        memset(ch->sampleBuffer[slot], 0, ch->samples[slot] * sizeof(short) * (ch->stereo + 1));
 
-    while(!orbisAudioConf->orbisaudio_stop)
+    orbisAudioControlApply(ch);
+    ch->currentBuffer = 0;
+    for(slot=0; slot+2<ch->numBuffers; slot++)
     {
-        if(orbisAudioConf->channels[channel]->orbisaudiochannel_initialized == 1)
-        {
-            callback = orbisAudioConf->channels[channel]->callback;
-            buf      = orbisAudioConf->channels[channel]->sampleBuffer[orbisAudioConf->channels[channel]->currentBuffer];
-            samples  = orbisAudioConf->channels[channel]->samples     [orbisAudioConf->channels[channel]->currentBuffer];
+        ch->renderStart[slot] = orbisAudioGetTimeUs();
+        orbisAudioRenderChannel(ch, ch->sampleBuffer[slot], ch->samples[slot]);
+    }
+}
 
-            if(callback && !orbisAudioConf->channels[channel]->paused)
-            {
-                /* Use user callback to fill buffer */
-                callback(buf,samples,orbisAudioConf->channels[channel]->userData);
-            }
-            else
-            {
-                /* Fill buffer with silence (stereo/mono) */
-                memset(buf, 0, samples * sizeof(short)
-                                       * (orbisAudioConf->channels[channel]->stereo + 1));
-            }
+// one period of a channel: render the newest block and play the oldest, returns the block played
+short *orbisAudioChannelBlock(OrbisAudioChannel *ch)
+{
+    unsigned int numBuffers = ch->numBuffers;
+    unsigned int slot;
+    short       *buf;
+    int          ret;
+
+    orbisAudioControlApply(ch);
+
+    /* Render the newest block, numBuffers-2 blocks stay queued ahead of it */
+    slot = (ch->currentBuffer + numBuffers - 2) % numBuffers;
+    ch->renderStart[slot] = orbisAudioGetTimeUs();
+    orbisAudioRenderChannel(ch, ch->sampleBuffer[slot], ch->samples[slot]);
+
+    /* Play the oldest block */
+    buf = ch->sampleBuffer[ch->currentBuffer];
+    ret = orbisAudioPlayBlock(ch->index, ORBISAUDIO_VOLUME_MAX, ORBISAUDIO_VOLUME_MAX, buf); // gain was applied when rendering
+    if(ret<0 && !orbisAudioConf->orbisaudio_stop) { fprintf(ERROR, "[orbisAudio] orbisAudioPlayBlock error 0x%08X \n",ret); }
+    __atomic_store_n(&ch->blocks, ch->blocks + 1, __ATOMIC_RELEASE);
+
+    /* Switch active buffer */
+    ch->currentBuffer = (ch->currentBuffer + 1) % numBuffers;
+
+    return buf;
+}
+
+/*
+ * One thread per channel, each one owns its channel context: argp is the
+ * OrbisAudioChannel it services, so channels stream in parallel.
+ */
+void * orbisAudioChannelThread(void *argp)
+{
+    OrbisAudioChannel *ch = (OrbisAudioChannel *)argp;
+
+    fprintf(DEBUG, "-- audio thread %u --\n", ch->index);
 
-            /* Play sound */
-            ret = orbisAudioPlayBlock(channel,orbisAudioConf->channels[channel]->leftVol,orbisAudioConf->channels[channel]->rightVol,buf);
-            if(ret<0) { fprintf(ERROR, "[orbisAudio] orbisAudioPlayBlock error 0x%08X \n",ret); }
+    // prime the queue so the device always has numBuffers-2 blocks waiting
+    orbisAudioChannelPrime(ch);
 
-            /* Switch active buffer */
-            orbisAudioConf->channels[channel]->currentBuffer=(orbisAudioConf->channels[channel]->currentBuffer?0:1);
+    fprintf(DEBUG, "[orbisAudio] orbisAudioChannelThread %u %d ready to have a lot of fun!\n", ch->index, ch->paused);
+
+    while(!__atomic_load_n(&orbisAudioConf->orbisaudio_stop, __ATOMIC_RELAXED)
+       && !__atomic_load_n(&ch->stop, __ATOMIC_RELAXED))
+    {
+        if(ch->orbisaudiochannel_initialized == 1)
+        {
+            if(ch->pacing != ORBISAUDIO_PACING_POLL) orbisAudioWaitDeadline(ch);
+            orbisAudioChannelBlock(ch);
         }
         /* wait a little */
-        sceKernelUsleep(1000);
+        if(ch->pacing == ORBISAUDIO_PACING_POLL || ch->orbisaudiochannel_initialized != 1)
+            sceKernelUsleep(1000);
     }    
-    fprintf(DEBUG, "[orbisAudio] stop:%d, orbisAudioChannelThread exit...\n",orbisAudioConf->orbisaudio_stop);
-    //scePthreadExit(0);
-    pthread_join(orbisAudioConf->channels[channel]->threadHandle, NULL);
+    fprintf(DEBUG, "[orbisAudio] stop:%d, orbisAudioChannelThread %u exit...\n", orbisAudioConf->orbisaudio_stop, ch->index);
 
     return NULL;
 }
@@ -302,10 +581,17 @@ void orbisAudioDestroyBuffersChannel(unsigned int channel)
     {
         if(orbisAudioConf->channels[channel])
         {
-            for(int i=0;i<ORBISAUDIO_NUM_BUFFERS;i++)
-            {
-                if(orbisAudioConf->channels[channel]->sampleBuffer[i]) free(orbisAudioConf->channels[channel]->sampleBuffer[i]);
-            }
+            for(int i=0;i<ORBISAUDIO_MAX_BUFFERS;i++) orbisAudioConf->channels[channel]->sampleBuffer[i] = NULL;
+            orbisAudioConf->channels[channel]->convertBuffer = NULL;
+            orbisAudioConf->channels[channel]->crossfadeBuffer = NULL;
+            orbisAudioDestroyRing(orbisAudioConf->channels[channel]);
+            orbisAudioConf->channels[channel]->stream = NULL;
+            orbisAudioConf->channels[channel]->resampler = NULL;
+            orbisAudioConf->channels[channel]->voices = NULL;
+            orbisAudioConf->channels[channel]->dsp = NULL;
+            orbisAudioConf->channels[channel]->tap = NULL;
+            // buffers, ring, stream, resampler, DSP chain and tap all live in the channel's arena region
+            orbisAudioArenaReset(channel);
         }
     }
 }
@@ -350,16 +636,24 @@ int orbisAudioInitChannelWithoutCallback(unsigned int channel, unsigned int samp
     int ret;
     unsigned int numSamples = 0;
     int handle;
-    localChannel = channel;
-    char label[32];
-    strcpy(label,"audiotX");
-    label[6]='0'+channel;
+    if(channel >= ORBISAUDIO_CHANNELS) return -1;
     if(orbisAudioConf!=NULL)
     {
-        if(orbisAudioConf->channels[localChannel]!=NULL)
+        if(orbisAudioConf->channels[channel]!=NULL)
         {
-            if(orbisAudioConf->channels[localChannel]->orbisaudiochannel_initialized==-1)
+            if(orbisAudioConf->channels[channel]->orbisaudiochannel_initialized==-1)
             {
+                if(orbisAudioConf->master)
+                {
+                    fprintf(ERROR, "[orbisAudio] audio channel %d has no port of its own in mixer mode\n", channel);
+                    return -1;
+                }
+                // the caller hands over whole port blocks, there is no block of source frames to resample from
+                if(frequency != ORBISAUDIO_OUTPUT_FREQUENCY)
+                {
+                    fprintf(ERROR, "[orbisAudio] audio channel %d without callback must run at %u Hz, not %u Hz\n", channel, ORBISAUDIO_OUTPUT_FREQUENCY, frequency);
+                    return -1;
+                }
                 if (samples<ORBISAUDIO_MIN_LEN)
                 {
                     numSamples=ORBISAUDIO_MIN_LEN;
@@ -370,35 +664,39 @@ int orbisAudioInitChannelWithoutCallback(unsigned int channel, unsigned int samp
 
                     if(numSamples > ORBISAUDIO_MAX_LEN) numSamples = ORBISAUDIO_MAX_LEN;
                 }
-                ret = orbisAudioCreateBuffersChannel(localChannel,numSamples,format);
+                ret = orbisAudioCreateBuffersChannel(channel,numSamples,format);
                 if(ret!=0)
                 {
-                    fprintf(ERROR, "[orbisAudio] error creating buffers for audio channel %d\n",localChannel);
-                    orbisAudioDestroyBuffersChannel(localChannel);
-                    orbisAudioConf->channels[localChannel]->orbisaudiochannel_initialized=-1;
+                    fprintf(ERROR, "[orbisAudio] error creating buffers for audio channel %d\n",channel);
+                    orbisAudioDestroyBuffersChannel(channel);
+                    orbisAudioConf->channels[channel]->orbisaudiochannel_initialized=-1;
                 }
                 else
                 {
-                    fprintf(DEBUG, "[orbisAudio] sceAudioOutOpen %d samples\n",numSamples);
+                    fprintf(DEBUG, "[orbisAudio] orbisAudioBackendOpen %d samples\n",numSamples);
                     
-                    handle=sceAudioOutOpen(0xff,localChannel,0,numSamples,frequency,format);
+                    handle=orbisAudioBackendOpen(channel,numSamples,ORBISAUDIO_OUTPUT_FREQUENCY,orbisAudioConf->channels[channel]->stereo);
                     fprintf(DEBUG, "handle: %d\n", handle);
                     if(handle>0)
                     {
-                        orbisAudioConf->channels[localChannel]->audioHandle=handle; 
-                        orbisAudioConf->channels[localChannel]->orbisaudiochannel_initialized=1;
+                        orbisAudioConf->channels[channel]->audioHandle=handle; 
+                        orbisAudioConf->channels[channel]->frequency=ORBISAUDIO_OUTPUT_FREQUENCY;
+                        // the caller's blocks play from the first one, orbisAudioPause still fades them out
+                        orbisAudioConf->channels[channel]->paused=0;
+                        orbisAudioConf->channels[channel]->callerDriven=1;
+                        orbisAudioConf->channels[channel]->orbisaudiochannel_initialized=1;
                         return 0;
                     }
                     else
                     {
-                        fprintf(ERROR, "[orbisAudio] error opening audio channel %d 0x%08X\n",localChannel, handle);
-                        orbisAudioConf->channels[localChannel]->orbisaudiochannel_initialized = -1;
+                        fprintf(ERROR, "[orbisAudio] error opening audio channel %d 0x%08X\n",channel, handle);
+                        orbisAudioConf->channels[channel]->orbisaudiochannel_initialized = -1;
                     }
                 }
             }
             else
             {
-                fprintf(DEBUG, "[orbisAudio] audio channel %d already initialized",localChannel);
+                fprintf(DEBUG, "[orbisAudio] audio channel %d already initialized",channel);
             }
         }
     }
@@ -406,20 +704,26 @@ int orbisAudioInitChannelWithoutCallback(unsigned int channel, unsigned int samp
 }
 int orbisAudioInitChannel(unsigned int channel, unsigned int samples, unsigned int frequency, int format)
 {
-    localChannel = channel;
-
     unsigned int numSamples = 0;
     int ret, handle;
-    char label[32];
-    strcpy(label, "audiotX");
-    label[6] = '0' + channel;
+
+    if(channel >= ORBISAUDIO_CHANNELS) return -1;
 
     if(orbisAudioConf)
     {
-        if(orbisAudioConf->channels[localChannel])
+        if(orbisAudioConf->channels[channel])
         {
-            if(orbisAudioConf->channels[localChannel]->orbisaudiochannel_initialized==-1)
+            if(orbisAudioConf->channels[channel]->orbisaudiochannel_initialized==-1)
             {
+                if(orbisAudioConf->master)
+                {
+                    if(orbisAudioInitMixerInput(channel, frequency, format) == 0) return 0;
+
+                    fprintf(ERROR, "[orbisAudio] error creating mixer input %u\n", channel);
+                    orbisAudioDestroyBuffersChannel(channel);
+                    return -1;
+                }
+
                 if(samples<ORBISAUDIO_MIN_LEN) numSamples = ORBISAUDIO_MIN_LEN; 
                 else
                 {
@@ -428,53 +732,58 @@ int orbisAudioInitChannel(unsigned int channel, unsigned int samples, unsigned i
                     if(numSamples>ORBISAUDIO_MAX_LEN) numSamples = ORBISAUDIO_MAX_LEN;
                 }
 
-                ret = orbisAudioCreateBuffersChannel(localChannel, numSamples, format);
+                ret = orbisAudioCreateBuffersChannel(channel, numSamples, format);
+                if(ret == 0) ret = orbisAudioCreateResamplerChannel(orbisAudioConf->channels[channel], frequency, ORBISAUDIO_OUTPUT_FREQUENCY);
                 if(ret)
                 {
-                    fprintf(ERROR, "[orbisAudio] error creating buffers for audio channel %d\n", localChannel);
-                    orbisAudioDestroyBuffersChannel(localChannel);
-                    orbisAudioConf->channels[localChannel]->orbisaudiochannel_initialized = -1;
+                    fprintf(ERROR, "[orbisAudio] error creating buffers for audio channel %d\n", channel);
+                    orbisAudioDestroyBuffersChannel(channel);
+                    orbisAudioConf->channels[channel]->orbisaudiochannel_initialized = -1;
                 }
                 else
                 {
-                    fprintf(DEBUG, "[orbisAudio] sceAudioOutOpen %d samples\n",numSamples);
+                    fprintf(DEBUG, "[orbisAudio] orbisAudioBackendOpen %d samples\n",numSamples);
                     
-                    handle=sceAudioOutOpen(0xff,localChannel,0,numSamples,frequency,format);
+                    handle=orbisAudioBackendOpen(channel,numSamples,ORBISAUDIO_OUTPUT_FREQUENCY,orbisAudioConf->channels[channel]->stereo);
 //fprintf(DEBUG, "handle:%d\n", handle);
                     if(handle>0)
                     {
-                        // protect the localChannel variable
-    //static pthread_mutex_t wait_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-                        orbisAudioConf->channels[localChannel]->audioHandle=handle;
+                        orbisAudioConf->channels[channel]->audioHandle=handle;
+                        orbisAudioConf->channels[channel]->frequency=ORBISAUDIO_OUTPUT_FREQUENCY;
+                        orbisAudioConf->channels[channel]->nextDeadline=0;
+                        orbisAudioConf->channels[channel]->stop=0;
+                        orbisAudioConf->orbisaudio_stop = 0;
+
+                        // offline the channel has no thread, orbisAudioRenderOffline renders it on the caller's
+                        if(orbisAudioBackendIsOffline())
+                        {
+                            orbisAudioConf->channels[channel]->offline = 1;
+                            orbisAudioChannelPrime(orbisAudioConf->channels[channel]);
+                            orbisAudioConf->channels[channel]->orbisaudiochannel_initialized = 1;
+                            return 0;
+                        }
 
-                        //ret=scePthreadCreate(&orbisAudioConf->channels[localChannel]->threadHandle,NULL,orbisAudioChannelThread, &localChannel,label);
-                        ret = pthread_create(&orbisAudioConf->channels[localChannel]->threadHandle,
+                        // the thread gets its own channel context, nothing shared between inits
+                        ret = pthread_create(&orbisAudioConf->channels[channel]->threadHandle,
                                  NULL,
                                  orbisAudioChannelThread,
-                                 (void *)&localChannel);
+                                 (void *)orbisAudioConf->channels[channel]);
 
-                        //pthread_mutex_lock(&wait_mutex);
-//fprintf(DEBUG, "creating thread res:%d\n", ret);
-    //pthread_mutex_unlock(&wait_mutex);
-    //pthread_mutex_destroy(&wait_mutex);
-//usleep(2000);
                         if(ret==0)
                         {
-                            fprintf(DEBUG, "[orbisAudio] audio channel %u thread UID: 0x%08lX created\n", localChannel, orbisAudioConf->channels[localChannel]->threadHandle);
+                            fprintf(DEBUG, "[orbisAudio] audio channel %u thread UID: 0x%08lX created\n", channel, orbisAudioConf->channels[channel]->threadHandle);
 
-                            orbisAudioConf->channels[localChannel]->orbisaudiochannel_initialized = 1;
+                            orbisAudioConf->channels[channel]->orbisaudiochannel_initialized = 1;
                             return 0;
                         }
                         else
                         {
-                            fprintf(ERROR, "[orbisAudio] audio channel %u thread could not create error: 0x%08X\n",localChannel, ret);
-                            //scePthreadCancel(orbisAudioConf->channels[localChannel]->threadHandle);
-                            pthread_join(orbisAudioConf->channels[localChannel]->threadHandle, NULL);
+                            fprintf(ERROR, "[orbisAudio] audio channel %u thread could not create error: 0x%08X\n",channel, ret);
+                            orbisAudioConf->channels[channel]->threadHandle = 0;
 
                             fprintf(DEBUG, "[orbisAudio] closing audio channel %d\n", channel);
 
-                            sceAudioOutClose(orbisAudioConf->channels[channel]->audioHandle);
+                            orbisAudioBackendClose(orbisAudioConf->channels[channel]->audioHandle);
 
                             orbisAudioConf->channels[channel]->audioHandle = -1;
                             orbisAudioDestroyBuffersChannel(channel);
@@ -484,65 +793,321 @@ int orbisAudioInitChannel(unsigned int channel, unsigned int samples, unsigned i
                     }
                     else
                     {
-                        fprintf(DEBUG, "[orbisAudio] error opening audio channel %u 0x%08X\n",localChannel, handle);
-                        orbisAudioConf->channels[localChannel]->orbisaudiochannel_initialized = -1;
+                        fprintf(DEBUG, "[orbisAudio] error opening audio channel %u 0x%08X\n",channel, handle);
+                        orbisAudioConf->channels[channel]->orbisaudiochannel_initialized = -1;
                     }
                 }
             }
             else
             {
-                fprintf(DEBUG, "[orbisAudio] audio channel %u already initialized",localChannel);
+                fprintf(DEBUG, "[orbisAudio] audio channel %u already initialized",channel);
             }
         }
     }
     return -1;
 }
 
+// the callback and its user data change together at the next block, the old pair may still run until then
 int orbisAudioSetCallback(unsigned int channel,OrbisAudioCallback callback,void *userdata)
 {
-    if(channel > ORBISAUDIO_CHANNELS) return 0;
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
+    OrbisAudioControl  cmd = { .type = ORBISAUDIO_CONTROL_CALLBACK, .callback = callback, .userData = userdata };
 
-    if(orbisAudioConf)
+    if(!ch || channel >= ORBISAUDIO_CHANNELS) return 0;
+
+    return orbisAudioControlPush(ch, &cmd);
+}
+
+// queued like the other controls: pacing and the deadline it starts from belong to the rendering thread
+int orbisAudioSetPacing(unsigned int channel, int mode)
+{
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
+    OrbisAudioControl  cmd = { .type = ORBISAUDIO_CONTROL_PACING, .l = (unsigned int)mode };
+
+    if(!ch) return 0;
+    if(mode < ORBISAUDIO_PACING_POLL || mode > ORBISAUDIO_PACING_BLOCKING) return 0;
+
+    return orbisAudioControlPush(ch, &cmd);
+}
+
+/*
+ * Per channel gain, ORBISAUDIO_VOLUME_MAX is unity. Applied in software on
+ * every block before output; mono channels use the left volume.
+ */
+int orbisAudioSetVolume(unsigned int channel, unsigned int l, unsigned int r)
+{
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
+
+    OrbisAudioControl  cmd = { .type = ORBISAUDIO_CONTROL_VOLUME };
+
+    if(!ch) return 0;
+    if(l > ORBISAUDIO_VOLUME_MAX) l = ORBISAUDIO_VOLUME_MAX;
+    if(r > ORBISAUDIO_VOLUME_MAX) r = ORBISAUDIO_VOLUME_MAX;
+
+    cmd.l = l;
+    cmd.r = r;
+    return orbisAudioControlPush(ch, &cmd);
+}
+
+// how long volume changes take from now on, 0 switches at once
+int orbisAudioSetVolumeRamp(unsigned int channel, unsigned int ms)
+{
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
+    OrbisAudioControl  cmd = { .type = ORBISAUDIO_CONTROL_RAMP, .l = ms };
+
+    // ORBISAUDIO_CHANNEL_MASTER sets the master volume's
+    if(!ch) return 0;
+
+    return orbisAudioControlPush(ch, &cmd);
+}
+
+/*
+ * Switch to another callback over ms with an equal power crossfade, both
+ * callbacks run until it ends. Fades in over silence, a ring or a stream
+ * just the same. orbisAudioControlDone on the result only says it started.
+ */
+int orbisAudioCrossfade(unsigned int channel, OrbisAudioCallback callback, void *userdata, unsigned int ms)
+{
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
+    OrbisAudioControl  cmd = { .type = ORBISAUDIO_CONTROL_CROSSFADE, .l = ms, .callback = callback, .userData = userdata };
+
+    if(!ch || channel >= ORBISAUDIO_CHANNELS) return 0;
+    if(ch->callerDriven) { fprintf(ERROR, "[orbisAudio] audio channel %u is fed by orbisAudioPlayBlock, nothing to crossfade\n", channel); return 0; }
+
+    return orbisAudioControlPush(ch, &cmd);
+}
+
+// queue depth, between ORBISAUDIO_MIN_BUFFERS and ORBISAUDIO_MAX_BUFFERS, set before the channel is initialized
+int orbisAudioSetNumBuffers(unsigned int channel, unsigned int num)
+{
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
+
+    if(!ch || channel >= ORBISAUDIO_CHANNELS) return 0;
+    if(ch->orbisaudiochannel_initialized == 1) { fprintf(ERROR, "[orbisAudio] audio channel %u already initialized\n", channel); return 0; }
+
+    if(num < ORBISAUDIO_MIN_BUFFERS) num = ORBISAUDIO_MIN_BUFFERS;
+    if(num > ORBISAUDIO_MAX_BUFFERS) num = ORBISAUDIO_MAX_BUFFERS;
+    ch->numBuffers = num;
+
+    return 1;
+}
+
+/*
+ * End-to-end queued latency: a block rendered now waits behind numBuffers-2
+ * queued blocks plus the one the device is playing.
+ */
+int orbisAudioGetLatency(unsigned int channel, unsigned int *samples, unsigned int *usec)
+{
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
+    unsigned int queued;
+
+    if(!ch || ch->orbisaudiochannel_initialized != 1) return -1;
+
+    // mixer inputs are queued behind the mixer's own output
+    if(ch->audioHandle <= 0 && orbisAudioConf->master) ch = orbisAudioConf->master;
+
+    queued = (ch->numBuffers - 1) * ch->samples[0];
+    if(samples) *samples = queued;
+    if(usec)    *usec    = (unsigned int)((uint64_t)queued * 1000000 / (ch->frequency ? ch->frequency : 48000));
+
+    return 0;
+}
+
+// join the thread of a channel, it is stopped either per channel or globally
+static void orbisAudioJoinChannel(OrbisAudioChannel *ch)
+{
+    if(ch->threadHandle)
     {
-        if(orbisAudioConf->channels[channel])
-        {
-            orbisAudioConf->channels[channel]->callback = NULL;
-            orbisAudioConf->channels[channel]->userData = userdata;
-            orbisAudioConf->channels[channel]->callback = callback;
-        }
+        pthread_join(ch->threadHandle, NULL);
+        ch->threadHandle = 0;
     }
+}
+
+// lock-free snapshot, counters may be a block apart from each other
+int orbisAudioGetStats(unsigned int channel, OrbisAudioStats *stats)
+{
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
+    const uint64_t *src;
+    uint64_t *dst;
+
+    if(!ch || !stats) return -1;
+
+    src = (const uint64_t *)&ch->stats;
+    dst = (uint64_t *)stats;
+    for(unsigned int i=0; i<sizeof(OrbisAudioStats)/sizeof(uint64_t); i++) dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+
+    stats->meanLatenessUs = stats->latenessCount ? stats->latenessSumUs / stats->latenessCount : 0;
+
+    return 0;
+}
+
+/*
+ * Samples of a channel played out as of a timestamp, for syncing video or
+ * game events to what is heard. Lock free, from any thread. Mixer inputs have
+ * no port of their own and report the mixer's.
+ */
+int orbisAudioGetClock(unsigned int channel, OrbisAudioClock *clock)
+{
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
+    uint32_t seq;
+
+    if(!ch || !clock || __atomic_load_n(&ch->orbisaudiochannel_initialized, __ATOMIC_ACQUIRE) != 1) return -1;
+    if(ch->audioHandle <= 0 && orbisAudioConf->master) ch = orbisAudioConf->master;
+
+    do
+    {
+        seq = __atomic_load_n(&ch->clockSeq, __ATOMIC_ACQUIRE);
+        clock->samples = __atomic_load_n(&ch->clockSamples, __ATOMIC_RELAXED);
+        clock->timeUs  = __atomic_load_n(&ch->clockTimeUs, __ATOMIC_RELAXED);
+        clock->queued  = __atomic_load_n(&ch->clockQueued, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while((seq & 1) || seq != __atomic_load_n(&ch->clockSeq, __ATOMIC_RELAXED));
+
+    clock->frequency = ch->frequency ? ch->frequency : 48000;
+
+    return 0;
+}
+
+// the clock extrapolated to now at the port rate, never past what was submitted so it can't run backwards
+uint64_t orbisAudioGetPlayedSamples(unsigned int channel)
+{
+    OrbisAudioClock clock;
+    uint64_t        elapsed;
+
+    if(orbisAudioGetClock(channel, &clock) || !clock.timeUs) return 0;
+
+    elapsed = (orbisAudioGetTimeUs() - clock.timeUs) * clock.frequency / 1000000;
+    if(elapsed > clock.queued) elapsed = clock.queued;
+
+    return clock.samples + elapsed;
+}
+
+// set before the channel is initialized, only used when its frequency is not the port's
+int orbisAudioSetResampleQuality(unsigned int channel, int quality)
+{
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
+
+    if(!ch || channel >= ORBISAUDIO_CHANNELS) return 0;
+    if(quality < ORBISAUDIO_RESAMPLE_FAST || quality > ORBISAUDIO_RESAMPLE_BEST) return 0;
+
+    ch->resampleQuality = quality;
     return 1;
 }
 
-int orbisAudioStop()
+// set before the channel is initialized: a mono source gets a stereo port so its left and right volume pan it
+int orbisAudioSetUpmix(unsigned int channel, int upmix)
 {
-    if(orbisAudioConf) orbisAudioConf->orbisaudio_stop = 1; sleep(1);
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
 
+    if(!ch || channel >= ORBISAUDIO_CHANNELS) return 0;
+    if(ch->orbisaudiochannel_initialized == 1) { fprintf(ERROR, "[orbisAudio] audio channel %u already initialized\n", channel); return 0; }
+
+    ch->upmix = upmix ? 1 : 0;
     return 1;
 }
 
-int orbisAudioResume(unsigned int channel)
+/*
+ * Set before the channel is initialized to turn rate control on, the channel
+ * then always goes through the resampler. Afterwards only the target can be
+ * moved. targetFrames is at the source rate and must leave room in the ring.
+ */
+int orbisAudioSetRateControl(unsigned int channel, unsigned int targetFrames)
 {
-    if (channel > ORBISAUDIO_CHANNELS) return 0;
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
 
-    if(orbisAudioConf)
+    if(!ch || channel >= ORBISAUDIO_CHANNELS) return 0;
+    if(ch->orbisaudiochannel_initialized == 1 && (!ch->rateTarget || !targetFrames))
     {
-        if(orbisAudioConf->channels[channel]) orbisAudioConf->channels[channel]->paused = 0;
+        fprintf(ERROR, "[orbisAudio] rate control of audio channel %u is switched on or off before it is initialized\n", channel);
+        return 0;
     }
+
+    __atomic_store_n(&ch->rateTarget, targetFrames, __ATOMIC_RELAXED);
     return 1;
 }
 
-int orbisAudioPause(unsigned int channel)
+// telemetry: the ratio applied on top of the nominal one and the smoothed ring fill it was steered from
+int orbisAudioGetRateControl(unsigned int channel, float *ratio, unsigned int *fill)
 {
-    if (channel > ORBISAUDIO_CHANNELS) return 0;
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
 
-    if(orbisAudioConf!=NULL)
+    if(!ch || channel >= ORBISAUDIO_CHANNELS || !ch->rateTarget) return -1;
+
+    if(ratio) *ratio = 1.0f + __atomic_load_n(&ch->ratePpm, __ATOMIC_RELAXED) * 1e-6f;
+    if(fill)  *fill  = __atomic_load_n(&ch->rateFill, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+int orbisAudioStop()
+{
+    if(orbisAudioConf)
     {
-        if(orbisAudioConf->channels[channel]) orbisAudioConf->channels[channel]->paused = 1;
+        __atomic_store_n(&orbisAudioConf->orbisaudio_stop, 1, __ATOMIC_RELAXED);
+        for(int i=0; i<ORBISAUDIO_CHANNELS; i++)
+        {
+            if(orbisAudioConf->channels[i]) orbisAudioJoinChannel(orbisAudioConf->channels[i]);
+        }
     }
     return 1;
 }
 
+// stop one channel, close its port and free its buffers, the others keep playing
+int orbisAudioFinishChannel(unsigned int channel)
+{
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
+
+    if(!ch || channel >= ORBISAUDIO_CHANNELS) return -1;
+    if(ch->orbisaudiochannel_initialized != 1) return -1;
+
+    __atomic_store_n(&ch->stop, 1, __ATOMIC_RELAXED);
+    orbisAudioJoinChannel(ch);
+
+    // a mixer input has no thread: take it out of the mix and let the mixer finish its block
+    if(ch->audioHandle <= 0 && orbisAudioConf->master)
+    {
+        __atomic_store_n(&ch->orbisaudiochannel_initialized, 0, __ATOMIC_RELEASE);
+        orbisAudioMixerSync();
+    }
+
+    // mixer inputs have no port of their own
+    if(ch->audioHandle > 0) orbisAudioBackendClose(ch->audioHandle);
+    fprintf(DEBUG, "[orbisAudio] closing audio handle %u\n", channel);
+
+    ch->audioHandle = -1;
+    ch->offline     = 0;
+    // nothing renders the channel anymore, settle what is still queued
+    orbisAudioControlApply(ch);
+    orbisAudioStreamDetach(ch);
+    orbisAudioTapDetach(ch);
+    orbisAudioDestroyBuffersChannel(channel);
+    fprintf(DEBUG, "[orbisAudio] free buffers channel %u\n", channel);
+
+    ch->orbisaudiochannel_initialized = -1;
+
+    return 0;
+}
+
+int orbisAudioResume(unsigned int channel)
+{
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
+    OrbisAudioControl  cmd = { .type = ORBISAUDIO_CONTROL_RESUME };
+
+    if(!ch || channel >= ORBISAUDIO_CHANNELS) return 0;
+
+    return orbisAudioControlPush(ch, &cmd);
+}
+
+int orbisAudioPause(unsigned int channel)
+{
+    OrbisAudioControl  cmd = { .type = ORBISAUDIO_CONTROL_PAUSE };
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
+
+    if(!ch || channel >= ORBISAUDIO_CHANNELS) return 0;
+
+    return orbisAudioControlPush(ch, &cmd);
+}
+
 void orbisAudioFinish()
 {
     //pthread_mutex_destroy(&wait_mutex);
@@ -551,28 +1116,18 @@ void orbisAudioFinish()
     if(orbisAudioConf)
     {
         orbisAudioStop();
+        orbisAudioStreamShutdown();
+        orbisAudioTapShutdown();
+        orbisAudioFinishMixer();
         for(i=0;i<ORBISAUDIO_CHANNELS;i++)
         {
-            if(orbisAudioConf->channels[i])
-            {
-                if(orbisAudioConf->channels[i]->orbisaudiochannel_initialized==1)
-                {
-                    //scePthreadCancel(orbisAudioConf->channels[i]->threadHandle);
-                    orbisAudioConf->channels[i]->threadHandle=0;
-
-                    sceAudioOutClose(orbisAudioConf->channels[i]->audioHandle);
-                    fprintf(DEBUG, "[orbisAudio] closing audio handle\n");
-                    
-                    orbisAudioConf->channels[i]->audioHandle=-1;
-                    orbisAudioDestroyBuffersChannel(i);
-                    fprintf(DEBUG, "[orbisAudio] free buffers channel\n");
-                    
-                    orbisAudioConf->channels[i]->orbisaudiochannel_initialized=-1;  
-                }
-                //free(orbisAudioConf->channels[i]);
-            }
+            if(orbisAudioConf->channels[i]) orbisAudioFinishChannel(i);
         }
-        //free(orbisAudioConf);
+        orbisAudioBackendShutdown();
+
+        // an external config is the caller's, ours goes away with the arena
+        if(orbisaudio_external_conf != 1) orbisAudioConf = NULL;
+        orbisAudioArenaRelease();
         fprintf(DEBUG, "[orbisAudio] finished\n");
     }
 }
@@ -581,19 +1136,23 @@ int orbisAudioInit()
 {
     //pthread_mutex_init(&wait_mutex, NULL);// = PTHREAD_MUTEX_INITIALIZER;
 
-    int ret = sceAudioOutInit();
+    int ret;
+
+    if(orbisAudioArenaInit()) return -1;
+
+    ret = orbisAudioBackendInit();
     if(ret<0)
     {
-        fprintf(ERROR, "[orbisAudio] sceAudioOutInit error 0x%08X\n",ret); return -1;
+        fprintf(ERROR, "[orbisAudio] orbisAudioBackendInit error 0x%08X\n",ret); return -1;
     }
-    fprintf(DEBUG, "[orbisAudio] sceAudioOutInit return %d\n",ret);
+    fprintf(DEBUG, "[orbisAudio] orbisAudioBackendInit return %d\n",ret);
 
     if(orbisAudioCreateConf() == 0)
     {
         fprintf(DEBUG, "[orbisAudio] initialized!\n");
         return orbisAudioConf->orbisaudio_initialized;
     }
-    if (orbisAudioConf->orbisaudio_initialized == 1) 
+    if (orbisAudioConf && orbisAudioConf->orbisaudio_initialized == 1) 
     {
         fprintf(DEBUG, "[orbisAudio] is already initialized!\n");
         return orbisAudioConf->orbisaudio_initialized;
@@ -0,0 +1,183 @@
+/*
+#  ____   ____    ____         ___ ____   ____ _     _
+# |    |  ____>   ____>  |    |        | <____  \   /
+# |____| |    \   ____>  | ___|    ____| <____   \_/    ORBISDEV Open Source Project.
+#------------------------------------------------------------------------------------
+# Copyright 2010-2020, orbisdev - http://orbisdev.github.io
+# Licenced under the MIT license
+# Review README & LICENSE files for further details.
+*/
+
+/*
+ * IMA ADPCM, 4 bits a sample. The layout is our own (see the header) with
+ * the usual step and index tables. Every block starts from the predictor and
+ * step index in its header, so decoding can begin at any block, and the
+ * encoder writes the true sample there so errors never carry over. The
+ * decoder computes the difference as a multiply rather than the bit by bit
+ * sum of the reference code, no branches on the code bits; the encoder
+ * runs the same decoder so both sides always agree.
+ */
+
+#include <string.h>
+
+#include "orbisAudioInternal.h"
+
+
+#define ORBISAUDIO_ADPCM_HEADER		4
+
+static const short orbisAudioAdpcmSteps[89] =
+{
+        7,     8,     9,    10,    11,    12,    13,    14,    16,    17,
+       19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+       50,    55,    60,    66,    73,    80,    88,    97,   107,   118,
+      130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+      337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+      876,   963,  1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+     2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+     5894,  6484,  7132,  7845,  8630,  9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const signed char orbisAudioAdpcmIndex[16] =
+{
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+
+static size_t orbisAudioAdpcmBlockBytes(unsigned int channels)
+{
+    return channels * (ORBISAUDIO_ADPCM_HEADER + ORBISAUDIO_ADPCM_BLOCK_FRAMES / 2);
+}
+
+size_t orbisAudioAdpcmBytes(unsigned int frames, unsigned int channels)
+{
+    return (size_t)((frames + ORBISAUDIO_ADPCM_BLOCK_FRAMES - 1) / ORBISAUDIO_ADPCM_BLOCK_FRAMES) * orbisAudioAdpcmBlockBytes(channels);
+}
+
+static inline int orbisAudioAdpcmNibble(int *pred, int *index, unsigned int code)
+{
+    int step = orbisAudioAdpcmSteps[*index];
+    int diff = ((int)(2 * (code & 7) + 1) * step) >> 3;
+    int sign = -(int)(code >> 3);
+    int p    = *pred + ((diff ^ sign) - sign);
+    int i    = *index + orbisAudioAdpcmIndex[code];
+
+    p = p < -32768 ? -32768 : p > 32767 ? 32767 : p;
+    i = i < 0 ? 0 : i > 88 ? 88 : i;
+    *pred  = p;
+    *index = i;
+
+    return p;
+}
+
+// frames from st->next on, into dst with channels interleaved, or just skipped when dst is NULL
+void orbisAudioAdpcmRead(OrbisAudioAdpcmState *st, const OrbisAudioSound *sound, short *dst, unsigned int frames)
+{
+    const uint8_t *base = (const uint8_t *)sound->data;
+    unsigned int   sc   = sound->channels;
+    size_t         blockBytes = orbisAudioAdpcmBlockBytes(sc);
+
+    while(frames)
+    {
+        unsigned int   k   = st->next % ORBISAUDIO_ADPCM_BLOCK_FRAMES;
+        unsigned int   n   = ORBISAUDIO_ADPCM_BLOCK_FRAMES - k;
+        const uint8_t *blk = base + (st->next / ORBISAUDIO_ADPCM_BLOCK_FRAMES) * blockBytes;
+
+        if(n > frames) n = frames;
+
+        for(unsigned int c=0; c<sc; c++)
+        {
+            const uint8_t *codes = blk + sc * ORBISAUDIO_ADPCM_HEADER + c * (ORBISAUDIO_ADPCM_BLOCK_FRAMES / 2);
+            int pred, index;
+
+            if(k == 0)
+            {
+                st->pred[c]  = (short)(blk[c * ORBISAUDIO_ADPCM_HEADER] | blk[c * ORBISAUDIO_ADPCM_HEADER + 1] << 8);
+                st->index[c] = blk[c * ORBISAUDIO_ADPCM_HEADER + 2] > 88 ? 88 : blk[c * ORBISAUDIO_ADPCM_HEADER + 2];
+            }
+            pred  = st->pred[c];
+            index = st->index[c];
+
+            if(dst)
+                for(unsigned int j=k; j<k+n; j++) dst[(j-k) * sc + c] = (short)orbisAudioAdpcmNibble(&pred, &index, (codes[j >> 1] >> ((j & 1) * 4)) & 15);
+            else
+                for(unsigned int j=k; j<k+n; j++) orbisAudioAdpcmNibble(&pred, &index, (codes[j >> 1] >> ((j & 1) * 4)) & 15);
+
+            st->pred[c]  = pred;
+            st->index[c] = index;
+        }
+        st->next += n;
+        frames   -= n;
+        if(dst) dst += n * sc;
+    }
+}
+
+// make frame the next one read, decoding on from where the state is when that is shorter than from its block start
+void orbisAudioAdpcmSeek(OrbisAudioAdpcmState *st, const OrbisAudioSound *sound, unsigned int frame)
+{
+    unsigned int k = frame % ORBISAUDIO_ADPCM_BLOCK_FRAMES;
+
+    if(frame >= st->next && frame - st->next <= k)
+    {
+        orbisAudioAdpcmRead(st, sound, NULL, frame - st->next);
+        return;
+    }
+    st->next = frame - k;
+    orbisAudioAdpcmRead(st, sound, NULL, k);
+}
+
+// frames of sound from first on, as s16 with channels interleaved
+int orbisAudioAdpcmDecode(short *dst, const OrbisAudioSound *sound, unsigned int first, unsigned int frames)
+{
+    OrbisAudioAdpcmState st;
+
+    if(!dst || !sound || !sound->data || sound->encoding != ORBISAUDIO_ENCODING_ADPCM) return -1;
+    if(sound->channels < 1 || sound->channels > 2 || first > sound->frames || frames > sound->frames - first) return -1;
+
+    st.next = ~0u;
+    orbisAudioAdpcmSeek(&st, sound, first);
+    orbisAudioAdpcmRead(&st, sound, dst, frames);
+
+    return 0;
+}
+
+// dst holds orbisAudioAdpcmBytes(frames, channels), offline or at load, not on the audio threads
+int orbisAudioAdpcmEncode(void *dst, const short *src, unsigned int frames, unsigned int channels)
+{
+    uint8_t *out = (uint8_t *)dst;
+    int      index[2] = { 0, 0 };
+
+    if(!dst || !src || channels < 1 || channels > 2) return -1;
+    memset(dst, 0, orbisAudioAdpcmBytes(frames, channels));
+
+    for(unsigned int start=0; start<frames; start+=ORBISAUDIO_ADPCM_BLOCK_FRAMES, out+=orbisAudioAdpcmBlockBytes(channels))
+    {
+        unsigned int n = frames - start < ORBISAUDIO_ADPCM_BLOCK_FRAMES ? frames - start : ORBISAUDIO_ADPCM_BLOCK_FRAMES;
+
+        for(unsigned int c=0; c<channels; c++)
+        {
+            uint8_t *codes = out + channels * ORBISAUDIO_ADPCM_HEADER + c * (ORBISAUDIO_ADPCM_BLOCK_FRAMES / 2);
+            int      pred  = src[start * channels + c];
+
+            out[c * ORBISAUDIO_ADPCM_HEADER]     = pred & 0xff;
+            out[c * ORBISAUDIO_ADPCM_HEADER + 1] = (pred >> 8) & 0xff;
+            out[c * ORBISAUDIO_ADPCM_HEADER + 2] = index[c];
+
+            for(unsigned int j=0; j<n; j++)
+            {
+                int          d    = src[(start + j) * channels + c] - pred;
+                unsigned int code = 0, q;
+
+                if(d < 0) { code = 8; d = -d; }
+                // the decoder reconstructs (2q+1)/8 of a step, the nearest one is 4d/step
+                q = (unsigned int)(4 * d / orbisAudioAdpcmSteps[index[c]]);
+                code |= q > 7 ? 7 : q;
+
+                orbisAudioAdpcmNibble(&pred, &index[c], code);
+                codes[j >> 1] |= code << ((j & 1) * 4);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,193 @@
+/*
+#  ____   ____    ____         ___ ____   ____ _     _
+# |    |  ____>   ____>  |    |        | <____  \   /
+# |____| |    \   ____>  | ___|    ____| <____   \_/    ORBISDEV Open Source Project.
+#------------------------------------------------------------------------------------
+# Copyright 2010-2020, orbisdev - http://orbisdev.github.io
+# Licenced under the MIT license
+# Review README & LICENSE files for further details.
+*/
+
+/*
+ * Memory arena: all library state and buffers come from one block, supplied
+ * by the caller with orbisAudioSetArena or allocated once at init. The block
+ * is split in regions, one bump allocator each:
+ *  - one per channel and one for the mixer master, reset when the channel
+ *    (or the mixer) is finished so it can be opened again
+ *  - a global one for the config and the channel structs
+ * Every allocation is 64 byte aligned and rounded up to 64 bytes, so SIMD
+ * loads never split a cache line and no two channels share one.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#if !defined (__PS4__)
+#include <sys/mman.h>  // mlock()
+#endif
+
+#include "orbisAudioInternal.h"
+
+
+#define ORBISAUDIO_ARENA_ALIGN		64
+#define ORBISAUDIO_ARENA_GLOBAL		(ORBISAUDIO_CHANNEL_MASTER + 1)
+#define ORBISAUDIO_ARENA_REGIONS	(ORBISAUDIO_ARENA_GLOBAL + 1)
+
+typedef struct OrbisAudioArenaRegion
+{
+    uint8_t *base;
+    size_t   size;
+    size_t   used;
+} OrbisAudioArenaRegion;
+
+static struct
+{
+    void    *userMem;    // from orbisAudioSetArena, NULL to allocate our own
+    size_t   userSize;
+    int      flags;
+    void    *alloc;      // our own block, freed on release
+    uint8_t *base;
+    size_t   size;
+    int      locked;
+    OrbisAudioArenaRegion regions[ORBISAUDIO_ARENA_REGIONS];
+} orbisAudioArena;
+
+
+static size_t orbisAudioArenaRound(size_t bytes)
+{
+    return (bytes + ORBISAUDIO_ARENA_ALIGN - 1) & ~(size_t)(ORBISAUDIO_ARENA_ALIGN - 1);
+}
+
+static size_t orbisAudioArenaGlobalBytes(void)
+{
+    return orbisAudioArenaRound(sizeof(OrbisAudioConfig)) + ORBISAUDIO_CHANNELS * orbisAudioArenaRound(sizeof(OrbisAudioChannel));
+}
+
+// arena size for channelBytes per channel (0 for ORBISAUDIO_ARENA_CHANNEL_SIZE), alignment slack included
+size_t orbisAudioGetArenaSize(size_t channelBytes)
+{
+    if(!channelBytes) channelBytes = ORBISAUDIO_ARENA_CHANNEL_SIZE;
+    return ORBISAUDIO_ARENA_ALIGN + orbisAudioArenaGlobalBytes() + (ORBISAUDIO_CHANNEL_MASTER + 1) * orbisAudioArenaRound(channelBytes);
+}
+
+// before orbisAudioInit: mem may be NULL to have size bytes allocated once, size 0 is the default size
+int orbisAudioSetArena(void *mem, size_t size, int flags)
+{
+    if(orbisAudioArena.base) { fprintf(ERROR, "[orbisAudio] arena already in use\n"); return -1; }
+    if(mem && !size) { fprintf(ERROR, "[orbisAudio] arena size missing\n"); return -1; }
+    if(size && size < orbisAudioGetArenaSize(ORBISAUDIO_ARENA_ALIGN))
+    {
+        fprintf(ERROR, "[orbisAudio] arena of %zu bytes is too small\n", size); return -1;
+    }
+
+    orbisAudioArena.userMem  = mem;
+    orbisAudioArena.userSize = size;
+    orbisAudioArena.flags    = flags;
+
+    return 0;
+}
+
+int orbisAudioArenaInit(void)
+{
+    size_t   size = orbisAudioArena.userSize ? orbisAudioArena.userSize : orbisAudioGetArenaSize(0);
+    size_t   global, per;
+    uint8_t *p, *end;
+
+    if(orbisAudioArena.base) return 0;
+
+    if(orbisAudioArena.userMem) orbisAudioArena.base = orbisAudioArena.userMem;
+    else
+    {
+        orbisAudioArena.alloc = malloc(size);
+        if(!orbisAudioArena.alloc) { fprintf(ERROR, "[orbisAudio] can't allocate a %zu bytes arena\n", size); return -1; }
+        orbisAudioArena.base = orbisAudioArena.alloc;
+    }
+    orbisAudioArena.size = size;
+
+    // touch every page now rather than on the audio threads
+    memset(orbisAudioArena.base, 0, size);
+
+    if(orbisAudioArena.flags & ORBISAUDIO_ARENA_LOCK)
+    {
+#if defined (__PS4__)
+        // user memory is never paged out on the console
+        orbisAudioArena.locked = 0;
+#else
+        orbisAudioArena.locked = (mlock(orbisAudioArena.base, size) == 0);
+        if(!orbisAudioArena.locked) fprintf(DEBUG, "[orbisAudio] can't lock the arena in memory, running unlocked\n");
+#endif
+    }
+
+    p   = (uint8_t *)orbisAudioArenaRound((uintptr_t)orbisAudioArena.base);
+    end = orbisAudioArena.base + size;
+
+    global = orbisAudioArenaGlobalBytes();
+    orbisAudioArena.regions[ORBISAUDIO_ARENA_GLOBAL].base = p;
+    orbisAudioArena.regions[ORBISAUDIO_ARENA_GLOBAL].size = global;
+    p += global;
+
+    per = ((size_t)(end - p) / (ORBISAUDIO_CHANNEL_MASTER + 1)) & ~(size_t)(ORBISAUDIO_ARENA_ALIGN - 1);
+    for(int r=0; r<=ORBISAUDIO_CHANNEL_MASTER; r++)
+    {
+        orbisAudioArena.regions[r].base = p;
+        orbisAudioArena.regions[r].size = per;
+        orbisAudioArena.regions[r].used = 0;
+        p += per;
+    }
+    fprintf(DEBUG, "[orbisAudio] arena of %zu bytes, %zu per channel%s\n", size, per, orbisAudioArena.locked ? ", locked" : "");
+
+    return 0;
+}
+
+/*
+ * Bump allocation from a channel region, ORBISAUDIO_CHANNEL_MASTER for the
+ * mixer, or from the global one when channel is ORBISAUDIO_ARENA_GLOBAL.
+ * Only used while initializing, never on the audio threads.
+ */
+void *orbisAudioArenaAlloc(unsigned int channel, size_t bytes)
+{
+    OrbisAudioArenaRegion *r;
+    void *p;
+
+    if(channel >= ORBISAUDIO_ARENA_REGIONS) return NULL;
+    if(!orbisAudioArena.base && orbisAudioArenaInit()) return NULL;
+
+    r     = &orbisAudioArena.regions[channel];
+    bytes = orbisAudioArenaRound(bytes);
+    if(r->used + bytes > r->size)
+    {
+        fprintf(ERROR, "[orbisAudio] arena region %u exhausted, %zu of %zu bytes used, %zu more needed\n", channel, r->used, r->size, bytes);
+        return NULL;
+    }
+    p        = r->base + r->used;
+    r->used += bytes;
+
+    return p;
+}
+
+void *orbisAudioArenaAllocGlobal(size_t bytes)
+{
+    return orbisAudioArenaAlloc(ORBISAUDIO_ARENA_GLOBAL, bytes);
+}
+
+// everything allocated from the region is gone
+void orbisAudioArenaReset(unsigned int channel)
+{
+    if(channel < ORBISAUDIO_ARENA_REGIONS) orbisAudioArena.regions[channel].used = 0;
+}
+
+// called by orbisAudioFinish, the caller's settings stay for the next orbisAudioInit
+void orbisAudioArenaRelease(void)
+{
+    if(!orbisAudioArena.base) return;
+
+#if !defined (__PS4__)
+    if(orbisAudioArena.locked) munlock(orbisAudioArena.base, orbisAudioArena.size);
+#endif
+    free(orbisAudioArena.alloc);
+
+    orbisAudioArena.alloc  = NULL;
+    orbisAudioArena.base   = NULL;
+    orbisAudioArena.size   = 0;
+    orbisAudioArena.locked = 0;
+    memset(orbisAudioArena.regions, 0, sizeof(orbisAudioArena.regions));
+}
@@ -0,0 +1,415 @@
+/*
+#  ____   ____    ____         ___ ____   ____ _     _
+# |    |  ____>   ____>  |    |        | <____  \   /
+# |____| |    \   ____>  | ___|    ____| <____   \_/    ORBISDEV Open Source Project.
+#------------------------------------------------------------------------------------
+# Copyright 2010-2020, orbisdev - http://orbisdev.github.io
+# Licenced under the MIT license
+# Review README & LICENSE files for further details.
+*/
+
+/*
+ * Output backends. The library only talks to the selected vtable:
+ *  - sce:       sceAudioOut on PS4
+ *  - libao:     default audio device on pc (HAVE_LIBAO)
+ *  - null:      discards blocks, paced in real time like a device
+ *  - null fast: discards blocks as fast as possible
+ *  - wav:       writes every port to a 16 bit PCM wav file
+ *  - offline:   null fast ports without audio threads, see orbisAudioRenderOffline
+ * Host backends share a small port table, handles are table index + 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "orbisAudioInternal.h"
+
+#if defined HAVE_LIBAO
+#include <ao/ao.h>
+#endif
+
+
+#define ORBISAUDIO_BACKEND_PORTS 8
+
+typedef struct OrbisAudioPort
+{
+    int          used;
+    unsigned int samples;
+    unsigned int frequency;
+    unsigned int channels;
+    uint64_t     nextDeadline;
+    FILE        *fp;
+    uint32_t     dataBytes;
+#if defined HAVE_LIBAO
+    ao_device   *device;
+#endif
+} OrbisAudioPort;
+
+static OrbisAudioPort orbisAudioPorts[ORBISAUDIO_BACKEND_PORTS];
+static const OrbisAudioBackend *orbisAudioBackend = NULL;
+static int  orbisAudioBackendId = ORBISAUDIO_BACKEND_DEFAULT;
+static char orbisAudioBackendPath[256] = "orbisAudio_%d.wav";
+
+
+static int orbisAudioPortAlloc(unsigned int samples, unsigned int frequency, int format)
+{
+    for(int i=0; i<ORBISAUDIO_BACKEND_PORTS; i++)
+    {
+        if(!orbisAudioPorts[i].used)
+        {
+            memset(&orbisAudioPorts[i], 0, sizeof(OrbisAudioPort));
+            orbisAudioPorts[i].used      = 1;
+            orbisAudioPorts[i].samples   = samples;
+            orbisAudioPorts[i].frequency = frequency ? frequency : 48000;
+            orbisAudioPorts[i].channels  = (format == ORBISAUDIO_FORMAT_S16_STEREO) ? 2 : 1;
+            return i + 1;
+        }
+    }
+    fprintf(ERROR, "[orbisAudio] no free backend port\n");
+    return -1;
+}
+
+static OrbisAudioPort *orbisAudioPortGet(int handle)
+{
+    if(handle < 1 || handle > ORBISAUDIO_BACKEND_PORTS) return NULL;
+    if(!orbisAudioPorts[handle - 1].used) return NULL;
+    return &orbisAudioPorts[handle - 1];
+}
+
+static size_t orbisAudioPortBytes(OrbisAudioPort *port)
+{
+    return (size_t)port->samples * port->channels * sizeof(short);
+}
+
+static int orbisAudioHostInit(void)
+{
+    memset(orbisAudioPorts, 0, sizeof(orbisAudioPorts));
+    return 1;
+}
+
+static void orbisAudioHostClose(int handle)
+{
+    OrbisAudioPort *port = orbisAudioPortGet(handle);
+    if(port) port->used = 0;
+}
+
+static void orbisAudioHostShutdown(void)
+{
+}
+
+
+#if defined (__PS4__)
+
+static int orbisAudioSceInit(void)
+{
+    return sceAudioOutInit();
+}
+
+static int orbisAudioSceOpen(int type, unsigned int samples, unsigned int frequency, int format)
+{
+    return sceAudioOutOpen(0xff, type, 0, samples, frequency, format);
+}
+
+static int orbisAudioSceOutput(int handle, void *buf)
+{
+    return sceAudioOutOutput(handle, buf);
+}
+
+static void orbisAudioSceClose(int handle)
+{
+    sceAudioOutClose(handle);
+}
+
+static const OrbisAudioBackend orbisAudioBackendSce =
+{
+    "sce", orbisAudioSceInit, orbisAudioSceOpen, orbisAudioSceOutput, orbisAudioSceClose, orbisAudioHostShutdown
+};
+
+#endif
+
+
+#if defined HAVE_LIBAO
+
+static int orbisAudioAoDriver = -1;
+
+// -- libao init --
+static int orbisAudioAoInit(void)
+{
+    orbisAudioHostInit();
+    // -- Setup for default audio driver --
+    ao_initialize();
+    // alsa pulls pulseaudio-alsa-plugin!
+    orbisAudioAoDriver = ao_driver_id("alsa"); // or let 'ao_default_driver_id();' autoselect default
+
+    return 1;
+}
+
+// -- libao open driver, one device per port in the port's own format --
+static int orbisAudioAoOpen(int type, unsigned int samples, unsigned int frequency, int format)
+{
+    ao_sample_format aoformat;
+    int handle = orbisAudioPortAlloc(samples, frequency, format);
+    OrbisAudioPort *port = orbisAudioPortGet(handle);
+
+    if(!port) return -1;
+
+    memset(&aoformat, 0, sizeof(aoformat));
+    aoformat.bits        = 16;
+    aoformat.channels    = port->channels;
+    aoformat.rate        = port->frequency;
+    aoformat.byte_format = AO_FMT_LITTLE;
+
+    port->device = ao_open_live(orbisAudioAoDriver, &aoformat, NULL);
+    if(port->device == NULL) { fprintf(ERROR, "Error opening device.\n"); port->used = 0; return -1; }
+
+    return handle;
+}
+
+// -- libao play audio --
+static int orbisAudioAoOutput(int handle, void *buf)
+{
+    OrbisAudioPort *port = orbisAudioPortGet(handle);
+
+    if(!port) return -1;
+    return ao_play(port->device, (char *)buf, orbisAudioPortBytes(port)) ? 1 : -1;
+}
+
+static void orbisAudioAoClose(int handle)
+{
+    OrbisAudioPort *port = orbisAudioPortGet(handle);
+
+    if(!port) return;
+    ao_close(port->device);
+    port->used = 0;
+}
+
+// -- libao end --
+static void orbisAudioAoShutdown(void)
+{
+    ao_shutdown();
+}
+
+static const OrbisAudioBackend orbisAudioBackendAo =
+{
+    "libao", orbisAudioAoInit, orbisAudioAoOpen, orbisAudioAoOutput, orbisAudioAoClose, orbisAudioAoShutdown
+};
+
+#endif
+
+
+static int orbisAudioNullOpen(int type, unsigned int samples, unsigned int frequency, int format)
+{
+    return orbisAudioPortAlloc(samples, frequency, format);
+}
+
+// behaves like a blocking device: returns when the previous block would have been consumed
+static int orbisAudioNullOutput(int handle, void *buf)
+{
+    OrbisAudioPort *port = orbisAudioPortGet(handle);
+    uint64_t now;
+
+    if(!port) return -1;
+
+    now = orbisAudioGetTimeUs();
+    if(port->nextDeadline == 0 || now > port->nextDeadline) port->nextDeadline = now;
+    else sceKernelUsleep(port->nextDeadline - now);
+
+    port->nextDeadline += (uint64_t)port->samples * 1000000 / port->frequency;
+
+    return 1;
+}
+
+static int orbisAudioNullFastOutput(int handle, void *buf)
+{
+    return orbisAudioPortGet(handle) ? 1 : -1;
+}
+
+static const OrbisAudioBackend orbisAudioBackendNull =
+{
+    "null", orbisAudioHostInit, orbisAudioNullOpen, orbisAudioNullOutput, orbisAudioHostClose, orbisAudioHostShutdown
+};
+
+static const OrbisAudioBackend orbisAudioBackendNullFast =
+{
+    "nullfast", orbisAudioHostInit, orbisAudioNullOpen, orbisAudioNullFastOutput, orbisAudioHostClose, orbisAudioHostShutdown
+};
+
+// null fast ports, the library starts no audio thread on it
+static const OrbisAudioBackend orbisAudioBackendOffline =
+{
+    "offline", orbisAudioHostInit, orbisAudioNullOpen, orbisAudioNullFastOutput, orbisAudioHostClose, orbisAudioHostShutdown
+};
+
+
+static void orbisAudioWavPut32(unsigned char *p, uint32_t v)
+{
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static void orbisAudioWavPut16(unsigned char *p, uint16_t v)
+{
+    p[0] = v; p[1] = v >> 8;
+}
+
+// canonical 44 byte header, sizes are patched on close; also used by the output tap
+void orbisAudioWavWriteHeader(FILE *fp, unsigned int channels, unsigned int frequency, uint32_t dataBytes)
+{
+    unsigned char h[44];
+
+    memcpy(h, "RIFF", 4);
+    orbisAudioWavPut32(h + 4, 36 + dataBytes);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    orbisAudioWavPut32(h + 16, 16);
+    orbisAudioWavPut16(h + 20, 1);
+    orbisAudioWavPut16(h + 22, channels);
+    orbisAudioWavPut32(h + 24, frequency);
+    orbisAudioWavPut32(h + 28, frequency * channels * sizeof(short));
+    orbisAudioWavPut16(h + 32, channels * sizeof(short));
+    orbisAudioWavPut16(h + 34, 16);
+    memcpy(h + 36, "data", 4);
+    orbisAudioWavPut32(h + 40, dataBytes);
+
+    fseek(fp, 0, SEEK_SET);
+    fwrite(h, 1, sizeof(h), fp);
+}
+
+static void orbisAudioWavHeader(OrbisAudioPort *port)
+{
+    orbisAudioWavWriteHeader(port->fp, port->channels, port->frequency, port->dataBytes);
+}
+
+static int orbisAudioWavOpen(int type, unsigned int samples, unsigned int frequency, int format)
+{
+    char name[sizeof(orbisAudioBackendPath) + 16];
+    int handle = orbisAudioPortAlloc(samples, frequency, format);
+    OrbisAudioPort *port = orbisAudioPortGet(handle);
+
+    if(!port) return -1;
+
+    // the path may contain a %d, replaced with the port type
+    snprintf(name, sizeof(name), orbisAudioBackendPath, type);
+    port->fp = fopen(name, "wb");
+    if(!port->fp) { fprintf(ERROR, "[orbisAudio] can't create %s\n", name); port->used = 0; return -1; }
+
+    orbisAudioWavHeader(port);
+    fprintf(DEBUG, "[orbisAudio] writing port %d to %s\n", handle, name);
+
+    return handle;
+}
+
+static int orbisAudioWavOutput(int handle, void *buf)
+{
+    OrbisAudioPort *port = orbisAudioPortGet(handle);
+    size_t bytes;
+
+    if(!port) return -1;
+
+    bytes = orbisAudioPortBytes(port);
+    if(fwrite(buf, 1, bytes, port->fp) != bytes) return -1;
+    port->dataBytes += bytes;
+
+    return 1;
+}
+
+static void orbisAudioWavClose(int handle)
+{
+    OrbisAudioPort *port = orbisAudioPortGet(handle);
+
+    if(!port) return;
+    orbisAudioWavHeader(port);
+    fclose(port->fp);
+    port->used = 0;
+}
+
+static const OrbisAudioBackend orbisAudioBackendWav =
+{
+    "wav", orbisAudioHostInit, orbisAudioWavOpen, orbisAudioWavOutput, orbisAudioWavClose, orbisAudioHostShutdown
+};
+
+
+// pick the output backend, must be called before orbisAudioInit
+int orbisAudioSetBackend(int backend, const char *path)
+{
+    if(orbisAudioBackend) { fprintf(ERROR, "[orbisAudio] backend %s already running\n", orbisAudioBackend->name); return -1; }
+
+    switch(backend)
+    {
+        case ORBISAUDIO_BACKEND_DEFAULT:
+        case ORBISAUDIO_BACKEND_NULL:
+        case ORBISAUDIO_BACKEND_NULL_FAST:
+        case ORBISAUDIO_BACKEND_WAV:
+        case ORBISAUDIO_BACKEND_OFFLINE:
+            break;
+#if defined (__PS4__)
+        case ORBISAUDIO_BACKEND_SCE:
+            break;
+#endif
+#if defined HAVE_LIBAO
+        case ORBISAUDIO_BACKEND_LIBAO:
+            break;
+#endif
+        default:
+            fprintf(ERROR, "[orbisAudio] backend %d is not available in this build\n", backend);
+            return -1;
+    }
+    orbisAudioBackendId = backend;
+
+    if(path)
+    {
+        strncpy(orbisAudioBackendPath, path, sizeof(orbisAudioBackendPath) - 1);
+        orbisAudioBackendPath[sizeof(orbisAudioBackendPath) - 1] = 0;
+    }
+    return 0;
+}
+
+int orbisAudioBackendInit(void)
+{
+    switch(orbisAudioBackendId)
+    {
+        case ORBISAUDIO_BACKEND_NULL:      orbisAudioBackend = &orbisAudioBackendNull;     break;
+        case ORBISAUDIO_BACKEND_NULL_FAST: orbisAudioBackend = &orbisAudioBackendNullFast; break;
+        case ORBISAUDIO_BACKEND_WAV:       orbisAudioBackend = &orbisAudioBackendWav;      break;
+        case ORBISAUDIO_BACKEND_OFFLINE:   orbisAudioBackend = &orbisAudioBackendOffline;  break;
+        default:
+#if defined (__PS4__)
+            orbisAudioBackend = &orbisAudioBackendSce;
+#elif defined HAVE_LIBAO
+            orbisAudioBackend = &orbisAudioBackendAo;
+#else
+            orbisAudioBackend = &orbisAudioBackendNull;
+#endif
+            break;
+    }
+    fprintf(DEBUG, "[orbisAudio] using %s backend\n", orbisAudioBackend->name);
+
+    return orbisAudioBackend->init();
+}
+
+int orbisAudioBackendOpen(int type, unsigned int samples, unsigned int frequency, int format)
+{
+    if(!orbisAudioBackend) return -1;
+    return orbisAudioBackend->open(type, samples, frequency, format);
+}
+
+int orbisAudioBackendOutput(int handle, void *buf)
+{
+    return orbisAudioBackend->output(handle, buf);
+}
+
+void orbisAudioBackendClose(int handle)
+{
+    if(orbisAudioBackend) orbisAudioBackend->close(handle);
+}
+
+int orbisAudioBackendIsOffline(void)
+{
+    return orbisAudioBackend == &orbisAudioBackendOffline;
+}
+
+void orbisAudioBackendShutdown(void)
+{
+    if(!orbisAudioBackend) return;
+    orbisAudioBackend->shutdown();
+    orbisAudioBackend = NULL;
+}
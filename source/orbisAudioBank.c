@@ -0,0 +1,160 @@
+/*
+#  ____   ____    ____         ___ ____   ____ _     _
+# |    |  ____>   ____>  |    |        | <____  \   /
+# |____| |    \   ____>  | ___|    ____| <____   \_/    ORBISDEV Open Source Project.
+#------------------------------------------------------------------------------------
+# Copyright 2010-2020, orbisdev - http://orbisdev.github.io
+# Licenced under the MIT license
+# Review README & LICENSE files for further details.
+*/
+
+/*
+ * Sound banks: a whole file of preprocessed PCM or ADPCM mapped read only. Opening
+ * one checks the index against the file size and fills in one
+ * OrbisAudioSound per entry pointing into the mapping, nothing is read or
+ * copied. Pages come in when a voice first touches them, or ahead of time
+ * with orbisAudioBankPrefetch so the audio thread never waits on the disk.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "orbisAudioInternal.h"
+
+
+struct OrbisAudioBank
+{
+    const uint8_t             *map;
+    size_t                     size;
+    const OrbisAudioBankEntry *entries;
+    unsigned int               count;
+    OrbisAudioSound            sounds[];
+};
+
+
+static int orbisAudioBankCheck(const uint8_t *map, size_t size)
+{
+    const OrbisAudioBankHeader *header = (const OrbisAudioBankHeader *)map;
+    const OrbisAudioBankEntry  *entries;
+
+    if(size < sizeof(OrbisAudioBankHeader)) return -1;
+    if(header->magic != ORBISAUDIO_BANK_MAGIC || header->version != ORBISAUDIO_BANK_VERSION) return -1;
+    if(header->size != size) return -1;
+    if(header->indexOffset % 8 || header->indexOffset > size
+    || (uint64_t)header->count * sizeof(OrbisAudioBankEntry) > size - header->indexOffset) return -1;
+
+    entries = (const OrbisAudioBankEntry *)(map + header->indexOffset);
+    for(unsigned int i=0; i<header->count; i++)
+    {
+        const OrbisAudioBankEntry *e = &entries[i];
+
+        if(e->offset % ORBISAUDIO_BANK_ALIGN || e->offset > size || e->bytes > size - e->offset) return -1;
+        if(e->channels < 1 || e->channels > 2 || !e->frequency) return -1;
+        if(e->format == ORBISAUDIO_ENCODING_PCM16 && (uint64_t)e->frames * e->channels * sizeof(short) > e->bytes) return -1;
+        if(e->format == ORBISAUDIO_ENCODING_ADPCM && orbisAudioAdpcmBytes(e->frames, e->channels) > e->bytes) return -1;
+        if(e->format != ORBISAUDIO_ENCODING_PCM16 && e->format != ORBISAUDIO_ENCODING_ADPCM) return -1;
+        if(memchr(e->name, 0, sizeof(e->name)) == NULL) return -1;
+    }
+    return 0;
+}
+
+OrbisAudioBank *orbisAudioBankOpen(const char *path)
+{
+    const OrbisAudioBankHeader *header;
+    OrbisAudioBank *bank;
+    struct stat     st;
+    void           *map;
+    int             fd;
+
+    fd = open(path, O_RDONLY);
+    if(fd < 0) { fprintf(ERROR, "[orbisAudio] can't open bank %s\n", path); return NULL; }
+
+    if(fstat(fd, &st) || st.st_size < (off_t)sizeof(OrbisAudioBankHeader)) { close(fd); fprintf(ERROR, "[orbisAudio] %s is not a bank\n", path); return NULL; }
+
+    // the mapping outlives the descriptor
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) { fprintf(ERROR, "[orbisAudio] can't map bank %s\n", path); return NULL; }
+
+    if(orbisAudioBankCheck(map, st.st_size))
+    {
+        fprintf(ERROR, "[orbisAudio] %s is not a valid version %d bank\n", path, ORBISAUDIO_BANK_VERSION);
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    header = (const OrbisAudioBankHeader *)map;
+
+    // no read ahead on faults, only what is played or prefetched comes in
+    madvise(map, st.st_size, MADV_RANDOM);
+
+    bank = (OrbisAudioBank *)malloc(sizeof(OrbisAudioBank) + header->count * sizeof(OrbisAudioSound));
+    if(!bank) { munmap(map, st.st_size); return NULL; }
+
+    bank->map     = map;
+    bank->size    = st.st_size;
+    bank->entries = (const OrbisAudioBankEntry *)(bank->map + header->indexOffset);
+    bank->count   = header->count;
+
+    for(unsigned int i=0; i<bank->count; i++)
+    {
+        const OrbisAudioBankEntry *e = &bank->entries[i];
+
+        bank->sounds[i].data      = (const short *)(bank->map + e->offset);
+        bank->sounds[i].frames    = e->frames;
+        bank->sounds[i].frequency = e->frequency;
+        bank->sounds[i].channels  = e->channels;
+        bank->sounds[i].encoding  = e->format;
+        bank->sounds[i].loopStart = e->loopStart;
+        bank->sounds[i].loopEnd   = e->loopEnd;
+        bank->sounds[i].priority  = e->priority;
+    }
+    fprintf(DEBUG, "[orbisAudio] bank %s mapped, %u sounds in %zu bytes\n", path, bank->count, bank->size);
+
+    return bank;
+}
+
+// no voice may still be playing one of its sounds
+void orbisAudioBankClose(OrbisAudioBank *bank)
+{
+    if(!bank) return;
+    munmap((void *)bank->map, bank->size);
+    free(bank);
+}
+
+unsigned int orbisAudioBankCount(const OrbisAudioBank *bank)
+{
+    return bank ? bank->count : 0;
+}
+
+const OrbisAudioSound *orbisAudioBankSound(const OrbisAudioBank *bank, unsigned int index)
+{
+    if(!bank || index >= bank->count) return NULL;
+    return &bank->sounds[index];
+}
+
+// index of the sound packed from name, -1 when there is none
+int orbisAudioBankFind(const OrbisAudioBank *bank, const char *name)
+{
+    if(!bank || !name) return -1;
+    for(unsigned int i=0; i<bank->count; i++)
+        if(strncmp(bank->entries[i].name, name, ORBISAUDIO_BANK_NAME_LEN) == 0) return i;
+    return -1;
+}
+
+// ask for the pages of one sound to be read in now, before a voice plays it
+int orbisAudioBankPrefetch(const OrbisAudioBank *bank, unsigned int index)
+{
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start, end;
+
+    if(!bank || index >= bank->count) return -1;
+
+    start = (uintptr_t)(bank->map + bank->entries[index].offset) & ~(page - 1);
+    end   = (uintptr_t)(bank->map + bank->entries[index].offset + bank->entries[index].bytes);
+
+    return madvise((void *)start, end - start, MADV_WILLNEED);
+}
@@ -0,0 +1,136 @@
+/*
+#  ____   ____    ____         ___ ____   ____ _     _
+# |    |  ____>   ____>  |    |        | <____  \   /
+# |____| |    \   ____>  | ___|    ____| <____   \_/    ORBISDEV Open Source Project.
+#------------------------------------------------------------------------------------
+# Copyright 2010-2020, orbisdev - http://orbisdev.github.io
+# Licenced under the MIT license
+# Review README & LICENSE files for further details.
+*/
+
+/*
+ * Control plane: pause, resume, volume, pacing and callback changes from any number
+ * of threads go through a bounded lock-free queue per channel, the thread
+ * rendering the channel applies them between blocks. Callers take a ticket
+ * with a CAS on the head; every slot carries a stamp, the lap of the queue it
+ * is free for, plus one once its command is written. Zeroed memory is an
+ * empty queue. The consumer never waits on a caller and a caller never waits
+ * on the consumer, a full queue is an error.
+ */
+
+#include "orbisAudioInternal.h"
+
+
+#define ORBISAUDIO_CONTROL_SEQ_MASK	0x3fffffffu
+
+// caller side, returns the sequence number of the command or 0 when the queue is full
+int orbisAudioControlPush(OrbisAudioChannel *ch, const OrbisAudioControl *cmd)
+{
+    uint32_t           ticket = __atomic_load_n(&ch->controlHead, __ATOMIC_RELAXED);
+    uint32_t           lap;
+    OrbisAudioControl *slot;
+
+    for(;;)
+    {
+        int32_t diff;
+
+        slot = &ch->control[ticket % ORBISAUDIO_CONTROL_QUEUE];
+        lap  = ticket & ~(uint32_t)(ORBISAUDIO_CONTROL_QUEUE - 1);
+        diff = (int32_t)(__atomic_load_n(&slot->stamp, __ATOMIC_ACQUIRE) - lap);
+
+        if(diff == 0)
+        {
+            if(__atomic_compare_exchange_n(&ch->controlHead, &ticket, ticket + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+        }
+        else if(diff < 0)
+        {
+            fprintf(ERROR, "[orbisAudio] control queue of audio channel %u is full\n", ch->index);
+            return 0;
+        }
+        else ticket = __atomic_load_n(&ch->controlHead, __ATOMIC_RELAXED);
+    }
+
+    slot->type     = cmd->type;
+    slot->l        = cmd->l;
+    slot->r        = cmd->r;
+    slot->callback = cmd->callback;
+    slot->userData = cmd->userData;
+    __atomic_store_n(&slot->stamp, lap + 1, __ATOMIC_RELEASE);
+
+    return (int)(ticket & ORBISAUDIO_CONTROL_SEQ_MASK) + 1;
+}
+
+// rendering thread, at a block boundary: apply everything queued so far, in order
+void orbisAudioControlApply(OrbisAudioChannel *ch)
+{
+    uint32_t ticket = ch->controlTail;
+
+    for(;;)
+    {
+        OrbisAudioControl *slot = &ch->control[ticket % ORBISAUDIO_CONTROL_QUEUE];
+        uint32_t           lap  = ticket & ~(uint32_t)(ORBISAUDIO_CONTROL_QUEUE - 1);
+
+        if(__atomic_load_n(&slot->stamp, __ATOMIC_ACQUIRE) != lap + 1) break;
+
+        switch(slot->type)
+        {
+            case ORBISAUDIO_CONTROL_PAUSE:  orbisAudioFadePause(ch, 1); break;
+            case ORBISAUDIO_CONTROL_RESUME: orbisAudioFadePause(ch, 0); break;
+            case ORBISAUDIO_CONTROL_VOLUME: orbisAudioFadeVolume(ch, slot->l, slot->r); break;
+            case ORBISAUDIO_CONTROL_RAMP:   ch->rampMs = slot->l; break;
+            case ORBISAUDIO_CONTROL_CALLBACK:
+                ch->callback      = slot->callback;
+                ch->userData      = slot->userData;
+                ch->xfadeCallback = NULL;
+                break;
+            case ORBISAUDIO_CONTROL_CROSSFADE: orbisAudioFadeCrossfade(ch, slot->callback, slot->userData, slot->l); break;
+            // the deadline restarts from the next wait, on the thread that waits on it
+            case ORBISAUDIO_CONTROL_PACING:
+                ch->pacing       = (int)slot->l;
+                ch->nextDeadline = 0;
+                break;
+        }
+        __atomic_store_n(&slot->stamp, lap + ORBISAUDIO_CONTROL_QUEUE, __ATOMIC_RELEASE);
+        ticket++;
+    }
+
+    if(ticket != ch->controlTail)
+    {
+        ch->controlTail = ticket;
+        __atomic_store_n(&ch->controlDone, ticket, __ATOMIC_RELEASE);
+    }
+}
+
+// 1 once the command seq was returned for has been applied, 0 while it is pending
+int orbisAudioControlDone(unsigned int channel, int seq)
+{
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
+    uint32_t           done;
+
+    if(!ch || seq <= 0) return -1;
+
+    // sequence numbers wrap, anything less than half the range behind is done
+    done = __atomic_load_n(&ch->controlDone, __ATOMIC_ACQUIRE);
+    return ((done - (uint32_t)seq) & ORBISAUDIO_CONTROL_SEQ_MASK) < (ORBISAUDIO_CONTROL_SEQ_MASK + 1) / 2;
+}
+
+/*
+ * Sleep until a command has been applied, e.g. before freeing the user data
+ * of a callback that was swapped out. Gives up after a second, or at once
+ * when nothing renders the channel.
+ */
+int orbisAudioControlWait(unsigned int channel, int seq)
+{
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
+    uint64_t           start = orbisAudioGetTimeUs();
+    int                done;
+
+    if(!ch) return -1;
+
+    while((done = orbisAudioControlDone(channel, seq)) == 0)
+    {
+        if(__atomic_load_n(&ch->orbisaudiochannel_initialized, __ATOMIC_ACQUIRE) != 1 || orbisAudioGetTimeUs() - start > 1000000) return -1;
+        sceKernelUsleep(1000);
+    }
+    return done == 1 ? 0 : -1;
+}
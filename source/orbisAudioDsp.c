@@ -0,0 +1,461 @@
+/*
+#  ____   ____    ____         ___ ____   ____ _     _
+# |    |  ____>   ____>  |    |        | <____  \   /
+# |____| |    \   ____>  | ___|    ____| <____   \_/    ORBISDEV Open Source Project.
+#------------------------------------------------------------------------------------
+# Copyright 2010-2020, orbisdev - http://orbisdev.github.io
+# Licenced under the MIT license
+# Review README & LICENSE files for further details.
+*/
+
+/*
+ * DSP insert chain, run in place on s16 blocks in float: a DC blocker, up to
+ * ORBISAUDIO_DSP_BANDS biquads (transposed direct form II, both channels in
+ * the lanes of one SSE register) and a stereo linked look-ahead peak limiter.
+ *
+ * Settings are built by one writer thread into a spare copy of the
+ * parameters and handed over through a triple buffer: the writer swaps its
+ * copy with the middle one and flags it, the rendering thread swaps the
+ * middle one with its own at the next block. Neither side ever waits and
+ * filter state survives the swap. With nothing enabled, or bypassed, a
+ * block costs one load and a branch.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined (__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "orbisAudioInternal.h"
+
+
+#define ORBISAUDIO_DSP_DIRTY	4      // set on the middle index by the writer
+#define ORBISAUDIO_DSP_DC	(1u << ORBISAUDIO_DSP_BANDS)
+#define ORBISAUDIO_DSP_LIMITER	(2u << ORBISAUDIO_DSP_BANDS)
+#define ORBISAUDIO_DSP_TINY	1e-15f // state below this is flushed so silence never decays into denormals
+
+typedef struct OrbisAudioDspParams
+{
+    float    b0[ORBISAUDIO_DSP_BANDS]; // coefficients, normalized by a0
+    float    b1[ORBISAUDIO_DSP_BANDS];
+    float    b2[ORBISAUDIO_DSP_BANDS];
+    float    a1[ORBISAUDIO_DSP_BANDS];
+    float    a2[ORBISAUDIO_DSP_BANDS];
+    uint32_t bands;     // one bit per active band
+    float    threshold; // limiter ceiling, full scale is 1
+    float    release;   // limiter recovery per frame
+    unsigned char dcBlock;
+    unsigned char limiter;
+    unsigned char bypass;
+} OrbisAudioDspParams;
+
+struct OrbisAudioDsp
+{
+    unsigned int channels;
+    unsigned int frequency;
+    unsigned int maxFrames;  // frames converted to float at a time
+    float        dcPole;
+    // writer side
+    OrbisAudioDspParams edit;
+    unsigned int back;
+    // handed over
+    uint32_t     middle;     // params index, ORBISAUDIO_DSP_DIRTY when it holds news
+    // rendering thread side
+    unsigned int front;
+    OrbisAudioDspParams params[3];
+    float        z[ORBISAUDIO_DSP_BANDS][8]; // per band z1 then z2, one lane per channel
+    float        dcX[2];
+    float        dcY[2];
+    float        limDelay[ORBISAUDIO_DSP_LOOKAHEAD * 2];
+    float        limGain[ORBISAUDIO_DSP_LOOKAHEAD]; // smoothed gains the output gain averages
+    float        minVal[ORBISAUDIO_DSP_LOOKAHEAD];  // sliding minimum of the required gain, increasing
+    uint32_t     minIdx[ORBISAUDIO_DSP_LOOKAHEAD];
+    unsigned int minHead;
+    unsigned int minCount;
+    unsigned int limPos;
+    uint32_t     limFrame;
+    float        limEnv;
+    float       *work;
+    int          owned;      // malloc'd by orbisAudioDspCreate
+};
+
+
+static int orbisAudioDspCheck(unsigned int frequency, unsigned int channels, unsigned int maxFrames)
+{
+    return frequency && channels >= 1 && channels <= 2 && maxFrames;
+}
+
+size_t orbisAudioDspBytes(unsigned int channels, unsigned int maxFrames)
+{
+    return ORBISAUDIO_ALIGN_SAMPLE(sizeof(OrbisAudioDsp), 16) + maxFrames * channels * sizeof(float);
+}
+
+// build a chain with everything off inside mem, which holds at least orbisAudioDspBytes
+OrbisAudioDsp *orbisAudioDspInit(void *mem, unsigned int frequency, unsigned int channels, unsigned int maxFrames)
+{
+    OrbisAudioDsp *dsp = (OrbisAudioDsp *)mem;
+
+    if(!mem || !orbisAudioDspCheck(frequency, channels, maxFrames)) return NULL;
+
+    memset(dsp, 0, sizeof(OrbisAudioDsp));
+    dsp->channels  = channels;
+    dsp->frequency = frequency;
+    dsp->maxFrames = maxFrames;
+    dsp->dcPole    = (float)(1.0 - 2.0 * M_PI * 10.0 / frequency); // about 10 Hz
+    dsp->front     = 0;
+    dsp->middle    = 1;
+    dsp->back      = 2;
+    dsp->edit.threshold = 1.0f;
+    dsp->work      = (float *)((uint8_t *)mem + ORBISAUDIO_ALIGN_SAMPLE(sizeof(OrbisAudioDsp), 16));
+
+    return dsp;
+}
+
+OrbisAudioDsp *orbisAudioDspCreate(unsigned int frequency, unsigned int channels, unsigned int maxFrames)
+{
+    OrbisAudioDsp *dsp;
+    void *mem;
+
+    if(!orbisAudioDspCheck(frequency, channels, maxFrames)) return NULL;
+
+    mem = malloc(orbisAudioDspBytes(channels, maxFrames));
+    dsp = orbisAudioDspInit(mem, frequency, channels, maxFrames);
+    if(!dsp) { free(mem); return NULL; }
+    dsp->owned = 1;
+
+    return dsp;
+}
+
+void orbisAudioDspDestroy(OrbisAudioDsp *dsp)
+{
+    // chains built in place belong to their memory's owner
+    if(dsp && dsp->owned) free(dsp);
+}
+
+// set up after orbisAudioInitChannel or orbisAudioInitMixer, ORBISAUDIO_CHANNEL_MASTER runs on the mix
+OrbisAudioDsp *orbisAudioInitDsp(unsigned int channel)
+{
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
+    OrbisAudioDsp     *dsp;
+
+    if(!ch) return NULL;
+    if(ch->orbisaudiochannel_initialized != 1) { fprintf(ERROR, "[orbisAudio] orbisAudioInitDsp channel %u is not initialized\n", channel); return NULL; }
+    if(ch->dsp) { fprintf(DEBUG, "[orbisAudio] DSP chain for audio channel %u already created\n", channel); return NULL; }
+
+    dsp = orbisAudioDspInit(orbisAudioArenaAlloc(channel, orbisAudioDspBytes(ch->stereo + 1, ch->samples[0])),
+                            ch->frequency ? ch->frequency : ORBISAUDIO_OUTPUT_FREQUENCY, ch->stereo + 1, ch->samples[0]);
+    if(!dsp) return NULL;
+
+    __atomic_store_n(&ch->dsp, dsp, __ATOMIC_RELEASE);
+    fprintf(DEBUG, "[orbisAudio] DSP chain for audio channel %u created\n", channel);
+
+    return dsp;
+}
+
+// writer: hand the edited settings over, take back whichever copy the reader isn't using
+static int orbisAudioDspPublish(OrbisAudioDsp *dsp)
+{
+    dsp->params[dsp->back] = dsp->edit;
+    dsp->back = __atomic_exchange_n(&dsp->middle, dsp->back | ORBISAUDIO_DSP_DIRTY, __ATOMIC_ACQ_REL) & 3;
+    return 0;
+}
+
+/*
+ * Band coefficients from the RBJ audio EQ cookbook, worked out in double.
+ * Shelves take q in place of the slope, 0.707 is the usual one.
+ */
+int orbisAudioDspSetEq(OrbisAudioDsp *dsp, unsigned int band, int type, float frequency, float gainDb, float q)
+{
+    double a = pow(10.0, gainDb / 40.0), sa = sqrt(a);
+    double w, cw, alpha;
+    double b0, b1, b2, a0, a1, a2;
+
+    if(!dsp || band >= ORBISAUDIO_DSP_BANDS || type < ORBISAUDIO_EQ_OFF || type > ORBISAUDIO_EQ_HIGHPASS) return -1;
+    if(type == ORBISAUDIO_EQ_OFF)
+    {
+        dsp->edit.bands &= ~(1u << band);
+        return orbisAudioDspPublish(dsp);
+    }
+    if(!(frequency > 0.0f && frequency < dsp->frequency / 2.0f) || !(q > 0.0f)) return -1;
+
+    w     = 2.0 * M_PI * frequency / dsp->frequency;
+    cw    = cos(w);
+    alpha = sin(w) / (2.0 * q);
+
+    switch(type)
+    {
+        case ORBISAUDIO_EQ_PEAK:
+            b0 = 1.0 + alpha * a; b1 = -2.0 * cw; b2 = 1.0 - alpha * a;
+            a0 = 1.0 + alpha / a; a1 = -2.0 * cw; a2 = 1.0 - alpha / a;
+            break;
+        case ORBISAUDIO_EQ_LOWSHELF:
+            b0 =       a * ((a + 1.0) - (a - 1.0) * cw + 2.0 * sa * alpha);
+            b1 = 2.0 * a * ((a - 1.0) - (a + 1.0) * cw);
+            b2 =       a * ((a + 1.0) - (a - 1.0) * cw - 2.0 * sa * alpha);
+            a0 =            (a + 1.0) + (a - 1.0) * cw + 2.0 * sa * alpha;
+            a1 =    -2.0 * ((a - 1.0) + (a + 1.0) * cw);
+            a2 =            (a + 1.0) + (a - 1.0) * cw - 2.0 * sa * alpha;
+            break;
+        case ORBISAUDIO_EQ_HIGHSHELF:
+            b0 =        a * ((a + 1.0) + (a - 1.0) * cw + 2.0 * sa * alpha);
+            b1 = -2.0 * a * ((a - 1.0) + (a + 1.0) * cw);
+            b2 =        a * ((a + 1.0) + (a - 1.0) * cw - 2.0 * sa * alpha);
+            a0 =             (a + 1.0) - (a - 1.0) * cw + 2.0 * sa * alpha;
+            a1 =      2.0 * ((a - 1.0) - (a + 1.0) * cw);
+            a2 =             (a + 1.0) - (a - 1.0) * cw - 2.0 * sa * alpha;
+            break;
+        case ORBISAUDIO_EQ_LOWPASS:
+            b0 = (1.0 - cw) / 2.0; b1 = 1.0 - cw; b2 = b0;
+            a0 = 1.0 + alpha; a1 = -2.0 * cw; a2 = 1.0 - alpha;
+            break;
+        default: // ORBISAUDIO_EQ_HIGHPASS
+            b0 = (1.0 + cw) / 2.0; b1 = -(1.0 + cw); b2 = b0;
+            a0 = 1.0 + alpha; a1 = -2.0 * cw; a2 = 1.0 - alpha;
+            break;
+    }
+
+    dsp->edit.b0[band] = (float)(b0 / a0);
+    dsp->edit.b1[band] = (float)(b1 / a0);
+    dsp->edit.b2[band] = (float)(b2 / a0);
+    dsp->edit.a1[band] = (float)(a1 / a0);
+    dsp->edit.a2[band] = (float)(a2 / a0);
+    dsp->edit.bands   |= 1u << band;
+
+    return orbisAudioDspPublish(dsp);
+}
+
+// peaks above ceilingDb (at most 0) are held down ORBISAUDIO_DSP_LOOKAHEAD frames ahead, the gain recovers over releaseMs
+int orbisAudioDspSetLimiter(OrbisAudioDsp *dsp, int enable, float ceilingDb, float releaseMs)
+{
+    if(!dsp) return -1;
+    if(enable && (!(ceilingDb <= 0.0f) || !(releaseMs > 0.0f))) return -1;
+
+    if(enable)
+    {
+        dsp->edit.threshold = powf(10.0f, ceilingDb / 20.0f);
+        dsp->edit.release   = (float)(1.0 - exp(-1000.0 / (releaseMs * dsp->frequency)));
+    }
+    dsp->edit.limiter = enable ? 1 : 0;
+
+    return orbisAudioDspPublish(dsp);
+}
+
+int orbisAudioDspSetDcBlock(OrbisAudioDsp *dsp, int enable)
+{
+    if(!dsp) return -1;
+    dsp->edit.dcBlock = enable ? 1 : 0;
+    return orbisAudioDspPublish(dsp);
+}
+
+int orbisAudioDspSetBypass(OrbisAudioDsp *dsp, int bypass)
+{
+    if(!dsp) return -1;
+    dsp->edit.bypass = bypass ? 1 : 0;
+    return orbisAudioDspPublish(dsp);
+}
+
+// stages that run with these settings, ORBISAUDIO_DSP_DC and ORBISAUDIO_DSP_LIMITER above the band bits
+static uint32_t orbisAudioDspActive(const OrbisAudioDspParams *p)
+{
+    if(p->bypass) return 0;
+    return p->bands | (p->dcBlock ? ORBISAUDIO_DSP_DC : 0) | (p->limiter ? ORBISAUDIO_DSP_LIMITER : 0);
+}
+
+// reader: take the newest settings if there are any, stages that just came on start from silence
+static void orbisAudioDspFetch(OrbisAudioDsp *dsp)
+{
+    uint32_t was, now;
+
+    if(!(__atomic_load_n(&dsp->middle, __ATOMIC_RELAXED) & ORBISAUDIO_DSP_DIRTY)) return;
+
+    was = orbisAudioDspActive(&dsp->params[dsp->front]);
+    dsp->front = __atomic_exchange_n(&dsp->middle, dsp->front, __ATOMIC_ACQ_REL) & 3;
+    now = orbisAudioDspActive(&dsp->params[dsp->front]) & ~was;
+
+    for(unsigned int k=0; k<ORBISAUDIO_DSP_BANDS; k++) if(now & (1u << k)) memset(dsp->z[k], 0, sizeof(dsp->z[k]));
+    if(now & ORBISAUDIO_DSP_DC)
+    {
+        memset(dsp->dcX, 0, sizeof(dsp->dcX));
+        memset(dsp->dcY, 0, sizeof(dsp->dcY));
+    }
+    if(now & ORBISAUDIO_DSP_LIMITER)
+    {
+        memset(dsp->limDelay, 0, sizeof(dsp->limDelay));
+        for(unsigned int i=0; i<ORBISAUDIO_DSP_LOOKAHEAD; i++) dsp->limGain[i] = 1.0f;
+        dsp->minCount = 0;
+        dsp->limEnv   = 1.0f;
+    }
+}
+
+// y[n] = x[n] - x[n-1] + R y[n-1]
+static void orbisAudioDspDcBlock(OrbisAudioDsp *dsp, float *x, unsigned int frames)
+{
+    unsigned int nc = dsp->channels;
+    float r = dsp->dcPole;
+
+    for(unsigned int c=0; c<nc; c++)
+    {
+        float x1 = dsp->dcX[c], y1 = dsp->dcY[c];
+
+        for(unsigned int i=0; i<frames; i++)
+        {
+            float in = x[i * nc + c];
+
+            y1 = in - x1 + r * y1;
+            x1 = in;
+            x[i * nc + c] = y1;
+        }
+        dsp->dcX[c] = x1;
+        dsp->dcY[c] = fabsf(y1) < ORBISAUDIO_DSP_TINY ? 0.0f : y1;
+    }
+}
+
+#if defined (__SSE2__)
+
+// one band over the block, the channels of a frame side by side in the low lanes
+static void orbisAudioDspBiquad(OrbisAudioDsp *dsp, const OrbisAudioDspParams *p, unsigned int k, float *x, unsigned int frames)
+{
+    const __m128 b0 = _mm_set1_ps(p->b0[k]), b1 = _mm_set1_ps(p->b1[k]), b2 = _mm_set1_ps(p->b2[k]);
+    const __m128 a1 = _mm_set1_ps(p->a1[k]), a2 = _mm_set1_ps(p->a2[k]);
+    const __m128 tiny = _mm_set1_ps(ORBISAUDIO_DSP_TINY), abs = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 z1 = _mm_loadu_ps(dsp->z[k]), z2 = _mm_loadu_ps(dsp->z[k] + 4), in, y;
+
+    if(dsp->channels == 2)
+    {
+        for(unsigned int i=0; i<frames; i++)
+        {
+            in = _mm_castpd_ps(_mm_load_sd((const double *)(x + 2 * i)));
+            y  = _mm_add_ps(_mm_mul_ps(b0, in), z1);
+            z1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, in), _mm_mul_ps(a1, y)), z2);
+            z2 = _mm_sub_ps(_mm_mul_ps(b2, in), _mm_mul_ps(a2, y));
+            _mm_store_sd((double *)(x + 2 * i), _mm_castps_pd(y));
+        }
+    }
+    else
+    {
+        for(unsigned int i=0; i<frames; i++)
+        {
+            in = _mm_load_ss(x + i);
+            y  = _mm_add_ps(_mm_mul_ps(b0, in), z1);
+            z1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, in), _mm_mul_ps(a1, y)), z2);
+            z2 = _mm_sub_ps(_mm_mul_ps(b2, in), _mm_mul_ps(a2, y));
+            _mm_store_ss(x + i, y);
+        }
+    }
+    z1 = _mm_and_ps(z1, _mm_cmpge_ps(_mm_and_ps(z1, abs), tiny));
+    z2 = _mm_and_ps(z2, _mm_cmpge_ps(_mm_and_ps(z2, abs), tiny));
+    _mm_storeu_ps(dsp->z[k], z1);
+    _mm_storeu_ps(dsp->z[k] + 4, z2);
+}
+
+#else
+
+static void orbisAudioDspBiquad(OrbisAudioDsp *dsp, const OrbisAudioDspParams *p, unsigned int k, float *x, unsigned int frames)
+{
+    unsigned int nc = dsp->channels;
+    float b0 = p->b0[k], b1 = p->b1[k], b2 = p->b2[k], a1 = p->a1[k], a2 = p->a2[k];
+
+    for(unsigned int c=0; c<nc; c++)
+    {
+        float z1 = dsp->z[k][c], z2 = dsp->z[k][4 + c];
+
+        for(unsigned int i=0; i<frames; i++)
+        {
+            float in = x[i * nc + c], y = b0 * in + z1;
+
+            z1 = b1 * in - a1 * y + z2;
+            z2 = b2 * in - a2 * y;
+            x[i * nc + c] = y;
+        }
+        dsp->z[k][c]     = fabsf(z1) < ORBISAUDIO_DSP_TINY ? 0.0f : z1;
+        dsp->z[k][4 + c] = fabsf(z2) < ORBISAUDIO_DSP_TINY ? 0.0f : z2;
+    }
+}
+
+#endif
+
+/*
+ * Look-ahead limiter. Each frame needs a gain of threshold / peak at most,
+ * the smallest one over the next ORBISAUDIO_DSP_LOOKAHEAD frames is tracked
+ * with a monotonic queue. That gain is applied at once and recovers with a
+ * one pole release, then averaged over the look-ahead window so the attack
+ * is a smooth ramp. The signal is delayed by the window less one frame; every
+ * gain averaged into a frame's gain saw that frame's peak, so the output
+ * never goes over the threshold.
+ */
+static void orbisAudioDspLimit(OrbisAudioDsp *dsp, const OrbisAudioDspParams *p, float *x, unsigned int frames)
+{
+    const unsigned int L = ORBISAUDIO_DSP_LOOKAHEAD, mask = ORBISAUDIO_DSP_LOOKAHEAD - 1;
+    unsigned int nc = dsp->channels, pos = dsp->limPos, head = dsp->minHead, count = dsp->minCount;
+    uint32_t frame = dsp->limFrame;
+    float threshold = p->threshold, release = p->release, env = dsp->limEnv, sum = 0.0f;
+
+    // summed again every block so rounding never builds up
+    for(unsigned int i=0; i<L; i++) sum += dsp->limGain[i];
+
+    for(unsigned int i=0; i<frames; i++, frame++)
+    {
+        float *s = x + i * nc;
+        float peak = fabsf(s[0]), need, g;
+        unsigned int next = (pos + 1) & mask;
+
+        if(nc == 2 && fabsf(s[1]) > peak) peak = fabsf(s[1]);
+        need = peak > threshold ? threshold / peak : 1.0f;
+
+        if(count && frame - dsp->minIdx[head] >= L) { head = (head + 1) & mask; count--; }
+        while(count && dsp->minVal[(head + count - 1) & mask] >= need) count--;
+        dsp->minVal[(head + count) & mask] = need;
+        dsp->minIdx[(head + count) & mask] = frame;
+        count++;
+
+        env  = dsp->minVal[head] < env ? dsp->minVal[head] : env + (dsp->minVal[head] - env) * release;
+        sum += env - dsp->limGain[pos];
+        dsp->limGain[pos] = env;
+        g    = sum * (1.0f / ORBISAUDIO_DSP_LOOKAHEAD);
+
+        for(unsigned int c=0; c<nc; c++)
+        {
+            dsp->limDelay[pos * nc + c] = s[c];
+            s[c] = dsp->limDelay[next * nc + c] * g;
+        }
+        pos = next;
+    }
+    dsp->limPos   = pos;
+    dsp->minHead  = head;
+    dsp->minCount = count;
+    dsp->limFrame = frame;
+    dsp->limEnv   = env;
+}
+
+// in place on interleaved s16 frames, called by the thread rendering the channel
+void orbisAudioDspProcess(OrbisAudioDsp *dsp, short *buf, unsigned int frames)
+{
+    const OrbisAudioDspParams *p;
+    unsigned int nc = dsp->channels;
+    uint32_t active;
+
+    orbisAudioDspFetch(dsp);
+    p = &dsp->params[dsp->front];
+    active = orbisAudioDspActive(p);
+    if(!active) return;
+
+    while(frames)
+    {
+        unsigned int n = frames < dsp->maxFrames ? frames : dsp->maxFrames;
+        float *work = dsp->work;
+
+        // the same scale orbisAudioConvertF32ToS16 uses, so untouched samples come back exactly
+        for(unsigned int i=0; i<n * nc; i++) work[i] = buf[i] * (1.0f / 32767.0f);
+
+        if(active & ORBISAUDIO_DSP_DC) orbisAudioDspDcBlock(dsp, work, n);
+        for(uint32_t bands = p->bands; bands; bands &= bands - 1) orbisAudioDspBiquad(dsp, p, __builtin_ctz(bands), work, n);
+        if(active & ORBISAUDIO_DSP_LIMITER) orbisAudioDspLimit(dsp, p, work, n);
+
+        orbisAudioConvertF32ToS16(buf, work, n * nc, NULL);
+        buf    += n * nc;
+        frames -= n;
+    }
+}
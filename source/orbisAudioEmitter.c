@@ -0,0 +1,221 @@
+/*
+#  ____   ____    ____         ___ ____   ____ _     _
+# |    |  ____>   ____>  |    |        | <____  \   /
+# |____| |    \   ____>  | ___|    ____| <____   \_/    ORBISDEV Open Source Project.
+#------------------------------------------------------------------------------------
+# Copyright 2010-2020, orbisdev - http://orbisdev.github.io
+# Licenced under the MIT license
+# Review README & LICENSE files for further details.
+*/
+
+/*
+ * 3D emitters on top of the voice pool. The game hands over a listener and
+ * its emitters as flat arrays, the gains and pitch of all of them are worked
+ * out four at a time in SSE lanes, with no trigonometry: the pan is the
+ * sine of the azimuth, the dot of the direction with the listener's right,
+ * and the sine law pan sqrt((1 -+ pan) / 2) keeps the power constant.
+ * Attenuation is the clamped inverse distance model, Doppler follows
+ * OpenAL. The results go to the voices as one batch of set commands, the
+ * channel thread ramps to them over its next block.
+ */
+
+#include <math.h>
+
+#if defined (__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#include "orbisAudioInternal.h"
+
+
+#define ORBISAUDIO_EMITTER_BATCH	256 // emitters worked out per queue publish
+#define ORBISAUDIO_EMITTER_NEAR		1e-6f // closer than this there is no direction, centered and no Doppler
+
+// listener state every emitter shares
+typedef struct OrbisAudioEmitterFrame
+{
+    float pos[3];
+    float vel[3];
+    float right[3];
+    float minDistance;
+    float maxDistance;
+    float rolloff;
+    float speed;      // 0 without Doppler
+} OrbisAudioEmitterFrame;
+
+
+static int orbisAudioEmitterFrame(OrbisAudioEmitterFrame *f, const OrbisAudioListener *l, const OrbisAudioEmitters *e)
+{
+    const float *fw = l->forward, *up = l->up;
+    float len;
+
+    if(!e->x || !e->y || !e->z || (e->vx && (!e->vy || !e->vz))) return -1;
+    if(!(l->minDistance > 0.0f) || !(l->maxDistance >= l->minDistance) || !(l->rolloff >= 0.0f)) return -1;
+
+    f->right[0] = fw[1] * up[2] - fw[2] * up[1];
+    f->right[1] = fw[2] * up[0] - fw[0] * up[2];
+    f->right[2] = fw[0] * up[1] - fw[1] * up[0];
+    len = sqrtf(f->right[0] * f->right[0] + f->right[1] * f->right[1] + f->right[2] * f->right[2]);
+    if(!(len > 0.0f)) return -1;
+
+    for(int k=0; k<3; k++)
+    {
+        f->pos[k]    = l->position[k];
+        f->vel[k]    = l->velocity[k];
+        f->right[k] /= len;
+    }
+    f->minDistance = l->minDistance;
+    f->maxDistance = l->maxDistance;
+    f->rolloff     = l->rolloff;
+    f->speed       = l->speedOfSound > 0.0f ? l->speedOfSound : 0.0f;
+
+    return 0;
+}
+
+static inline void orbisAudioEmitterOne(const OrbisAudioEmitterFrame *f, const OrbisAudioEmitters *e, unsigned int i, float *gainL, float *gainR, float *pitch)
+{
+    float dx = e->x[i] - f->pos[0], dy = e->y[i] - f->pos[1], dz = e->z[i] - f->pos[2];
+    float d  = sqrtf(dx * dx + dy * dy + dz * dz);
+    float inv = d > ORBISAUDIO_EMITTER_NEAR ? 1.0f / d : 0.0f;
+    float pan = (dx * f->right[0] + dy * f->right[1] + dz * f->right[2]) * inv;
+    float dc  = d < f->minDistance ? f->minDistance : d > f->maxDistance ? f->maxDistance : d;
+    float g   = f->minDistance / (f->minDistance + f->rolloff * (dc - f->minDistance));
+    float p   = 1.0f;
+
+    if(pan < -1.0f) pan = -1.0f;
+    if(pan >  1.0f) pan =  1.0f;
+    if(e->gain) g *= e->gain[i];
+
+    if(f->speed > 0.0f)
+    {
+        // speeds along the line from the emitter to the listener, held under half the speed of sound
+        float vls = -(dx * f->vel[0] + dy * f->vel[1] + dz * f->vel[2]) * inv;
+        float vss = e->vx ? -(dx * e->vx[i] + dy * e->vy[i] + dz * e->vz[i]) * inv : 0.0f;
+
+        if(vls > f->speed * 0.5f) vls = f->speed * 0.5f;
+        if(vss > f->speed * 0.5f) vss = f->speed * 0.5f;
+        p = (f->speed - vls) / (f->speed - vss);
+    }
+    if(e->pitch) p *= e->pitch[i];
+
+    gainL[i] = g * sqrtf(0.5f - 0.5f * pan);
+    gainR[i] = g * sqrtf(0.5f + 0.5f * pan);
+    pitch[i] = p;
+}
+
+// gain of each ear and pitch of every emitter, one at a time
+int orbisAudioEmitterComputeRef(const OrbisAudioListener *listener, const OrbisAudioEmitters *emitters, float *gainL, float *gainR, float *pitch)
+{
+    OrbisAudioEmitterFrame f;
+
+    if(!listener || !emitters || !gainL || !gainR || !pitch) return -1;
+    if(orbisAudioEmitterFrame(&f, listener, emitters)) return -1;
+
+    for(unsigned int i=0; i<emitters->count; i++) orbisAudioEmitterOne(&f, emitters, i, gainL, gainR, pitch);
+    return 0;
+}
+
+int orbisAudioEmitterCompute(const OrbisAudioListener *listener, const OrbisAudioEmitters *emitters, float *gainL, float *gainR, float *pitch)
+{
+    OrbisAudioEmitterFrame f;
+    unsigned int i = 0;
+
+    if(!listener || !emitters || !gainL || !gainR || !pitch) return -1;
+    if(orbisAudioEmitterFrame(&f, listener, emitters)) return -1;
+
+#if defined (__SSE__)
+    {
+        const OrbisAudioEmitters *e = emitters;
+        const __m128 px = _mm_set1_ps(f.pos[0]), py = _mm_set1_ps(f.pos[1]), pz = _mm_set1_ps(f.pos[2]);
+        const __m128 rx = _mm_set1_ps(f.right[0]), ry = _mm_set1_ps(f.right[1]), rz = _mm_set1_ps(f.right[2]);
+        const __m128 lvx = _mm_set1_ps(f.vel[0]), lvy = _mm_set1_ps(f.vel[1]), lvz = _mm_set1_ps(f.vel[2]);
+        const __m128 minD = _mm_set1_ps(f.minDistance), maxD = _mm_set1_ps(f.maxDistance), roll = _mm_set1_ps(f.rolloff);
+        const __m128 c = _mm_set1_ps(f.speed), halfC = _mm_set1_ps(f.speed * 0.5f);
+        const __m128 one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f), near = _mm_set1_ps(ORBISAUDIO_EMITTER_NEAR);
+        const __m128 zero = _mm_setzero_ps();
+
+        for(; i+4<=e->count; i+=4)
+        {
+            __m128 dx  = _mm_sub_ps(_mm_loadu_ps(e->x + i), px);
+            __m128 dy  = _mm_sub_ps(_mm_loadu_ps(e->y + i), py);
+            __m128 dz  = _mm_sub_ps(_mm_loadu_ps(e->z + i), pz);
+            __m128 d   = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+            __m128 inv = _mm_and_ps(_mm_cmpgt_ps(d, near), _mm_div_ps(one, _mm_max_ps(d, near)));
+            __m128 pan = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, rx), _mm_mul_ps(dy, ry)), _mm_mul_ps(dz, rz)), inv);
+            __m128 dc  = _mm_min_ps(_mm_max_ps(d, minD), maxD);
+            __m128 g   = _mm_div_ps(minD, _mm_add_ps(minD, _mm_mul_ps(roll, _mm_sub_ps(dc, minD))));
+            __m128 p   = one;
+
+            pan = _mm_min_ps(_mm_max_ps(pan, _mm_set1_ps(-1.0f)), one);
+            if(e->gain) g = _mm_mul_ps(g, _mm_loadu_ps(e->gain + i));
+
+            if(f.speed > 0.0f)
+            {
+                __m128 vls = _mm_sub_ps(zero, _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, lvx), _mm_mul_ps(dy, lvy)), _mm_mul_ps(dz, lvz)), inv));
+                __m128 vss = zero;
+
+                if(e->vx)
+                    vss = _mm_sub_ps(zero, _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, _mm_loadu_ps(e->vx + i)), _mm_mul_ps(dy, _mm_loadu_ps(e->vy + i))),
+                                                                 _mm_mul_ps(dz, _mm_loadu_ps(e->vz + i))), inv));
+                p = _mm_div_ps(_mm_sub_ps(c, _mm_min_ps(vls, halfC)), _mm_sub_ps(c, _mm_min_ps(vss, halfC)));
+            }
+            if(e->pitch) p = _mm_mul_ps(p, _mm_loadu_ps(e->pitch + i));
+
+            _mm_storeu_ps(gainL + i, _mm_mul_ps(g, _mm_sqrt_ps(_mm_sub_ps(half, _mm_mul_ps(half, pan)))));
+            _mm_storeu_ps(gainR + i, _mm_mul_ps(g, _mm_sqrt_ps(_mm_add_ps(half, _mm_mul_ps(half, pan)))));
+            _mm_storeu_ps(pitch + i, p);
+        }
+    }
+#endif
+    for(; i<emitters->count; i++) orbisAudioEmitterOne(&f, emitters, i, gainL, gainR, pitch);
+
+    return 0;
+}
+
+// the emitters from first on, count of them
+static OrbisAudioEmitters orbisAudioEmitterSlice(const OrbisAudioEmitters *e, unsigned int first, unsigned int count)
+{
+    OrbisAudioEmitters s = *e;
+
+    s.voices = e->voices + first;
+    s.x      = e->x + first;
+    s.y      = e->y + first;
+    s.z      = e->z + first;
+    if(e->vx)    { s.vx = e->vx + first; s.vy = e->vy + first; s.vz = e->vz + first; }
+    if(e->gain)  s.gain  = e->gain  + first;
+    if(e->pitch) s.pitch = e->pitch + first;
+    s.count  = count;
+
+    return s;
+}
+
+/*
+ * Position the voices of a channel's pool, from the thread that plays them.
+ * Works through the emitters in batches so nothing is allocated, returns
+ * how many were queued or -1. The queue holds every voice twice over, so it
+ * only runs short when updates come faster than the channel renders blocks.
+ */
+int orbisAudioEmitterUpdate(unsigned int channel, const OrbisAudioListener *listener, const OrbisAudioEmitters *emitters)
+{
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
+    float        gainL[ORBISAUDIO_EMITTER_BATCH], gainR[ORBISAUDIO_EMITTER_BATCH], pitch[ORBISAUDIO_EMITTER_BATCH];
+    unsigned int done = 0;
+
+    if(!ch || channel >= ORBISAUDIO_CHANNELS || !__atomic_load_n(&ch->voices, __ATOMIC_ACQUIRE)) return -1;
+    if(!listener || !emitters || !emitters->voices) return -1;
+
+    while(done < emitters->count)
+    {
+        unsigned int       n = emitters->count - done, queued;
+        OrbisAudioEmitters s;
+
+        if(n > ORBISAUDIO_EMITTER_BATCH) n = ORBISAUDIO_EMITTER_BATCH;
+        s = orbisAudioEmitterSlice(emitters, done, n);
+
+        if(orbisAudioEmitterCompute(listener, &s, gainL, gainR, pitch)) return -1;
+        queued = orbisAudioVoiceSetGains(channel, s.voices, gainL, gainR, pitch, n);
+        done  += queued;
+        if(queued < n) break;
+    }
+    return done;
+}
@@ -0,0 +1,207 @@
+/*
+#  ____   ____    ____         ___ ____   ____ _     _
+# |    |  ____>   ____>  |    |        | <____  \   /
+# |____| |    \   ____>  | ___|    ____| <____   \_/    ORBISDEV Open Source Project.
+#------------------------------------------------------------------------------------
+# Copyright 2010-2020, orbisdev - http://orbisdev.github.io
+# Licenced under the MIT license
+# Review README & LICENSE files for further details.
+*/
+
+/*
+ * Click free gain changes. Volume changes ramp over rampMs, pause and resume
+ * fade over ORBISAUDIO_FADE_MS, a crossfade runs a second callback and fades
+ * it in over the current source. All of it is applied per sample by the
+ * thread rendering the channel; a block is split where a ramp ends so short
+ * ramps keep their length whatever the block size. State only changes from
+ * orbisAudioControlApply, on the same thread.
+ */
+
+#include <math.h>
+
+#include "orbisAudioInternal.h"
+
+
+#define ORBISAUDIO_XFADE_SEGMENT	64 // frames per linear piece of the equal power curve
+
+static unsigned int orbisAudioFadeFrames(unsigned int ms, unsigned int frequency)
+{
+    return (unsigned int)((uint64_t)ms * (frequency ? frequency : ORBISAUDIO_OUTPUT_FREQUENCY) / 1000);
+}
+
+static unsigned int orbisAudioFadeAt(unsigned int from, unsigned int to, unsigned int pos, unsigned int frames)
+{
+    if(pos >= frames) return to;
+    return (unsigned int)((int64_t)from + ((int64_t)to - (int64_t)from) * pos / frames);
+}
+
+// called when the channel's buffers are created: full volume, fully faded in, no crossfade
+void orbisAudioFadeReset(OrbisAudioChannel *ch)
+{
+    ch->volPos        = 0;
+    ch->volFrames     = 0;
+    ch->fadeFrom      = ORBISAUDIO_VOLUME_MAX;
+    ch->fadeTo        = ORBISAUDIO_VOLUME_MAX;
+    ch->fadePos       = 0;
+    ch->fadeFrames    = 0;
+    ch->pausing       = 0;
+    ch->xfadeCallback = NULL;
+}
+
+void orbisAudioFadeVolume(OrbisAudioChannel *ch, unsigned int l, unsigned int r)
+{
+    // a new target starts from wherever the running ramp got to
+    ch->volFrom[0] = orbisAudioFadeAt(ch->volFrom[0], ch->leftVol,  ch->volPos, ch->volFrames);
+    ch->volFrom[1] = orbisAudioFadeAt(ch->volFrom[1], ch->rightVol, ch->volPos, ch->volFrames);
+    ch->leftVol    = l;
+    ch->rightVol   = r;
+    ch->volPos     = 0;
+    ch->volFrames  = orbisAudioFadeFrames(ch->rampMs, ch->frequency);
+}
+
+// pause fades out and then stops rendering, resume from a full pause fades in from silence
+void orbisAudioFadePause(OrbisAudioChannel *ch, int pause)
+{
+    unsigned int now = orbisAudioFadeAt(ch->fadeFrom, ch->fadeTo, ch->fadePos, ch->fadeFrames);
+
+    if(pause)
+    {
+        if(ch->paused) return;
+        ch->pausing = 1;
+        ch->fadeTo  = 0;
+    }
+    else
+    {
+        if(ch->paused) now = 0;
+        ch->paused  = 0;
+        ch->pausing = 0;
+        ch->fadeTo  = ORBISAUDIO_VOLUME_MAX;
+    }
+    ch->fadeFrom   = now;
+    ch->fadePos    = 0;
+    ch->fadeFrames = orbisAudioFadeFrames(ORBISAUDIO_FADE_MS, ch->frequency);
+
+    if(ch->pausing && !ch->fadeFrames) { ch->paused = 1; ch->pausing = 0; }
+}
+
+void orbisAudioFadeCrossfade(OrbisAudioChannel *ch, OrbisAudioCallback callback, void *userData, unsigned int ms)
+{
+    unsigned int frequency = ch->sourceFrequency ? ch->sourceFrequency : ch->frequency;
+
+    // a crossfade still running is cut short, its incoming callback takes over
+    if(ch->xfadeCallback)
+    {
+        ch->callback = ch->xfadeCallback;
+        ch->userData = ch->xfadeUserData;
+    }
+    ch->xfadeCallback = NULL;
+
+    if(!callback || !ch->crossfadeBuffer || !orbisAudioFadeFrames(ms, frequency))
+    {
+        ch->callback = callback;
+        ch->userData = userData;
+        return;
+    }
+    ch->xfadeUserData = userData;
+    ch->xfadePos      = 0;
+    ch->xfadeFrames   = orbisAudioFadeFrames(ms, frequency);
+    ch->xfadeCallback = callback;
+}
+
+// volume and pause/resume fade of one port rate block, in place
+void orbisAudioFadeGain(OrbisAudioChannel *ch, short *buf, unsigned int samples)
+{
+    unsigned int frameSize = ch->stereo + 1;
+    unsigned int done = 0;
+
+    while(done < samples)
+    {
+        unsigned int n = samples - done;
+        unsigned int f0, f1, l0, r0, l1, r1;
+
+        // split where a ramp ends
+        if(ch->volPos  < ch->volFrames  && ch->volFrames  - ch->volPos  < n) n = ch->volFrames  - ch->volPos;
+        if(ch->fadePos < ch->fadeFrames && ch->fadeFrames - ch->fadePos < n) n = ch->fadeFrames - ch->fadePos;
+
+        f0 = orbisAudioFadeAt(ch->fadeFrom, ch->fadeTo, ch->fadePos, ch->fadeFrames);
+        l0 = (orbisAudioFadeAt(ch->volFrom[0], ch->leftVol,  ch->volPos, ch->volFrames) * f0) >> 15;
+        r0 = (orbisAudioFadeAt(ch->volFrom[1], ch->rightVol, ch->volPos, ch->volFrames) * f0) >> 15;
+
+        if(ch->volPos  < ch->volFrames)  ch->volPos  += n;
+        if(ch->fadePos < ch->fadeFrames) ch->fadePos += n;
+
+        f1 = orbisAudioFadeAt(ch->fadeFrom, ch->fadeTo, ch->fadePos, ch->fadeFrames);
+        l1 = (orbisAudioFadeAt(ch->volFrom[0], ch->leftVol,  ch->volPos, ch->volFrames) * f1) >> 15;
+        r1 = (orbisAudioFadeAt(ch->volFrom[1], ch->rightVol, ch->volPos, ch->volFrames) * f1) >> 15;
+
+        if(l0 == l1 && r0 == r1) orbisAudioGainS16(buf + done * frameSize, buf + done * frameSize, n, ch->stereo, l0, r0);
+        else                     orbisAudioGainRampS16(buf + done * frameSize, buf + done * frameSize, n, ch->stereo, l0, r0, l1, r1);
+        done += n;
+    }
+
+    if(ch->pausing && ch->fadePos >= ch->fadeFrames)
+    {
+        ch->paused  = 1;
+        ch->pausing = 0;
+    }
+}
+
+// 1 when orbisAudioFadeGain would leave the block as it is: full volume, no ramp or fade running
+int orbisAudioFadeIsUnity(const OrbisAudioChannel *ch)
+{
+    return ch->leftVol == ORBISAUDIO_VOLUME_MAX && ch->rightVol == ORBISAUDIO_VOLUME_MAX && ch->volPos >= ch->volFrames
+        && ch->fadeTo == ORBISAUDIO_VOLUME_MAX && ch->fadePos >= ch->fadeFrames && !ch->pausing;
+}
+
+static unsigned int orbisAudioFadeEqualPower(unsigned int pos, unsigned int frames)
+{
+    return (unsigned int)lrintf(sinf((float)pos / frames * (float)M_PI_2) * ORBISAUDIO_VOLUME_MAX);
+}
+
+/*
+ * One source rate block of a crossfade: buf already holds the outgoing
+ * source, the incoming callback renders next to it and the two are summed
+ * along an equal power curve, linear over short segments.
+ */
+void orbisAudioFadeCrossfadeBlock(OrbisAudioChannel *ch, short *buf, unsigned int samples)
+{
+    unsigned int frameSize = ch->stereo + 1;
+    short       *xbuf = ch->crossfadeBuffer;
+    void        *xsrc = xbuf;
+    unsigned int done = 0;
+
+    // same staging as the main source: convert buffer for floats, upper half for mono on a stereo port
+    if(ch->format != ch->stereo) xsrc = ch->convertBuffer ? (void *)ch->convertBuffer : (void *)(xbuf + samples);
+    ch->xfadeCallback(xsrc, samples, ch->xfadeUserData);
+    if(xsrc != xbuf) orbisAudioConvertBlock(ch, xbuf, xsrc, samples);
+
+    while(done < samples && ch->xfadePos < ch->xfadeFrames)
+    {
+        unsigned int n = ch->xfadeFrames - ch->xfadePos;
+        unsigned int in0, in1, out0, out1;
+
+        if(n > ORBISAUDIO_XFADE_SEGMENT) n = ORBISAUDIO_XFADE_SEGMENT;
+        if(n > samples - done) n = samples - done;
+
+        in0  = orbisAudioFadeEqualPower(ch->xfadePos, ch->xfadeFrames);
+        out0 = orbisAudioFadeEqualPower(ch->xfadeFrames - ch->xfadePos, ch->xfadeFrames);
+        ch->xfadePos += n;
+        in1  = orbisAudioFadeEqualPower(ch->xfadePos, ch->xfadeFrames);
+        out1 = orbisAudioFadeEqualPower(ch->xfadeFrames - ch->xfadePos, ch->xfadeFrames);
+
+        orbisAudioGainRampS16(buf  + done * frameSize, buf  + done * frameSize, n, ch->stereo, out0, out0, out1, out1);
+        orbisAudioGainRampS16(xbuf + done * frameSize, xbuf + done * frameSize, n, ch->stereo, in0, in0, in1, in1);
+        done += n;
+    }
+
+    // past the end only the incoming source is left
+    if(done < samples) orbisAudioGainS16(buf + done * frameSize, buf + done * frameSize, samples - done, ch->stereo, 0, 0);
+    orbisAudioMixS16(buf, xbuf, samples * frameSize);
+
+    if(ch->xfadePos >= ch->xfadeFrames)
+    {
+        ch->callback      = ch->xfadeCallback;
+        ch->userData      = ch->xfadeUserData;
+        ch->xfadeCallback = NULL;
+    }
+}
@@ -0,0 +1,177 @@
+/*
+#  ____   ____    ____         ___ ____   ____ _     _
+# |    |  ____>   ____>  |    |        | <____  \   /
+# |____| |    \   ____>  | ___|    ____| <____   \_/    ORBISDEV Open Source Project.
+#------------------------------------------------------------------------------------
+# Copyright 2010-2020, orbisdev - http://orbisdev.github.io
+# Licenced under the MIT license
+# Review README & LICENSE files for further details.
+*/
+
+// shared between the library modules, not installed
+
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+
+#include "orbisAudio.h"
+
+
+#if defined (__PS4__)
+
+#include <ps4sdk.h>
+#include <debugnet.h>
+#define  fprintf  debugNetPrintf
+#define  ERROR    DEBUGNET_ERROR
+#define  DEBUG    DEBUGNET_DEBUG
+#define  INFO     DEBUGNET_INFO
+
+
+#else // on pc
+
+#include <stdio.h>
+#include <unistd.h>
+#define  debugNetPrintf  fprintf
+#define  ERROR           stderr
+#define  DEBUG           stdout
+#define  INFO            stdout
+
+#define  sceKernelUsleep  usleep
+
+#endif
+
+
+// output backend vtable, see orbisAudioBackend.c
+typedef struct OrbisAudioBackend
+{
+    const char *name;
+    int  (*init)(void);
+    int  (*open)(int type, unsigned int samples, unsigned int frequency, int format); // handle > 0
+    int  (*output)(int handle, void *buf);  // blocks like sceAudioOutOutput
+    void (*close)(int handle);
+    void (*shutdown)(void);
+} OrbisAudioBackend;
+
+int  orbisAudioBackendInit(void);
+int  orbisAudioBackendOpen(int type, unsigned int samples, unsigned int frequency, int format);
+int  orbisAudioBackendOutput(int handle, void *buf);
+void orbisAudioBackendClose(int handle);
+void orbisAudioBackendShutdown(void);
+int  orbisAudioBackendIsOffline(void);
+void orbisAudioWavWriteHeader(FILE *fp, unsigned int channels, unsigned int frequency, uint32_t dataBytes);
+
+
+// one preallocated block for every library allocation, see orbisAudioArena.c
+int   orbisAudioArenaInit(void);
+void *orbisAudioArenaAlloc(unsigned int channel, size_t bytes);
+void *orbisAudioArenaAllocGlobal(size_t bytes);
+void  orbisAudioArenaReset(unsigned int channel);
+void  orbisAudioArenaRelease(void);
+
+
+extern OrbisAudioConfig *orbisAudioConf;
+
+// stats counters have a single writer, a relaxed load + store is enough and never locks the bus
+static inline void orbisAudioStatAdd(uint64_t *counter, uint64_t v)
+{
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + v, __ATOMIC_RELAXED);
+}
+
+// channels of a sample format, 0 when the library doesn't know it
+static inline unsigned int orbisAudioFormatChannels(int format)
+{
+    switch(format)
+    {
+        case ORBISAUDIO_FORMAT_S16_MONO:
+        case ORBISAUDIO_FORMAT_FLOAT_MONO:            return 1;
+        case ORBISAUDIO_FORMAT_S16_STEREO:
+        case ORBISAUDIO_FORMAT_FLOAT_STEREO:
+        case ORBISAUDIO_FORMAT_FLOAT_STEREO_PLANAR:   return 2;
+        case ORBISAUDIO_FORMAT_S16_8CH:
+        case ORBISAUDIO_FORMAT_FLOAT_8CH:             return 8;
+        default:                                      return 0;
+    }
+}
+
+static inline int orbisAudioFormatIsFloat(int format)
+{
+    return !(format == ORBISAUDIO_FORMAT_S16_MONO || format == ORBISAUDIO_FORMAT_S16_STEREO || format == ORBISAUDIO_FORMAT_S16_8CH);
+}
+
+static inline unsigned int orbisAudioFormatFrameBytes(int format)
+{
+    return orbisAudioFormatChannels(format) * (orbisAudioFormatIsFloat(format) ? sizeof(float) : sizeof(short));
+}
+
+void orbisAudioWaitDeadline(OrbisAudioChannel *ch);
+void orbisAudioChannelPrime(OrbisAudioChannel *ch);
+short *orbisAudioChannelBlock(OrbisAudioChannel *ch);
+void orbisAudioRenderChannel(OrbisAudioChannel *ch, void *buf, unsigned int samples);
+int  orbisAudioOutputBlock(OrbisAudioChannel *ch, void *buf);
+OrbisAudioChannel *orbisAudioGetChannel(unsigned int channel);
+int  orbisAudioCreateBuffersChannel(unsigned int channel, unsigned int samples, unsigned int format);
+int  orbisAudioCreateResamplerChannel(OrbisAudioChannel *ch, unsigned int frequency, unsigned int portFrequency);
+
+// the channel renders something other than silence
+static inline int orbisAudioChannelHasSource(OrbisAudioChannel *ch)
+{
+    return ch->callback || ch->xfadeCallback || ch->ring || ch->stream || ch->voices;
+}
+
+#define ORBISAUDIO_CONTROL_PAUSE	0
+#define ORBISAUDIO_CONTROL_RESUME	1
+#define ORBISAUDIO_CONTROL_VOLUME	2
+#define ORBISAUDIO_CONTROL_CALLBACK	3
+#define ORBISAUDIO_CONTROL_RAMP		4
+#define ORBISAUDIO_CONTROL_CROSSFADE	5
+#define ORBISAUDIO_CONTROL_PACING	6
+
+int  orbisAudioControlPush(OrbisAudioChannel *ch, const OrbisAudioControl *cmd);
+void orbisAudioControlApply(OrbisAudioChannel *ch);
+
+void orbisAudioFadeReset(OrbisAudioChannel *ch);
+void orbisAudioFadeVolume(OrbisAudioChannel *ch, unsigned int l, unsigned int r);
+void orbisAudioFadePause(OrbisAudioChannel *ch, int pause);
+void orbisAudioFadeCrossfade(OrbisAudioChannel *ch, OrbisAudioCallback callback, void *userData, unsigned int ms);
+void orbisAudioFadeGain(OrbisAudioChannel *ch, short *buf, unsigned int samples);
+int  orbisAudioFadeIsUnity(const OrbisAudioChannel *ch);
+void orbisAudioFadeCrossfadeBlock(OrbisAudioChannel *ch, short *buf, unsigned int samples);
+void orbisAudioConvertBlock(OrbisAudioChannel *ch, short *dst, const void *src, unsigned int frames);
+
+void orbisAudioVoiceRender(OrbisAudioChannel *ch, short *buf, unsigned int samples);
+unsigned int orbisAudioVoiceSetGains(unsigned int channel, const int *voices, const float *gainL, const float *gainR, const float *pitch, unsigned int count);
+
+void orbisAudioTapSubmit(OrbisAudioChannel *ch, short **slot, const short *buf);
+void orbisAudioTapDetach(OrbisAudioChannel *ch);
+void orbisAudioTapShutdown(void);
+
+unsigned int orbisAudioStreamPop(OrbisAudioStream *s, void *dst, unsigned int frames, int *starved);
+void orbisAudioStreamDetach(OrbisAudioChannel *ch);
+void orbisAudioStreamShutdown(void);
+void orbisAudioStreamPump(void);
+
+// sequential IMA ADPCM decoding, see orbisAudioAdpcm.c
+typedef struct OrbisAudioAdpcmState
+{
+    unsigned int next;      // frame read next, ~0 before the first seek
+    int          pred[2];
+    int          index[2];
+} OrbisAudioAdpcmState;
+
+void orbisAudioAdpcmRead(OrbisAudioAdpcmState *st, const OrbisAudioSound *sound, short *dst, unsigned int frames);
+void orbisAudioAdpcmSeek(OrbisAudioAdpcmState *st, const OrbisAudioSound *sound, unsigned int frame);
+
+int  orbisAudioInitMixerInput(unsigned int channel, unsigned int frequency, int format);
+void orbisAudioFinishMixer();
+void orbisAudioMixerSync();
+short *orbisAudioMixerBlock(OrbisAudioChannel *master);
+
+unsigned int orbisAudioRingFill(OrbisAudioRing *ring);
+unsigned int orbisAudioRingPop(OrbisAudioRing *ring, short *dst, unsigned int frames);
+void orbisAudioDestroyRing(OrbisAudioChannel *ch);
+
+size_t orbisAudioResamplerBytes(unsigned int channels, int quality, unsigned int inBlock);
+OrbisAudioResampler *orbisAudioResamplerInit(void *mem, unsigned int inRate, unsigned int outRate, unsigned int channels, int quality, unsigned int inBlock);
+
+size_t orbisAudioDspBytes(unsigned int channels, unsigned int maxFrames);
+OrbisAudioDsp *orbisAudioDspInit(void *mem, unsigned int frequency, unsigned int channels, unsigned int maxFrames);
@@ -0,0 +1,597 @@
+/*
+#  ____   ____    ____         ___ ____   ____ _     _
+# |    |  ____>   ____>  |    |        | <____  \   /
+# |____| |    \   ____>  | ___|    ____| <____   \_/    ORBISDEV Open Source Project.
+#------------------------------------------------------------------------------------
+# Copyright 2010-2020, orbisdev - http://orbisdev.github.io
+# Licenced under the MIT license
+# Review README & LICENSE files for further details.
+*/
+
+// sample processing kernels, every SIMD kernel has a scalar reference version
+
+#include <string.h>
+#include <math.h>
+
+#if defined (__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined (__SSSE3__)
+#include <tmmintrin.h>
+#endif
+#if defined (__AVX2__) || defined (__FMA__)
+#include <immintrin.h>
+#endif
+
+#include "orbisAudio.h"
+
+// float references must round after every operation like the SIMD kernels do: no multiply
+// and add fused behind our back with -march flags that enable FMA; explicit fmaf still is
+#if defined (__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined (__GNUC__)
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
+
+static inline short orbisAudioSaturate(int v)
+{
+    if(v >  32767) return  32767;
+    if(v < -32768) return -32768;
+    return (short)v;
+}
+
+// dst[i] = sat(dst[i] + src[i]), count is in shorts
+void orbisAudioMixS16Ref(short *dst, const short *src, unsigned int count)
+{
+    for(unsigned int i=0; i<count; i++) dst[i] = orbisAudioSaturate(dst[i] + src[i]);
+}
+
+void orbisAudioMixS16(short *dst, const short *src, unsigned int count)
+{
+    unsigned int i = 0;
+#if defined (__AVX2__)
+    for(; i+16<=count; i+=16)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(dst + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(src + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_adds_epi16(a, b));
+    }
+#endif
+#if defined (__SSE2__)
+    for(; i+8<=count; i+=8)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_adds_epi16(a, b));
+    }
+#endif
+    orbisAudioMixS16Ref(dst + i, src + i, count - i);
+}
+
+// dst is stereo, src is mono: both sides of dst get src[i] added
+void orbisAudioMixMonoS16Ref(short *dst, const short *src, unsigned int frames)
+{
+    for(unsigned int i=0; i<frames; i++)
+    {
+        dst[2*i]   = orbisAudioSaturate(dst[2*i]   + src[i]);
+        dst[2*i+1] = orbisAudioSaturate(dst[2*i+1] + src[i]);
+    }
+}
+
+void orbisAudioMixMonoS16(short *dst, const short *src, unsigned int frames)
+{
+    unsigned int i = 0;
+#if defined (__SSE2__)
+    for(; i+8<=frames; i+=8)
+    {
+        __m128i m  = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i lo = _mm_loadu_si128((const __m128i *)(dst + 2*i));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(dst + 2*i + 8));
+        _mm_storeu_si128((__m128i *)(dst + 2*i),     _mm_adds_epi16(lo, _mm_unpacklo_epi16(m, m)));
+        _mm_storeu_si128((__m128i *)(dst + 2*i + 8), _mm_adds_epi16(hi, _mm_unpackhi_epi16(m, m)));
+    }
+#endif
+    orbisAudioMixMonoS16Ref(dst + 2*i, src + i, frames - i);
+}
+
+// Q15 gain with rounding: vol == ORBISAUDIO_VOLUME_MAX is unity
+void orbisAudioGainS16Ref(short *dst, const short *src, unsigned int frames, int stereo, unsigned int l, unsigned int r)
+{
+    if(l > ORBISAUDIO_VOLUME_MAX) l = ORBISAUDIO_VOLUME_MAX;
+    if(r > ORBISAUDIO_VOLUME_MAX) r = ORBISAUDIO_VOLUME_MAX;
+
+    if(stereo)
+    {
+        for(unsigned int i=0; i<frames; i++)
+        {
+            dst[2*i]   = orbisAudioSaturate((src[2*i]   * (int)l + 16384) >> 15);
+            dst[2*i+1] = orbisAudioSaturate((src[2*i+1] * (int)r + 16384) >> 15);
+        }
+    }
+    else
+    {
+        for(unsigned int i=0; i<frames; i++) dst[i] = orbisAudioSaturate((src[i] * (int)l + 16384) >> 15);
+    }
+}
+
+/*
+ * Same result as orbisAudioGainS16Ref. Gains below unity fit in a signed Q15
+ * word, so pmulhrsw gives the rounded product directly and never overflows.
+ * A side at unity is encoded as 0x8000 and masked back to the input sample.
+ * dst may equal src.
+ */
+void orbisAudioGainS16(short *dst, const short *src, unsigned int frames, int stereo, unsigned int l, unsigned int r)
+{
+    unsigned int i = 0, count;
+
+    if(l > ORBISAUDIO_VOLUME_MAX) l = ORBISAUDIO_VOLUME_MAX;
+    if(r > ORBISAUDIO_VOLUME_MAX) r = ORBISAUDIO_VOLUME_MAX;
+    if(!stereo) r = l;
+
+    count = stereo ? frames * 2 : frames;
+
+    if(l == ORBISAUDIO_VOLUME_MAX && r == ORBISAUDIO_VOLUME_MAX)
+    {
+        if(dst != src) memmove(dst, src, count * sizeof(short));
+        return;
+    }
+
+#if defined (__AVX2__)
+    {
+        __m256i g    = _mm256_set1_epi32((int)((r << 16) | l));
+        __m256i keep = _mm256_cmpeq_epi16(g, _mm256_set1_epi16((short)0x8000));
+        for(; i+16<=count; i+=16)
+        {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+            __m256i y = _mm256_mulhrs_epi16(x, g);
+            _mm256_storeu_si256((__m256i *)(dst + i), _mm256_blendv_epi8(y, x, keep));
+        }
+    }
+#endif
+#if defined (__SSSE3__)
+    {
+        __m128i g    = _mm_set1_epi32((int)((r << 16) | l));
+        __m128i keep = _mm_cmpeq_epi16(g, _mm_set1_epi16((short)0x8000));
+        for(; i+8<=count; i+=8)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+            __m128i y = _mm_mulhrs_epi16(x, g);
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(_mm_and_si128(keep, x), _mm_andnot_si128(keep, y)));
+        }
+    }
+#elif defined (__SSE2__)
+    {
+        // (x, 1) . (g, 16384) = x*g + rounding, then >>15 and pack with saturation
+        __m128i one  = _mm_set1_epi16(1);
+        __m128i gl   = _mm_set_epi16(16384, (short)r, 16384, (short)l, 16384, (short)r, 16384, (short)l);
+        __m128i keep = _mm_cmpeq_epi16(_mm_set1_epi32((int)((r << 16) | l)), _mm_set1_epi16((short)0x8000));
+        for(; i+8<=count; i+=8)
+        {
+            __m128i x  = _mm_loadu_si128((const __m128i *)(src + i));
+            __m128i lo = _mm_srai_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(x, one), gl), 15);
+            __m128i hi = _mm_srai_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(x, one), gl), 15);
+            __m128i y  = _mm_packs_epi32(lo, hi);
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(_mm_and_si128(keep, x), _mm_andnot_si128(keep, y)));
+        }
+    }
+#endif
+    // i is always even here, so the tail starts on a left sample
+    if(stereo) orbisAudioGainS16Ref(dst + i, src + i, (count - i) / 2, 1, l, r);
+    else       orbisAudioGainS16Ref(dst + i, src + i, count - i, 0, l, r);
+}
+
+/*
+ * Gain ramp, per sample. Gains run as Q15.16 accumulators stepped once a
+ * frame and are rounded to Q15 for every sample, so the SIMD versions give
+ * exactly the same result. The first frame gets l0/r0, the ramp would reach
+ * l1/r1 on the frame after the last.
+ */
+static void orbisAudioGainRampTail(short *dst, const short *src, unsigned int frames, int stereo, uint32_t gl, uint32_t gr, uint32_t dl, uint32_t dr)
+{
+    for(unsigned int i=0; i<frames; i++, gl+=dl, gr+=dr)
+    {
+        if(stereo)
+        {
+            dst[2*i]   = orbisAudioSaturate((src[2*i]   * (int)((gl + 0x8000) >> 16) + 16384) >> 15);
+            dst[2*i+1] = orbisAudioSaturate((src[2*i+1] * (int)((gr + 0x8000) >> 16) + 16384) >> 15);
+        }
+        else dst[i] = orbisAudioSaturate((src[i] * (int)((gl + 0x8000) >> 16) + 16384) >> 15);
+    }
+}
+
+static inline uint32_t orbisAudioGainRampStep(unsigned int g0, unsigned int g1, unsigned int frames)
+{
+    return (uint32_t)(int32_t)(((int64_t)g1 - (int64_t)g0) * 65536 / (int64_t)frames);
+}
+
+void orbisAudioGainRampS16Ref(short *dst, const short *src, unsigned int frames, int stereo, unsigned int l0, unsigned int r0, unsigned int l1, unsigned int r1)
+{
+    if(!frames) return;
+    if(l0 > ORBISAUDIO_VOLUME_MAX) l0 = ORBISAUDIO_VOLUME_MAX;
+    if(r0 > ORBISAUDIO_VOLUME_MAX) r0 = ORBISAUDIO_VOLUME_MAX;
+    if(l1 > ORBISAUDIO_VOLUME_MAX) l1 = ORBISAUDIO_VOLUME_MAX;
+    if(r1 > ORBISAUDIO_VOLUME_MAX) r1 = ORBISAUDIO_VOLUME_MAX;
+
+    orbisAudioGainRampTail(dst, src, frames, stereo, l0 << 16, r0 << 16, orbisAudioGainRampStep(l0, l1, frames), orbisAudioGainRampStep(r0, r1, frames));
+}
+
+#if defined (__SSE2__)
+
+/*
+ * Q15 gains up to unity don't fit a signed word, so each one is split in two
+ * halves of at most 16384 and pmaddwd sums x*half + x*half per 32 bit lane.
+ * g holds one gain a lane, for the samples x was unpacked into.
+ */
+static inline __m128i orbisAudioGainRampMul(__m128i x, __m128i g)
+{
+    __m128i hi = _mm_srli_epi32(g, 1);
+    __m128i p  = _mm_or_si128(hi, _mm_slli_epi32(_mm_sub_epi32(g, hi), 16));
+    return _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(x, p), _mm_set1_epi32(16384)), 15);
+}
+
+#endif
+
+// dst may equal src
+void orbisAudioGainRampS16(short *dst, const short *src, unsigned int frames, int stereo, unsigned int l0, unsigned int r0, unsigned int l1, unsigned int r1)
+{
+    unsigned int i = 0;
+    uint32_t     gl, gr, dl, dr;
+
+    if(!frames) return;
+    if(l0 > ORBISAUDIO_VOLUME_MAX) l0 = ORBISAUDIO_VOLUME_MAX;
+    if(r0 > ORBISAUDIO_VOLUME_MAX) r0 = ORBISAUDIO_VOLUME_MAX;
+    if(l1 > ORBISAUDIO_VOLUME_MAX) l1 = ORBISAUDIO_VOLUME_MAX;
+    if(r1 > ORBISAUDIO_VOLUME_MAX) r1 = ORBISAUDIO_VOLUME_MAX;
+
+    gl = l0 << 16;
+    gr = r0 << 16;
+    dl = orbisAudioGainRampStep(l0, l1, frames);
+    dr = orbisAudioGainRampStep(r0, r1, frames);
+
+#if defined (__SSE2__)
+    {
+        __m128i round = _mm_set1_epi32(0x8000);
+
+        if(stereo)
+        {
+            // four frames a pass: left and right accumulators for frames i..i+3
+            __m128i al, ar;
+            uint32_t l4[4], r4[4];
+
+            for(unsigned int k=0; k<4; k++) { l4[k] = gl + dl * k; r4[k] = gr + dr * k; }
+            al = _mm_loadu_si128((const __m128i *)l4);
+            ar = _mm_loadu_si128((const __m128i *)r4);
+
+            for(; i+4<=frames; i+=4)
+            {
+                __m128i x  = _mm_loadu_si128((const __m128i *)(src + 2*i));
+                __m128i ql = _mm_srli_epi32(_mm_add_epi32(al, round), 16);
+                __m128i qr = _mm_srli_epi32(_mm_add_epi32(ar, round), 16);
+                __m128i lo = orbisAudioGainRampMul(_mm_unpacklo_epi16(x, x), _mm_unpacklo_epi32(ql, qr));
+                __m128i hi = orbisAudioGainRampMul(_mm_unpackhi_epi16(x, x), _mm_unpackhi_epi32(ql, qr));
+
+                _mm_storeu_si128((__m128i *)(dst + 2*i), _mm_packs_epi32(lo, hi));
+                al = _mm_add_epi32(al, _mm_set1_epi32((int)(dl * 4)));
+                ar = _mm_add_epi32(ar, _mm_set1_epi32((int)(dr * 4)));
+            }
+        }
+        else
+        {
+            // eight frames a pass, two accumulators of four
+            __m128i a0, a1;
+            uint32_t g8[8];
+
+            for(unsigned int k=0; k<8; k++) g8[k] = gl + dl * k;
+            a0 = _mm_loadu_si128((const __m128i *)g8);
+            a1 = _mm_loadu_si128((const __m128i *)(g8 + 4));
+
+            for(; i+8<=frames; i+=8)
+            {
+                __m128i x  = _mm_loadu_si128((const __m128i *)(src + i));
+                __m128i lo = orbisAudioGainRampMul(_mm_unpacklo_epi16(x, x), _mm_srli_epi32(_mm_add_epi32(a0, round), 16));
+                __m128i hi = orbisAudioGainRampMul(_mm_unpackhi_epi16(x, x), _mm_srli_epi32(_mm_add_epi32(a1, round), 16));
+
+                _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(lo, hi));
+                a0 = _mm_add_epi32(a0, _mm_set1_epi32((int)(dl * 8)));
+                a1 = _mm_add_epi32(a1, _mm_set1_epi32((int)(dl * 8)));
+            }
+        }
+    }
+#endif
+    orbisAudioGainRampTail(dst + (stereo ? 2*i : i), src + (stereo ? 2*i : i), frames - i, stereo, gl + dl * i, gr + dr * i, dl, dr);
+}
+
+// dst is stereo, src is mono: both sides of dst get src[i]. dst may be src - frames, i.e. src in the upper half of dst
+void orbisAudioExpandMonoS16Ref(short *dst, const short *src, unsigned int frames)
+{
+    for(unsigned int i=0; i<frames; i++)
+    {
+        short m = src[i];
+        dst[2*i]   = m;
+        dst[2*i+1] = m;
+    }
+}
+
+void orbisAudioExpandMonoS16(short *dst, const short *src, unsigned int frames)
+{
+    unsigned int i = 0;
+#if defined (__SSE2__)
+    for(; i+8<=frames; i+=8)
+    {
+        __m128i m = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + 2*i),     _mm_unpacklo_epi16(m, m));
+        _mm_storeu_si128((__m128i *)(dst + 2*i + 8), _mm_unpackhi_epi16(m, m));
+    }
+#endif
+    orbisAudioExpandMonoS16Ref(dst + 2*i, src + i, frames - i);
+}
+
+/*
+ * TPDF dither of +-1 LSB: one xorshift32 step per sample, the sum of its two
+ * 16 bit halves is triangular. Sample i uses generator lane i % 8, so the
+ * SIMD versions produce exactly the same output as the scalar ones.
+ */
+static inline float orbisAudioDitherNext(uint32_t *state)
+{
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+
+    return (float)(int)((x >> 16) + (x & 0xffff)) * (1.0f / 65536) - 1.0f;
+}
+
+// scale, dither, clip (NaN clips to the positive rail like minps does) and round to nearest
+static inline short orbisAudioF32ToS16(float s, uint32_t *dither)
+{
+    float v;
+
+    // fused when the SIMD versions are, so both round the same way
+#if defined (__FMA__)
+    v = dither ? fmaf(s, 32767.0f, orbisAudioDitherNext(dither)) : s * 32767.0f;
+#else
+    v = s * 32767.0f;
+    if(dither) v += orbisAudioDitherNext(dither);
+#endif
+    v = v <  32767.0f ? v :  32767.0f;
+    v = v > -32768.0f ? v : -32768.0f;
+
+    return (short)lrintf(v);
+}
+
+void orbisAudioConvertF32ToS16Ref(short *dst, const float *src, unsigned int count, uint32_t *dither)
+{
+    for(unsigned int i=0; i<count; i++) dst[i] = orbisAudioF32ToS16(src[i], dither ? &dither[i & 7] : NULL);
+}
+
+void orbisAudioInterleaveF32ToS16Ref(short *dst, const float *l, const float *r, unsigned int frames, uint32_t *dither)
+{
+    for(unsigned int i=0; i<frames; i++)
+    {
+        dst[2*i]   = orbisAudioF32ToS16(l[i], dither ? &dither[(2*i)   & 7] : NULL);
+        dst[2*i+1] = orbisAudioF32ToS16(r[i], dither ? &dither[(2*i+1) & 7] : NULL);
+    }
+}
+
+#if defined (__SSE2__)
+
+// four lanes of orbisAudioF32ToS16, state is NULL without dither
+static inline __m128i orbisAudioF32ToS32x4(__m128 s, __m128i *state)
+{
+    __m128 v;
+
+    if(!state) v = _mm_mul_ps(s, _mm_set1_ps(32767.0f));
+    else
+    {
+        __m128i x = *state;
+        x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+        x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+        x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+        *state = x;
+
+        __m128i t = _mm_add_epi32(_mm_srli_epi32(x, 16), _mm_and_si128(x, _mm_set1_epi32(0xffff)));
+        __m128  d = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(t), _mm_set1_ps(1.0f / 65536)), _mm_set1_ps(1.0f));
+#if defined (__FMA__)
+        v = _mm_fmadd_ps(s, _mm_set1_ps(32767.0f), d);
+#else
+        v = _mm_add_ps(_mm_mul_ps(s, _mm_set1_ps(32767.0f)), d);
+#endif
+    }
+    v = _mm_min_ps(v, _mm_set1_ps( 32767.0f));
+    v = _mm_max_ps(v, _mm_set1_ps(-32768.0f));
+
+    return _mm_cvtps_epi32(v);
+}
+
+#endif
+
+#if defined (__AVX2__)
+
+static inline __m256i orbisAudioF32ToS32x8(__m256 s, __m256i *state)
+{
+    __m256 v;
+
+    if(!state) v = _mm256_mul_ps(s, _mm256_set1_ps(32767.0f));
+    else
+    {
+        __m256i x = *state;
+        x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+        x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+        x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+        *state = x;
+
+        __m256i t = _mm256_add_epi32(_mm256_srli_epi32(x, 16), _mm256_and_si256(x, _mm256_set1_epi32(0xffff)));
+        __m256  d = _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(t), _mm256_set1_ps(1.0f / 65536)), _mm256_set1_ps(1.0f));
+#if defined (__FMA__)
+        v = _mm256_fmadd_ps(s, _mm256_set1_ps(32767.0f), d);
+#else
+        v = _mm256_add_ps(_mm256_mul_ps(s, _mm256_set1_ps(32767.0f)), d);
+#endif
+    }
+    v = _mm256_min_ps(v, _mm256_set1_ps( 32767.0f));
+    v = _mm256_max_ps(v, _mm256_set1_ps(-32768.0f));
+
+    return _mm256_cvtps_epi32(v);
+}
+
+#endif
+
+void orbisAudioConvertF32ToS16(short *dst, const float *src, unsigned int count, uint32_t *dither)
+{
+    unsigned int i = 0;
+#if defined (__AVX2__)
+    {
+        __m256i state = dither ? _mm256_loadu_si256((const __m256i *)dither) : _mm256_setzero_si256();
+        __m256i *s    = dither ? &state : NULL;
+        for(; i+16<=count; i+=16)
+        {
+            __m256i a = orbisAudioF32ToS32x8(_mm256_loadu_ps(src + i),     s);
+            __m256i b = orbisAudioF32ToS32x8(_mm256_loadu_ps(src + i + 8), s);
+            // packs works per 128 bit lane, put the quadwords back in order
+            _mm256_storeu_si256((__m256i *)(dst + i), _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xd8));
+        }
+        if(dither) _mm256_storeu_si256((__m256i *)dither, state);
+    }
+#elif defined (__SSE2__)
+    {
+        __m128i lo = dither ? _mm_loadu_si128((const __m128i *)dither)       : _mm_setzero_si128();
+        __m128i hi = dither ? _mm_loadu_si128((const __m128i *)(dither + 4)) : _mm_setzero_si128();
+        for(; i+8<=count; i+=8)
+        {
+            __m128i a = orbisAudioF32ToS32x4(_mm_loadu_ps(src + i),     dither ? &lo : NULL);
+            __m128i b = orbisAudioF32ToS32x4(_mm_loadu_ps(src + i + 4), dither ? &hi : NULL);
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(a, b));
+        }
+        if(dither)
+        {
+            _mm_storeu_si128((__m128i *)dither,       lo);
+            _mm_storeu_si128((__m128i *)(dither + 4), hi);
+        }
+    }
+#endif
+    // i is a multiple of 8, the tail starts on generator lane 0
+    orbisAudioConvertF32ToS16Ref(dst + i, src + i, count - i, dither);
+}
+
+void orbisAudioInterleaveF32ToS16(short *dst, const float *l, const float *r, unsigned int frames, uint32_t *dither)
+{
+    unsigned int i = 0;
+#if defined (__SSE2__)
+    {
+        __m128i lo = dither ? _mm_loadu_si128((const __m128i *)dither)       : _mm_setzero_si128();
+        __m128i hi = dither ? _mm_loadu_si128((const __m128i *)(dither + 4)) : _mm_setzero_si128();
+        for(; i+4<=frames; i+=4)
+        {
+            __m128 a = _mm_loadu_ps(l + i);
+            __m128 b = _mm_loadu_ps(r + i);
+            __m128i x = orbisAudioF32ToS32x4(_mm_unpacklo_ps(a, b), dither ? &lo : NULL);
+            __m128i y = orbisAudioF32ToS32x4(_mm_unpackhi_ps(a, b), dither ? &hi : NULL);
+            _mm_storeu_si128((__m128i *)(dst + 2*i), _mm_packs_epi32(x, y));
+        }
+        if(dither)
+        {
+            _mm_storeu_si128((__m128i *)dither,       lo);
+            _mm_storeu_si128((__m128i *)(dither + 4), hi);
+        }
+    }
+#endif
+    // 2*i is a multiple of 8, the tail starts on generator lane 0
+    orbisAudioInterleaveF32ToS16Ref(dst + 2*i, l + i, r + i, frames - i, dither);
+}
+
+/*
+ * ITU downmix: L + C/sqrt2 + Ls/sqrt2 + Lb/sqrt2, and the same on the right,
+ * all scaled by 1/(1 + sqrt2) so a full scale 5.1 mix stays in range. The
+ * s16 versions work in Q15 with rounding, the SIMD one lines each frame up
+ * as L C R C Ls Lb Rs Rb for one madd. The float ones add in the same order
+ * and, with contraction off, match exactly.
+ */
+#define ORBISAUDIO_DOWNMIX_FRONT	0.41421356f
+#define ORBISAUDIO_DOWNMIX_OTHER	0.29289322f
+#define ORBISAUDIO_DOWNMIX_FRONT_Q15	13573
+#define ORBISAUDIO_DOWNMIX_OTHER_Q15	9598
+
+void orbisAudioDownmix8S16Ref(short *dst, const short *src, unsigned int frames)
+{
+    for(unsigned int i=0; i<frames; i++)
+    {
+        const short *s = src + 8*i;
+        int c = ORBISAUDIO_DOWNMIX_OTHER_Q15 * s[2];
+        int l = ORBISAUDIO_DOWNMIX_FRONT_Q15 * s[0] + c + ORBISAUDIO_DOWNMIX_OTHER_Q15 * (s[4] + s[6]);
+        int r = ORBISAUDIO_DOWNMIX_FRONT_Q15 * s[1] + c + ORBISAUDIO_DOWNMIX_OTHER_Q15 * (s[5] + s[7]);
+
+        dst[2*i]   = orbisAudioSaturate((l + (1 << 14)) >> 15);
+        dst[2*i+1] = orbisAudioSaturate((r + (1 << 14)) >> 15);
+    }
+}
+
+#if defined (__SSE2__)
+// one frame to left and right sums in the two low lanes
+static inline __m128i orbisAudioDownmix8x1(__m128i v, __m128i coef)
+{
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 1, 2, 0));
+    v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(3, 1, 2, 0));
+    v = _mm_madd_epi16(v, coef);
+    return _mm_add_epi32(v, _mm_srli_si128(v, 8));
+}
+#endif
+
+void orbisAudioDownmix8S16(short *dst, const short *src, unsigned int frames)
+{
+    unsigned int i = 0;
+#if defined (__SSE2__)
+    const __m128i coef = _mm_setr_epi16(ORBISAUDIO_DOWNMIX_FRONT_Q15, ORBISAUDIO_DOWNMIX_OTHER_Q15, ORBISAUDIO_DOWNMIX_FRONT_Q15, ORBISAUDIO_DOWNMIX_OTHER_Q15,
+                                        ORBISAUDIO_DOWNMIX_OTHER_Q15, ORBISAUDIO_DOWNMIX_OTHER_Q15, ORBISAUDIO_DOWNMIX_OTHER_Q15, ORBISAUDIO_DOWNMIX_OTHER_Q15);
+    const __m128i round = _mm_set1_epi32(1 << 14);
+
+    for(; i+4<=frames; i+=4)
+    {
+        __m128i f0 = orbisAudioDownmix8x1(_mm_loadu_si128((const __m128i *)(src + 8*i)),      coef);
+        __m128i f1 = orbisAudioDownmix8x1(_mm_loadu_si128((const __m128i *)(src + 8*i + 8)),  coef);
+        __m128i f2 = orbisAudioDownmix8x1(_mm_loadu_si128((const __m128i *)(src + 8*i + 16)), coef);
+        __m128i f3 = orbisAudioDownmix8x1(_mm_loadu_si128((const __m128i *)(src + 8*i + 24)), coef);
+        __m128i a  = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi64(f0, f1), round), 15);
+        __m128i b  = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi64(f2, f3), round), 15);
+
+        _mm_storeu_si128((__m128i *)(dst + 2*i), _mm_packs_epi32(a, b));
+    }
+#endif
+    orbisAudioDownmix8S16Ref(dst + 2*i, src + 8*i, frames - i);
+}
+
+void orbisAudioDownmix8F32Ref(float *dst, const float *src, unsigned int frames)
+{
+    for(unsigned int i=0; i<frames; i++)
+    {
+        const float *s = src + 8*i;
+        float l = ORBISAUDIO_DOWNMIX_FRONT * s[0] + ORBISAUDIO_DOWNMIX_OTHER * s[2] + ORBISAUDIO_DOWNMIX_OTHER * (s[4] + s[6]);
+        float r = ORBISAUDIO_DOWNMIX_FRONT * s[1] + ORBISAUDIO_DOWNMIX_OTHER * s[2] + ORBISAUDIO_DOWNMIX_OTHER * (s[5] + s[7]);
+
+        dst[2*i]   = l;
+        dst[2*i+1] = r;
+    }
+}
+
+void orbisAudioDownmix8F32(float *dst, const float *src, unsigned int frames)
+{
+    unsigned int i = 0;
+#if defined (__SSE2__)
+    const __m128 front = _mm_set1_ps(ORBISAUDIO_DOWNMIX_FRONT), other = _mm_set1_ps(ORBISAUDIO_DOWNMIX_OTHER);
+
+    // two frames a pass, both read before anything is written so dst may be src
+    for(; i+2<=frames; i+=2)
+    {
+        __m128 a0 = _mm_loadu_ps(src + 8*i),     b0 = _mm_loadu_ps(src + 8*i + 4);
+        __m128 a1 = _mm_loadu_ps(src + 8*i + 8), b1 = _mm_loadu_ps(src + 8*i + 12);
+        __m128 lr = _mm_movelh_ps(a0, a1);
+        __m128 c  = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(2, 2, 2, 2));
+        __m128 s  = _mm_add_ps(_mm_movelh_ps(b0, b1), _mm_movehl_ps(b1, b0));
+
+        _mm_storeu_ps(dst + 2*i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(front, lr), _mm_mul_ps(other, c)), _mm_mul_ps(other, s)));
+    }
+#endif
+    orbisAudioDownmix8F32Ref(dst + 2*i, src + 8*i, frames - i);
+}
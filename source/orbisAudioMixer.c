@@ -0,0 +1,237 @@
+/*
+#  ____   ____    ____         ___ ____   ____ _     _
+# |    |  ____>   ____>  |    |        | <____  \   /
+# |____| |    \   ____>  | ___|    ____| <____   \_/    ORBISDEV Open Source Project.
+#------------------------------------------------------------------------------------
+# Copyright 2010-2020, orbisdev - http://orbisdev.github.io
+# Licenced under the MIT license
+# Review README & LICENSE files for further details.
+*/
+
+/*
+ * Mixer mode: instead of one output port and one thread per channel, all
+ * logical channels become inputs of a single stereo port. One thread renders
+ * every input, sums them with saturation and submits once per period.
+ */
+
+#include <string.h>
+#include <pthread.h>
+
+#include "orbisAudioInternal.h"
+
+
+// mix every input and submit one block, returns it
+short *orbisAudioMixerBlock(OrbisAudioChannel *master)
+{
+    unsigned int    samples   = master->samples[0];
+    short             *mix;
+    OrbisAudioDsp     *dsp;
+    int ret;
+
+    orbisAudioControlApply(master);
+
+    // the device may still read the previous block, so mix into the other one
+    mix = master->sampleBuffer[master->currentBuffer];
+    master->renderStart[master->currentBuffer] = orbisAudioGetTimeUs();
+    memset(mix, 0, samples * sizeof(OrbisAudioStereoSample));
+
+    for(int i=0; i<ORBISAUDIO_CHANNELS; i++)
+    {
+        OrbisAudioChannel *ch = orbisAudioConf->channels[i];
+
+        if(!ch || __atomic_load_n(&ch->orbisaudiochannel_initialized, __ATOMIC_ACQUIRE) != 1) continue;
+        orbisAudioControlApply(ch);
+        // silent inputs add nothing to the mix
+        if(!orbisAudioChannelHasSource(ch) || ch->paused) continue;
+
+        short *buf = ch->sampleBuffer[ch->currentBuffer];
+        orbisAudioRenderChannel(ch, buf, samples);
+
+        if(ch->stereo) orbisAudioMixS16(mix, buf, samples * 2);
+        else           orbisAudioMixMonoS16(mix, buf, samples);
+        // only the mixer reads an input's blocks, they can go to its tap as they are
+        orbisAudioTapSubmit(ch, &ch->sampleBuffer[ch->currentBuffer], buf);
+
+        ch->currentBuffer = (ch->currentBuffer + 1) % ch->numBuffers;
+        orbisAudioStatAdd(&ch->stats.blocksPlayed, 1);
+    }
+
+    // master volume, ramped like a channel's
+    orbisAudioFadeGain(master, mix, samples);
+
+    // master bus chain, after the master volume
+    dsp = __atomic_load_n(&master->dsp, __ATOMIC_ACQUIRE);
+    if(dsp) orbisAudioDspProcess(dsp, mix, samples);
+
+    ret = orbisAudioOutputBlock(master, mix);
+    if(ret<0) { fprintf(ERROR, "[orbisAudio] mixer output error 0x%08X \n", ret); }
+
+    master->currentBuffer = (master->currentBuffer + 1) % master->numBuffers;
+    __atomic_store_n(&master->blocks, master->blocks + 1, __ATOMIC_RELEASE);
+
+    return mix;
+}
+
+static void *orbisAudioMixerThread(void *argp)
+{
+    OrbisAudioChannel *master = (OrbisAudioChannel *)argp;
+
+    fprintf(DEBUG, "[orbisAudio] orbisAudioMixerThread ready to have a lot of fun!\n");
+
+    while(!__atomic_load_n(&orbisAudioConf->orbisaudio_stop, __ATOMIC_RELAXED))
+    {
+        if(master->pacing != ORBISAUDIO_PACING_POLL) orbisAudioWaitDeadline(master);
+        orbisAudioMixerBlock(master);
+
+        if(master->pacing == ORBISAUDIO_PACING_POLL) sceKernelUsleep(1000);
+    }
+    fprintf(DEBUG, "[orbisAudio] stop:%d, orbisAudioMixerThread exit...\n", orbisAudioConf->orbisaudio_stop);
+
+    return NULL;
+}
+
+// the master and its buffers live in the mixer's arena region
+static void orbisAudioFreeMaster(OrbisAudioChannel *master)
+{
+    orbisAudioArenaReset(ORBISAUDIO_CHANNEL_MASTER);
+}
+
+int orbisAudioInitMixer(unsigned int samples, unsigned int frequency)
+{
+    OrbisAudioChannel *master;
+    int handle, ret;
+
+    if(!orbisAudioConf) { fprintf(ERROR, "[orbisAudio] orbisAudioInitMixer orbisAudioConf is not created\n"); return -1; }
+    if(orbisAudioConf->master) { fprintf(DEBUG, "[orbisAudio] mixer already initialized\n"); return -1; }
+
+    // inputs must all be opened after the mixer so they share its period
+    for(int i=0; i<ORBISAUDIO_CHANNELS; i++)
+    {
+        if(orbisAudioConf->channels[i] && orbisAudioConf->channels[i]->orbisaudiochannel_initialized == 1)
+        {
+            fprintf(ERROR, "[orbisAudio] orbisAudioInitMixer channel %d is already open\n", i); return -1;
+        }
+    }
+
+    if(samples<ORBISAUDIO_MIN_LEN) samples = ORBISAUDIO_MIN_LEN;
+    else
+    {
+        samples = ORBISAUDIO_ALIGN_SAMPLE(samples, ORBISAUDIO_MIN_LEN);
+        if(samples>ORBISAUDIO_MAX_LEN) samples = ORBISAUDIO_MAX_LEN;
+    }
+
+    master = (OrbisAudioChannel *)orbisAudioArenaAlloc(ORBISAUDIO_CHANNEL_MASTER, sizeof(OrbisAudioChannel));
+    if(!master) return -1;
+    memset(master, 0, sizeof(OrbisAudioChannel));
+
+    master->numBuffers = ORBISAUDIO_NUM_BUFFERS;
+    for(unsigned int i=0; i<master->numBuffers; i++)
+    {
+        master->sampleBuffer[i] = (short *)orbisAudioArenaAlloc(ORBISAUDIO_CHANNEL_MASTER, samples * sizeof(OrbisAudioStereoSample));
+        master->samples     [i] = samples;
+        if(!master->sampleBuffer[i]) { orbisAudioFreeMaster(master); return -1; }
+    }
+    // the port runs at the output rate whatever frequency asks for, inputs are resampled to it
+    if(frequency != ORBISAUDIO_OUTPUT_FREQUENCY) fprintf(DEBUG, "[orbisAudio] mixer runs at %u Hz, not %u Hz\n", ORBISAUDIO_OUTPUT_FREQUENCY, frequency);
+    master->frequency  = ORBISAUDIO_OUTPUT_FREQUENCY;
+    master->stereo     = ORBISAUDIO_FORMAT_S16_STEREO;
+    master->leftVol    = ORBISAUDIO_VOLUME_MAX;
+    master->rightVol   = ORBISAUDIO_VOLUME_MAX;
+    master->pacing     = ORBISAUDIO_PACING_BLOCKING;
+    master->rampMs     = ORBISAUDIO_VOLUME_RAMP_MS;
+    orbisAudioFadeReset(master);
+
+    // the mixed block goes out through the MAIN port type
+    handle = orbisAudioBackendOpen(ORBISAUDIO_CHANNEL_MAIN, samples, ORBISAUDIO_OUTPUT_FREQUENCY, ORBISAUDIO_FORMAT_S16_STEREO);
+    if(handle<=0)
+    {
+        fprintf(ERROR, "[orbisAudio] error opening mixer port 0x%08X\n", handle);
+        orbisAudioFreeMaster(master);
+        return -1;
+    }
+    master->audioHandle = handle;
+
+    orbisAudioConf->masterVol       = ORBISAUDIO_VOLUME_MAX;
+    orbisAudioConf->master          = master;
+    orbisAudioConf->orbisaudio_stop = 0;
+
+    // offline the mixer has no thread, orbisAudioRenderOffline mixes on the caller's
+    if(orbisAudioBackendIsOffline())
+    {
+        master->offline = 1;
+        master->orbisaudiochannel_initialized = 1;
+        fprintf(DEBUG, "[orbisAudio] offline mixer %u samples at %u Hz created\n", samples, master->frequency);
+        return 0;
+    }
+
+    ret = pthread_create(&master->threadHandle, NULL, orbisAudioMixerThread, master);
+    if(ret)
+    {
+        fprintf(ERROR, "[orbisAudio] mixer thread could not create error: 0x%08X\n", ret);
+        orbisAudioConf->master = NULL;
+        orbisAudioBackendClose(handle);
+        orbisAudioFreeMaster(master);
+        return -1;
+    }
+    master->orbisaudiochannel_initialized = 1;
+    fprintf(DEBUG, "[orbisAudio] mixer %u samples at %u Hz created\n", samples, master->frequency);
+
+    return 0;
+}
+
+// called from orbisAudioInitChannel in mixer mode: buffers only, no port and no thread
+int orbisAudioInitMixerInput(unsigned int channel, unsigned int frequency, int format)
+{
+    OrbisAudioChannel *master = orbisAudioConf->master;
+    OrbisAudioChannel *ch     = orbisAudioConf->channels[channel];
+
+    if(orbisAudioCreateBuffersChannel(channel, master->samples[0], format)) return -1;
+    if(orbisAudioCreateResamplerChannel(ch, frequency, master->frequency)) return -1;
+
+    ch->audioHandle = -1;
+    ch->frequency   = master->frequency;
+    // the mixer thread picks the input up as soon as this is set: publish the buffers with it
+    __atomic_store_n(&ch->orbisaudiochannel_initialized, 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+// wait until the mixer has started and finished at least one full block
+void orbisAudioMixerSync()
+{
+    OrbisAudioChannel *master = orbisAudioConf->master;
+    uint64_t start;
+
+    if(!master || !master->threadHandle) return;
+
+    start = __atomic_load_n(&master->blocks, __ATOMIC_ACQUIRE);
+    while(__atomic_load_n(&master->blocks, __ATOMIC_ACQUIRE) < start + 2
+       && !__atomic_load_n(&orbisAudioConf->orbisaudio_stop, __ATOMIC_RELAXED))
+        sceKernelUsleep(1000);
+}
+
+void orbisAudioFinishMixer()
+{
+    OrbisAudioChannel *master = orbisAudioConf->master;
+
+    if(!master) return;
+
+    __atomic_store_n(&orbisAudioConf->orbisaudio_stop, 1, __ATOMIC_RELAXED);
+    if(master->threadHandle) pthread_join(master->threadHandle, NULL);
+    orbisAudioTapDetach(master);
+
+    orbisAudioBackendClose(master->audioHandle);
+    orbisAudioFreeMaster(master);
+    orbisAudioConf->master = NULL;
+    fprintf(DEBUG, "[orbisAudio] mixer finished\n");
+}
+
+// queued on the master like a channel volume, so it ramps over the master's rampMs instead of jumping
+int orbisAudioSetMasterVolume(unsigned int vol)
+{
+    if(!orbisAudioConf || !orbisAudioConf->master) return 0;
+    if(vol > ORBISAUDIO_VOLUME_MAX) vol = ORBISAUDIO_VOLUME_MAX;
+
+    __atomic_store_n(&orbisAudioConf->masterVol, vol, __ATOMIC_RELAXED);
+    return orbisAudioSetVolume(ORBISAUDIO_CHANNEL_MASTER, vol, vol);
+}
@@ -0,0 +1,76 @@
+/*
+#  ____   ____    ____         ___ ____   ____ _     _
+# |    |  ____>   ____>  |    |        | <____  \   /
+# |____| |    \   ____>  | ___|    ____| <____   \_/    ORBISDEV Open Source Project.
+#------------------------------------------------------------------------------------
+# Copyright 2010-2020, orbisdev - http://orbisdev.github.io
+# Licenced under the MIT license
+# Review README & LICENSE files for further details.
+*/
+
+/*
+ * Offline rendering: with ORBISAUDIO_BACKEND_OFFLINE channels and the mixer
+ * get no thread, orbisAudioRenderOffline runs their blocks on the calling
+ * thread, back to back, through the same render and submit path the threads
+ * use. Streams are read ahead by the same thread before every block, so no
+ * other thread decides what a block holds: the same calls between renders
+ * give the same samples, run after run.
+ *
+ * Without the mixer every channel runs at its own block size, the one
+ * furthest behind goes next, lowest channel first on a tie.
+ */
+
+#include "orbisAudioInternal.h"
+
+
+int orbisAudioRenderOffline(double seconds, OrbisAudioOfflineSink sink, void *userdata)
+{
+    OrbisAudioChannel *master;
+    unsigned int       rendered[ORBISAUDIO_CHANNELS] = { 0 };
+    unsigned int       frames, done = 0;
+
+    if(!orbisAudioConf || !orbisAudioBackendIsOffline()) { fprintf(ERROR, "[orbisAudio] orbisAudioRenderOffline needs the offline backend\n"); return -1; }
+    if(!(seconds > 0.0) || seconds * ORBISAUDIO_OUTPUT_FREQUENCY >= 0x7fffffff) return -1;
+
+    master = orbisAudioConf->master;
+    frames = (unsigned int)(seconds * ORBISAUDIO_OUTPUT_FREQUENCY + 0.5);
+
+    if(master)
+    {
+        if(master->orbisaudiochannel_initialized != 1) return -1;
+
+        while(done < frames)
+        {
+            short *buf;
+
+            orbisAudioStreamPump();
+            buf = orbisAudioMixerBlock(master);
+            if(sink) sink(ORBISAUDIO_CHANNEL_MASTER, buf, master->samples[0], 2, userdata);
+            done += master->samples[0];
+        }
+        return done;
+    }
+
+    for(;;)
+    {
+        OrbisAudioChannel *next = NULL;
+        unsigned int       n    = 0;
+        short             *buf;
+
+        for(unsigned int i=0; i<ORBISAUDIO_CHANNELS; i++)
+        {
+            OrbisAudioChannel *ch = orbisAudioConf->channels[i];
+
+            if(!ch || !ch->offline || ch->orbisaudiochannel_initialized != 1 || rendered[i] >= frames) continue;
+            if(!next || rendered[i] < rendered[n]) { next = ch; n = i; }
+        }
+        if(!next) break;
+
+        orbisAudioStreamPump();
+        buf = orbisAudioChannelBlock(next);
+        if(sink) sink(n, buf, next->samples[0], next->stereo ? 2 : 1, userdata);
+        rendered[n] += next->samples[0];
+        if(rendered[n] > done) done = rendered[n];
+    }
+    return done;
+}
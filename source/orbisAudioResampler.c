@@ -0,0 +1,295 @@
+/*
+#  ____   ____    ____         ___ ____   ____ _     _
+# |    |  ____>   ____>  |    |        | <____  \   /
+# |____| |    \   ____>  | ___|    ____| <____   \_/    ORBISDEV Open Source Project.
+#------------------------------------------------------------------------------------
+# Copyright 2010-2020, orbisdev - http://orbisdev.github.io
+# Licenced under the MIT license
+# Review README & LICENSE files for further details.
+*/
+
+/*
+ * Streaming polyphase resampler. A Kaiser windowed sinc is tabulated at a
+ * fixed number of phases, the coefficients for the exact fractional position
+ * are interpolated between the two nearest phases, so any ratio works. The
+ * read position is 32.32 fixed point in input frames. Input is pulled on
+ * demand in fixed size blocks and kept as planar float history. Everything
+ * lives in one block sized by orbisAudioResamplerBytes, either malloc'd by
+ * orbisAudioResamplerCreate or carved from the library arena.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined (__SSE__)
+#include <xmmintrin.h>
+#endif
+#if defined (__AVX__)
+#include <immintrin.h>
+#endif
+
+#include "orbisAudioInternal.h"
+
+
+struct OrbisAudioResampler
+{
+    unsigned int channels;
+    unsigned int taps;
+    unsigned int phases;
+    unsigned int inBlock;   // frames per pull
+    unsigned int capacity;  // frames of history per channel
+    unsigned int fill;      // valid history frames
+    uint64_t     pos;       // 32.32 position of the first tap in the history
+    uint64_t     step;      // 32.32 input frames per output frame
+    uint64_t     baseStep;  // step at the nominal rates
+    float       *coeffs;    // (phases + 1) * taps, 32 byte aligned
+    float       *hist[2];
+    short       *staging;   // one pulled block, interleaved
+    int          owned;     // malloc'd by orbisAudioResamplerCreate
+};
+
+static const struct
+{
+    unsigned int taps;
+    unsigned int phases;
+    double       beta;
+    double       cutoff;
+} orbisAudioResampleQualities[] =
+{
+    {  8, 128, 5.0, 0.85 }, // ORBISAUDIO_RESAMPLE_FAST
+    { 16, 256, 7.0, 0.91 }, // ORBISAUDIO_RESAMPLE_MEDIUM
+    { 32, 512, 9.0, 0.95 }, // ORBISAUDIO_RESAMPLE_BEST
+};
+
+
+// modified Bessel function of the first kind, order 0
+static double orbisAudioBesselI0(double x)
+{
+    double sum = 1.0, term = 1.0;
+
+    for(int k=1; k<32; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum  += term;
+    }
+    return sum;
+}
+
+static void orbisAudioResamplerTable(OrbisAudioResampler *rs, double beta, double cutoff)
+{
+    double half = rs->taps / 2.0;
+    double norm = orbisAudioBesselI0(beta);
+
+    for(unsigned int p=0; p<=rs->phases; p++)
+    {
+        float *c = rs->coeffs + p * rs->taps;
+        double frac = (double)p / rs->phases, sum = 0.0;
+
+        for(unsigned int k=0; k<rs->taps; k++)
+        {
+            double d = k - (half - 1.0) - frac;
+            double r = d / half;
+            double w = (r*r < 1.0) ? orbisAudioBesselI0(beta * sqrt(1.0 - r*r)) / norm : 0.0;
+            double s = (d == 0.0) ? 1.0 : sin(M_PI * cutoff * d) / (M_PI * cutoff * d);
+
+            c[k] = (float)(cutoff * s * w);
+            sum += c[k];
+        }
+        // unity gain at DC for every phase
+        for(unsigned int k=0; k<rs->taps; k++) c[k] = (float)(c[k] / sum);
+    }
+}
+
+static int orbisAudioResamplerCheck(unsigned int inRate, unsigned int outRate, unsigned int channels, unsigned int inBlock)
+{
+    return inRate && outRate && channels >= 1 && channels <= 2 && inBlock;
+}
+
+static int orbisAudioResamplerQuality(int quality)
+{
+    if(quality < ORBISAUDIO_RESAMPLE_FAST || quality > ORBISAUDIO_RESAMPLE_BEST) return ORBISAUDIO_RESAMPLE_MEDIUM;
+    return quality;
+}
+
+// bytes needed by orbisAudioResamplerInit: the struct, the table, history and staging
+size_t orbisAudioResamplerBytes(unsigned int channels, int quality, unsigned int inBlock)
+{
+    unsigned int taps   = orbisAudioResampleQualities[orbisAudioResamplerQuality(quality)].taps;
+    unsigned int phases = orbisAudioResampleQualities[orbisAudioResamplerQuality(quality)].phases;
+
+    return ORBISAUDIO_ALIGN_SAMPLE(sizeof(OrbisAudioResampler), 32)
+         + (phases + 1) * taps * sizeof(float)
+         + ORBISAUDIO_ALIGN_SAMPLE((taps + inBlock) * sizeof(float), 32) * channels
+         + inBlock * channels * sizeof(short) + 32;
+}
+
+// build a resampler inside mem, which holds at least orbisAudioResamplerBytes
+OrbisAudioResampler *orbisAudioResamplerInit(void *mem, unsigned int inRate, unsigned int outRate, unsigned int channels, int quality, unsigned int inBlock)
+{
+    OrbisAudioResampler *rs = (OrbisAudioResampler *)mem;
+    size_t coeffBytes, histBytes;
+    uintptr_t p;
+
+    if(!mem || !orbisAudioResamplerCheck(inRate, outRate, channels, inBlock)) return NULL;
+    quality = orbisAudioResamplerQuality(quality);
+
+    memset(rs, 0, sizeof(OrbisAudioResampler));
+
+    rs->channels = channels;
+    rs->taps     = orbisAudioResampleQualities[quality].taps;
+    rs->phases   = orbisAudioResampleQualities[quality].phases;
+    rs->inBlock  = inBlock;
+    rs->capacity = rs->taps + inBlock;
+    rs->step     = ((uint64_t)inRate << 32) / outRate;
+    rs->baseStep = rs->step;
+
+    coeffBytes   = (rs->phases + 1) * rs->taps * sizeof(float);
+    histBytes    = ORBISAUDIO_ALIGN_SAMPLE(rs->capacity * sizeof(float), 32);
+
+    p = ORBISAUDIO_ALIGN_SAMPLE((uintptr_t)mem + sizeof(OrbisAudioResampler), 32);
+    rs->coeffs  = (float *)p;                 p += coeffBytes;
+    for(unsigned int c=0; c<channels; c++) { rs->hist[c] = (float *)p; p += histBytes; }
+    rs->staging = (short *)p;
+
+    // downsampling moves the cutoff below the output nyquist
+    orbisAudioResamplerTable(rs, orbisAudioResampleQualities[quality].beta,
+                             orbisAudioResampleQualities[quality].cutoff * (outRate < inRate ? (double)outRate / inRate : 1.0));
+    orbisAudioResamplerReset(rs);
+
+    return rs;
+}
+
+OrbisAudioResampler *orbisAudioResamplerCreate(unsigned int inRate, unsigned int outRate, unsigned int channels, int quality, unsigned int inBlock)
+{
+    OrbisAudioResampler *rs;
+    void *mem;
+
+    if(!orbisAudioResamplerCheck(inRate, outRate, channels, inBlock)) return NULL;
+
+    mem = malloc(orbisAudioResamplerBytes(channels, quality, inBlock));
+    rs  = orbisAudioResamplerInit(mem, inRate, outRate, channels, quality, inBlock);
+    if(!rs) { free(mem); return NULL; }
+    rs->owned = 1;
+
+    return rs;
+}
+
+void orbisAudioResamplerReset(OrbisAudioResampler *rs)
+{
+    // half a filter of silence so the first input frame lands on the center tap
+    rs->fill = rs->taps / 2;
+    rs->pos  = 0;
+    for(unsigned int c=0; c<rs->channels; c++) memset(rs->hist[c], 0, rs->capacity * sizeof(float));
+}
+
+// scale the nominal step, above 1 consumes input faster; the filter stays the one built for the nominal rates
+void orbisAudioResamplerSetRatio(OrbisAudioResampler *rs, double ratio)
+{
+    rs->step = (uint64_t)((double)rs->baseStep * ratio + 0.5);
+}
+
+void orbisAudioResamplerDestroy(OrbisAudioResampler *rs)
+{
+    // resamplers built in place belong to their memory's owner
+    if(rs && rs->owned) free(rs);
+}
+
+/*
+ * Drop consumed history and append one pulled block, deinterleaved to float.
+ * A step longer than the history, downsampling by more than the filter is
+ * long, can leave pos past everything held: those input frames are pulled
+ * and skipped without ever reaching the history.
+ */
+static void orbisAudioResamplerPull(OrbisAudioResampler *rs, OrbisAudioResamplerPullFn pull, void *ctx)
+{
+    unsigned int drop = (unsigned int)(rs->pos >> 32);
+    unsigned int n    = rs->inBlock;
+    unsigned int skip;
+
+    if(drop > rs->fill) drop = rs->fill;
+    if(drop)
+    {
+        for(unsigned int c=0; c<rs->channels; c++) memmove(rs->hist[c], rs->hist[c] + drop, (rs->fill - drop) * sizeof(float));
+        rs->fill -= drop;
+        rs->pos  -= (uint64_t)drop << 32;
+    }
+
+    pull(rs->staging, n, ctx);
+
+    skip = (unsigned int)(rs->pos >> 32);
+    if(skip > n) skip = n;
+    rs->pos -= (uint64_t)skip << 32;
+
+    if(rs->channels == 1)
+    {
+        float *h = rs->hist[0] + rs->fill;
+        for(unsigned int i=skip; i<n; i++) h[i - skip] = rs->staging[i];
+    }
+    else
+    {
+        float *l = rs->hist[0] + rs->fill, *r = rs->hist[1] + rs->fill;
+        for(unsigned int i=skip; i<n; i++) { l[i - skip] = rs->staging[2*i]; r[i - skip] = rs->staging[2*i+1]; }
+    }
+    rs->fill += n - skip;
+}
+
+static inline float orbisAudioDot(const float *c, const float *x, unsigned int taps)
+{
+    unsigned int k = 0;
+    float sum = 0.0f;
+#if defined (__AVX__)
+    __m256 acc8 = _mm256_setzero_ps();
+    for(; k+8<=taps; k+=8) acc8 = _mm256_add_ps(acc8, _mm256_mul_ps(_mm256_load_ps(c + k), _mm256_loadu_ps(x + k)));
+    __m128 acc = _mm_add_ps(_mm256_castps256_ps128(acc8), _mm256_extractf128_ps(acc8, 1));
+#elif defined (__SSE__)
+    __m128 acc = _mm_setzero_ps();
+#endif
+#if defined (__SSE__)
+    for(; k+4<=taps; k+=4) acc = _mm_add_ps(acc, _mm_mul_ps(_mm_load_ps(c + k), _mm_loadu_ps(x + k)));
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    sum = _mm_cvtss_f32(acc);
+#endif
+    for(; k<taps; k++) sum += c[k] * x[k];
+    return sum;
+}
+
+static inline short orbisAudioFloatToS16(float v)
+{
+    if(v >  32767.0f) return  32767;
+    if(v < -32768.0f) return -32768;
+    return (short)lrintf(v);
+}
+
+void orbisAudioResamplerProcess(OrbisAudioResampler *rs, short *out, unsigned int frames, OrbisAudioResamplerPullFn pull, void *ctx)
+{
+    float c[64] __attribute__((aligned(32)));
+    unsigned int taps = rs->taps;
+
+    for(unsigned int n=0; n<frames; n++)
+    {
+        unsigned int i = (unsigned int)(rs->pos >> 32);
+        uint64_t pf;
+        const float *c0, *c1;
+        float t;
+
+        while(i + taps > rs->fill)
+        {
+            orbisAudioResamplerPull(rs, pull, ctx);
+            i = (unsigned int)(rs->pos >> 32);
+        }
+
+        // coefficients for the exact fraction, interpolated between two table phases
+        pf = (rs->pos & 0xffffffffu) * rs->phases;
+        c0 = rs->coeffs + (pf >> 32) * taps;
+        c1 = c0 + taps;
+        t  = (float)(pf & 0xffffffffu) * (1.0f / 4294967296.0f);
+        for(unsigned int k=0; k<taps; k++) c[k] = c0[k] + (c1[k] - c0[k]) * t;
+
+        for(unsigned int ch=0; ch<rs->channels; ch++)
+            out[n * rs->channels + ch] = orbisAudioFloatToS16(orbisAudioDot(c, rs->hist[ch] + i, taps));
+
+        rs->pos += rs->step;
+    }
+}
@@ -0,0 +1,142 @@
+/*
+#  ____   ____    ____         ___ ____   ____ _     _
+# |    |  ____>   ____>  |    |        | <____  \   /
+# |____| |    \   ____>  | ___|    ____| <____   \_/    ORBISDEV Open Source Project.
+#------------------------------------------------------------------------------------
+# Copyright 2010-2020, orbisdev - http://orbisdev.github.io
+# Licenced under the MIT license
+# Review README & LICENSE files for further details.
+*/
+
+/*
+ * Push API: a lock-free single producer / single consumer ring per channel.
+ * The producer is whatever thread calls orbisAudioPushSamples, the consumer
+ * is the channel (or mixer) thread. head and tail are free running frame
+ * counters, each one written by a single side only.
+ */
+
+#include <string.h>
+
+#include "orbisAudioInternal.h"
+
+
+static unsigned int orbisAudioRingRoundUp(unsigned int v)
+{
+    unsigned int p = 1;
+    while(p < v) p <<= 1;
+    return p;
+}
+
+unsigned int orbisAudioRingFill(OrbisAudioRing *ring)
+{
+    unsigned int head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    unsigned int tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    return head - tail;
+}
+
+// consumer side, returns the number of frames copied to dst
+unsigned int orbisAudioRingPop(OrbisAudioRing *ring, short *dst, unsigned int frames)
+{
+    unsigned int head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    unsigned int tail = ring->tail;
+    unsigned int fill = head - tail;
+    unsigned int mask = ring->frames - 1;
+    unsigned int n, first;
+
+    n     = (frames < fill) ? frames : fill;
+    first = ring->frames - (tail & mask);
+    if(first > n) first = n;
+
+    memcpy(dst, ring->data + (tail & mask) * ring->frameSize, first * ring->frameSize * sizeof(short));
+    memcpy(dst + first * ring->frameSize, ring->data, (n - first) * ring->frameSize * sizeof(short));
+
+    __atomic_store_n(&ring->tail, tail + n, __ATOMIC_RELEASE);
+
+    return n;
+}
+
+int orbisAudioInitRing(unsigned int channel, unsigned int frames)
+{
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
+    OrbisAudioRing    *ring;
+
+    if(!ch || channel >= ORBISAUDIO_CHANNELS) return -1;
+    if(ch->orbisaudiochannel_initialized != 1) { fprintf(ERROR, "[orbisAudio] orbisAudioInitRing channel %u is not initialized\n", channel); return -1; }
+    if(ch->ring) { fprintf(DEBUG, "[orbisAudio] ring for audio channel %u already created\n", channel); return -1; }
+    if(ch->format == ORBISAUDIO_FORMAT_FLOAT_STEREO_PLANAR) { fprintf(ERROR, "[orbisAudio] ring for audio channel %u needs interleaved samples\n", channel); return -1; }
+
+    frames = orbisAudioRingRoundUp(frames < ch->samples[0] ? ch->samples[0] : frames);
+
+    // from the channel's arena region, released with the channel
+    ring = (OrbisAudioRing *)orbisAudioArenaAlloc(channel, sizeof(OrbisAudioRing));
+    if(!ring) return -1;
+    memset(ring, 0, sizeof(OrbisAudioRing));
+
+    ring->frames    = frames;
+    ring->frameSize = orbisAudioFormatFrameBytes(ch->format) / sizeof(short);
+    ring->data      = (short *)orbisAudioArenaAlloc(channel, frames * ring->frameSize * sizeof(short));
+    if(!ring->data) return -1;
+
+    __atomic_store_n(&ch->ring, ring, __ATOMIC_RELEASE);
+    fprintf(DEBUG, "[orbisAudio] ring for audio channel %u created (%u frames)\n", channel, frames);
+
+    return 0;
+}
+
+// the memory goes back with the channel's arena region
+void orbisAudioDestroyRing(OrbisAudioChannel *ch)
+{
+    ch->ring = NULL;
+}
+
+// producer side: never blocks, returns the number of frames actually queued
+int orbisAudioPushSamples(unsigned int channel, const void *buf, unsigned int n)
+{
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
+    OrbisAudioRing    *ring;
+    unsigned int head, tail, space, mask, first;
+
+    if(!ch || !buf) return -1;
+    ring = __atomic_load_n(&ch->ring, __ATOMIC_ACQUIRE);
+    if(!ring) return -1;
+
+    head  = ring->head;
+    tail  = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    space = ring->frames - (head - tail);
+    mask  = ring->frames - 1;
+
+    if(n > space) n = space;
+    first = ring->frames - (head & mask);
+    if(first > n) first = n;
+
+    memcpy(ring->data + (head & mask) * ring->frameSize, buf, first * ring->frameSize * sizeof(short));
+    memcpy(ring->data, (const short *)buf + first * ring->frameSize, (n - first) * ring->frameSize * sizeof(short));
+
+    __atomic_store_n(&ring->head, head + n, __ATOMIC_RELEASE);
+
+    return n;
+}
+
+int orbisAudioGetRingFill(unsigned int channel)
+{
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
+    OrbisAudioRing    *ring;
+
+    if(!ch) return -1;
+    ring = __atomic_load_n(&ch->ring, __ATOMIC_ACQUIRE);
+    if(!ring) return -1;
+
+    return orbisAudioRingFill(ring);
+}
+
+int orbisAudioGetRingFree(unsigned int channel)
+{
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
+    OrbisAudioRing    *ring;
+
+    if(!ch) return -1;
+    ring = __atomic_load_n(&ch->ring, __ATOMIC_ACQUIRE);
+    if(!ring) return -1;
+
+    return ring->frames - orbisAudioRingFill(ring);
+}
@@ -0,0 +1,621 @@
+/*
+#  ____   ____    ____         ___ ____   ____ _     _
+# |    |  ____>   ____>  |    |        | <____  \   /
+# |____| |    \   ____>  | ___|    ____| <____   \_/    ORBISDEV Open Source Project.
+#------------------------------------------------------------------------------------
+# Copyright 2010-2020, orbisdev - http://orbisdev.github.io
+# Licenced under the MIT license
+# Review README & LICENSE files for further details.
+*/
+
+/*
+ * File streaming: one read ahead thread serves the streams of every channel.
+ * It reads wav data in large sequential chunks, with pread or from a mapping
+ * of the file, into a ring of chunks in the channel's arena region. The
+ * channel thread only copies from there, it never touches a file.
+ *
+ * The game thread parses the header when it opens or queues a file and
+ * hands it over through a small command queue, the read ahead thread owns
+ * it from then on. Every open starts a new session; chunks are tagged with
+ * the session they were read for, so the channel thread drops whatever was
+ * left of the previous file without the two threads ever locking.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "orbisAudioInternal.h"
+
+
+#define ORBISAUDIO_STREAM_COMMANDS	8
+#define ORBISAUDIO_STREAM_IDLE_US	2000
+
+enum
+{
+    ORBISAUDIO_STREAM_CMD_OPEN,
+    ORBISAUDIO_STREAM_CMD_QUEUE,
+    ORBISAUDIO_STREAM_CMD_LOOP,
+    ORBISAUDIO_STREAM_CMD_CLOSE,
+};
+
+typedef struct OrbisAudioStreamFile
+{
+    int            fd;          // -1 once mapped
+    const uint8_t *map;
+    size_t         mapBytes;
+    uint64_t       dataOffset;
+    unsigned int   frames;
+    unsigned int   pos;         // next frame read
+    unsigned char  open;
+    unsigned char  loop;
+    unsigned int   loopStart;
+    unsigned int   loopEnd;
+} OrbisAudioStreamFile;
+
+typedef struct OrbisAudioStreamCmd
+{
+    int                  type;
+    uint32_t             session;
+    OrbisAudioStreamFile file;
+} OrbisAudioStreamCmd;
+
+typedef struct OrbisAudioStreamChunk
+{
+    uint8_t     *data;
+    unsigned int frames;
+    uint32_t     session;
+} OrbisAudioStreamChunk;
+
+struct OrbisAudioStream
+{
+    unsigned int frameBytes;    // of the channel's source format
+
+    // game thread side
+    uint32_t     session;       // also read by the channel thread
+    OrbisAudioStreamCmd cmds[ORBISAUDIO_STREAM_COMMANDS];
+    unsigned int cmdHead;
+
+    // read ahead thread side
+    unsigned int cmdTail;
+    uint32_t     workSession;
+    OrbisAudioStreamFile cur, next;
+    uint32_t     endedSession;  // no more data will come for it
+    uint32_t     readySession;  // its first chunks are queued
+
+    // chunk ring, filled by the read ahead thread, drained by the channel thread
+    OrbisAudioStreamChunk chunks[ORBISAUDIO_STREAM_CHUNKS];
+    unsigned int offset;        // frames already taken from the chunk at tail
+    unsigned int head __attribute__((aligned(64)));
+    unsigned int tail __attribute__((aligned(64)));
+};
+
+static struct
+{
+    pthread_t    thread;
+    int          running;
+    unsigned int stop;
+    uint64_t     passes;
+} orbisAudioStreamWorker;
+
+
+static OrbisAudioStream *orbisAudioGetStream(unsigned int channel)
+{
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
+
+    if(!ch || channel >= ORBISAUDIO_CHANNELS) return NULL;
+    return __atomic_load_n(&ch->stream, __ATOMIC_ACQUIRE);
+}
+
+static void orbisAudioStreamCloseFile(OrbisAudioStreamFile *f)
+{
+    if(!f->open) return;
+    if(f->map) munmap((void *)f->map, f->mapBytes);
+    if(f->fd >= 0) close(f->fd);
+    f->open = 0;
+}
+
+static uint32_t orbisAudioStreamLe32(const uint8_t *p) { return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24; }
+static uint16_t orbisAudioStreamLe16(const uint8_t *p) { return p[0] | p[1] << 8; }
+
+/*
+ * Game thread: open a wav file and find its data, which must already be in
+ * the channel's source format and rate, and its loop. Only the header is
+ * read here.
+ */
+static int orbisAudioStreamOpenFile(OrbisAudioChannel *ch, const char *path, int flags, OrbisAudioStreamFile *f)
+{
+    unsigned int frequency = ch->sourceFrequency ? ch->sourceFrequency : ch->frequency;
+    int          isFloat   = orbisAudioFormatIsFloat(ch->format);
+    uint8_t      hdr[40];
+    uint64_t     pos = 12, dataBytes = 0;
+    unsigned int tag = 0, channels = 0, rate = 0, bits = 0;
+    struct stat  st;
+
+    memset(f, 0, sizeof(OrbisAudioStreamFile));
+    f->fd = open(path, O_RDONLY);
+    if(f->fd < 0) { fprintf(ERROR, "[orbisAudio] can't open stream %s\n", path); return -1; }
+
+    if(fstat(f->fd, &st) || pread(f->fd, hdr, 12, 0) != 12 || memcmp(hdr, "RIFF", 4) || memcmp(hdr + 8, "WAVE", 4))
+    {
+        fprintf(ERROR, "[orbisAudio] %s is not a wav file\n", path);
+        close(f->fd);
+        return -1;
+    }
+
+    while(pos + 8 <= (uint64_t)st.st_size && pread(f->fd, hdr, 8, pos) == 8)
+    {
+        uint32_t bytes = orbisAudioStreamLe32(hdr + 4);
+
+        if(!memcmp(hdr, "fmt ", 4))
+        {
+            uint8_t fmt[40];
+            ssize_t n = pread(f->fd, fmt, bytes < sizeof(fmt) ? bytes : sizeof(fmt), pos + 8);
+
+            if(n < 16) break;
+            tag      = orbisAudioStreamLe16(fmt);
+            channels = orbisAudioStreamLe16(fmt + 2);
+            rate     = orbisAudioStreamLe32(fmt + 4);
+            bits     = orbisAudioStreamLe16(fmt + 14);
+            if(tag == 0xfffe && n >= 26) tag = orbisAudioStreamLe16(fmt + 24);
+        }
+        else if(!memcmp(hdr, "smpl", 4) && bytes >= 36 + 24)
+        {
+            // first loop, its end is inclusive
+            uint8_t smpl[36 + 24];
+
+            if(pread(f->fd, smpl, sizeof(smpl), pos + 8) == sizeof(smpl) && orbisAudioStreamLe32(smpl + 28) > 0)
+            {
+                f->loopStart = orbisAudioStreamLe32(smpl + 36 + 8);
+                f->loopEnd   = orbisAudioStreamLe32(smpl + 36 + 12) + 1;
+            }
+        }
+        else if(!memcmp(hdr, "data", 4))
+        {
+            f->dataOffset = pos + 8;
+            dataBytes     = bytes;
+        }
+        pos += 8 + (uint64_t)bytes + (bytes & 1);
+    }
+    if(dataBytes > (uint64_t)st.st_size - f->dataOffset) dataBytes = st.st_size - f->dataOffset;
+
+    if(!f->dataOffset || channels != orbisAudioFormatChannels(ch->format) || rate != frequency
+    || (isFloat ? !(tag == 3 && bits == 32) : !(tag == 1 && bits == 16)))
+    {
+        fprintf(ERROR, "[orbisAudio] stream %s is not %u channel %s at %u Hz\n", path, orbisAudioFormatChannels(ch->format), isFloat ? "float" : "s16", frequency);
+        close(f->fd);
+        return -1;
+    }
+    f->frames = dataBytes / orbisAudioFormatFrameBytes(ch->format);
+
+    // the smpl loop when there is a sane one, the whole file otherwise
+    if(!f->loopEnd || f->loopEnd > f->frames || f->loopStart >= f->loopEnd)
+    {
+        f->loopStart = 0;
+        f->loopEnd   = f->frames;
+    }
+    f->loop = (flags & ORBISAUDIO_STREAM_LOOP) && f->frames;
+
+    if(flags & ORBISAUDIO_STREAM_MMAP)
+    {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, f->fd, 0);
+
+        if(map != MAP_FAILED)
+        {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            f->map      = map;
+            f->mapBytes = st.st_size;
+            close(f->fd);
+            f->fd = -1;
+        }
+        else fprintf(DEBUG, "[orbisAudio] can't map stream %s, reading it instead\n", path);
+    }
+#if !defined (__PS4__)
+    if(!f->map) posix_fadvise(f->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    f->open = 1;
+
+    return 0;
+}
+
+static int orbisAudioStreamPush(OrbisAudioStream *s, const OrbisAudioStreamCmd *cmd)
+{
+    unsigned int head = s->cmdHead;
+
+    if(head - __atomic_load_n(&s->cmdTail, __ATOMIC_ACQUIRE) >= ORBISAUDIO_STREAM_COMMANDS) return -1;
+
+    s->cmds[head % ORBISAUDIO_STREAM_COMMANDS] = *cmd;
+    __atomic_store_n(&s->cmdHead, head + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+
+// read ahead thread: frames from the file's current position, fewer on a read error
+static unsigned int orbisAudioStreamRead(OrbisAudioStream *s, OrbisAudioStreamFile *f, uint8_t *dst, unsigned int frames)
+{
+    size_t   bytes  = (size_t)frames * s->frameBytes, done = 0;
+    uint64_t offset = f->dataOffset + (uint64_t)f->pos * s->frameBytes;
+
+    if(f->map)
+    {
+        memcpy(dst, f->map + offset, bytes);
+        return frames;
+    }
+    while(done < bytes)
+    {
+        ssize_t n = pread(f->fd, dst + done, bytes - done, offset + done);
+        if(n <= 0) break;
+        done += n;
+    }
+    return done / s->frameBytes;
+}
+
+static void orbisAudioStreamCommands(OrbisAudioStream *s)
+{
+    unsigned int head = __atomic_load_n(&s->cmdHead, __ATOMIC_ACQUIRE);
+    unsigned int tail = s->cmdTail;
+
+    for(; tail != head; tail++)
+    {
+        OrbisAudioStreamCmd  *cmd = &s->cmds[tail % ORBISAUDIO_STREAM_COMMANDS];
+        OrbisAudioStreamFile *f;
+
+        switch(cmd->type)
+        {
+            case ORBISAUDIO_STREAM_CMD_OPEN:
+                orbisAudioStreamCloseFile(&s->cur);
+                orbisAudioStreamCloseFile(&s->next);
+                s->cur         = cmd->file;
+                s->workSession = cmd->session;
+                break;
+            case ORBISAUDIO_STREAM_CMD_QUEUE:
+                orbisAudioStreamCloseFile(&s->next);
+                s->next = cmd->file;
+                break;
+            case ORBISAUDIO_STREAM_CMD_LOOP:
+                // loops the file opened or queued last
+                f = s->next.open ? &s->next : &s->cur;
+                if(!f->open) break;
+                f->loop      = cmd->file.loop;
+                f->loopEnd   = (cmd->file.loopEnd && cmd->file.loopEnd <= f->frames) ? cmd->file.loopEnd : f->frames;
+                f->loopStart = cmd->file.loopStart < f->loopEnd ? cmd->file.loopStart : 0;
+                break;
+            case ORBISAUDIO_STREAM_CMD_CLOSE:
+                orbisAudioStreamCloseFile(&s->cur);
+                orbisAudioStreamCloseFile(&s->next);
+                s->workSession = cmd->session;
+                break;
+        }
+    }
+    __atomic_store_n(&s->cmdTail, tail, __ATOMIC_RELEASE);
+}
+
+/*
+ * Fill every free chunk. A chunk runs on across the loop end and into the
+ * queued file, so loops and file changes land in the middle of a block
+ * without a gap.
+ */
+static void orbisAudioStreamFill(OrbisAudioStream *s)
+{
+    unsigned int head = s->head;
+    unsigned int cap  = ORBISAUDIO_STREAM_CHUNK_BYTES / s->frameBytes;
+    int          queued = 0;
+
+    // queued after the current file was already all read
+    if(!s->cur.open && s->next.open)
+    {
+        s->cur = s->next;
+        s->next.open = 0;
+    }
+
+    while(s->cur.open && head - __atomic_load_n(&s->tail, __ATOMIC_ACQUIRE) < ORBISAUDIO_STREAM_CHUNKS)
+    {
+        OrbisAudioStreamChunk *c = &s->chunks[head % ORBISAUDIO_STREAM_CHUNKS];
+        unsigned int got = 0;
+
+        while(got < cap && s->cur.open)
+        {
+            OrbisAudioStreamFile *f   = &s->cur;
+            unsigned int          end = f->loop ? f->loopEnd : f->frames;
+            unsigned int          n, r;
+
+            if(f->pos >= end)
+            {
+                if(f->loop) { f->pos = f->loopStart; continue; }
+
+                orbisAudioStreamCloseFile(f);
+                if(s->next.open)
+                {
+                    s->cur = s->next;
+                    s->next.open = 0;
+                }
+                continue;
+            }
+
+            n = end - f->pos < cap - got ? end - f->pos : cap - got;
+            r = orbisAudioStreamRead(s, f, c->data + (size_t)got * s->frameBytes, n);
+            if(r < n)
+            {
+                fprintf(ERROR, "[orbisAudio] stream read error, ending it at frame %u\n", f->pos + r);
+                f->frames = f->pos + r;
+                f->loop   = 0;
+            }
+            f->pos += r;
+            got    += r;
+        }
+        if(!got) break;
+
+        c->frames  = got;
+        c->session = s->workSession;
+        __atomic_store_n(&s->head, ++head, __ATOMIC_RELEASE);
+        queued = 1;
+    }
+
+    // ready once a chunk of the session is queued, a ring still full of the old one's is not;
+    // or once it has ended and none ever will be
+    if(!s->cur.open) __atomic_store_n(&s->endedSession, s->workSession, __ATOMIC_RELEASE);
+    if(queued || !s->cur.open) __atomic_store_n(&s->readySession, s->workSession, __ATOMIC_RELEASE);
+}
+
+// one pass over every stream: take the commands, read ahead into the free chunks
+void orbisAudioStreamPump(void)
+{
+    for(int i=0; i<ORBISAUDIO_CHANNELS; i++)
+    {
+        OrbisAudioChannel *ch = orbisAudioConf->channels[i];
+        OrbisAudioStream  *s  = ch ? __atomic_load_n(&ch->stream, __ATOMIC_ACQUIRE) : NULL;
+
+        if(!s) continue;
+        orbisAudioStreamCommands(s);
+        orbisAudioStreamFill(s);
+    }
+}
+
+static void *orbisAudioStreamThread(void *argp)
+{
+    fprintf(DEBUG, "[orbisAudio] orbisAudioStreamThread reading ahead\n");
+
+    while(!__atomic_load_n(&orbisAudioStreamWorker.stop, __ATOMIC_ACQUIRE))
+    {
+        orbisAudioStreamPump();
+        __atomic_store_n(&orbisAudioStreamWorker.passes, orbisAudioStreamWorker.passes + 1, __ATOMIC_RELEASE);
+        sceKernelUsleep(ORBISAUDIO_STREAM_IDLE_US);
+    }
+
+    // every file handed over is ours to close, including those still in the queues
+    for(int i=0; i<ORBISAUDIO_CHANNELS; i++)
+    {
+        OrbisAudioChannel *ch = orbisAudioConf->channels[i];
+        OrbisAudioStream  *s  = ch ? ch->stream : NULL;
+
+        if(!s) continue;
+        for(unsigned int t=s->cmdTail; t!=s->cmdHead; t++)
+        {
+            OrbisAudioStreamCmd *cmd = &s->cmds[t % ORBISAUDIO_STREAM_COMMANDS];
+            if(cmd->type == ORBISAUDIO_STREAM_CMD_OPEN || cmd->type == ORBISAUDIO_STREAM_CMD_QUEUE) orbisAudioStreamCloseFile(&cmd->file);
+        }
+        s->cmdTail = s->cmdHead;
+        orbisAudioStreamCloseFile(&s->cur);
+        orbisAudioStreamCloseFile(&s->next);
+        s->endedSession = s->workSession = s->session;
+    }
+    fprintf(DEBUG, "[orbisAudio] orbisAudioStreamThread exit...\n");
+
+    return NULL;
+}
+
+// one read ahead thread for all streams, started with the first one; offline, orbisAudioRenderOffline reads ahead instead
+static int orbisAudioStreamStart(void)
+{
+    int ret;
+
+    if(orbisAudioStreamWorker.running || orbisAudioBackendIsOffline()) return 0;
+
+    orbisAudioStreamWorker.stop = 0;
+    ret = pthread_create(&orbisAudioStreamWorker.thread, NULL, orbisAudioStreamThread, NULL);
+    if(ret) { fprintf(ERROR, "[orbisAudio] stream thread could not create error: 0x%08X\n", ret); return -1; }
+    orbisAudioStreamWorker.running = 1;
+
+    return 0;
+}
+
+// called by orbisAudioFinish before the channels go
+void orbisAudioStreamShutdown(void)
+{
+    if(!orbisAudioStreamWorker.running) return;
+
+    __atomic_store_n(&orbisAudioStreamWorker.stop, 1, __ATOMIC_RELEASE);
+    pthread_join(orbisAudioStreamWorker.thread, NULL);
+    orbisAudioStreamWorker.running = 0;
+}
+
+// until the read ahead thread has made a whole pass without the stream
+static void orbisAudioStreamSync(void)
+{
+    uint64_t passes = __atomic_load_n(&orbisAudioStreamWorker.passes, __ATOMIC_ACQUIRE);
+
+    while(orbisAudioStreamWorker.running && __atomic_load_n(&orbisAudioStreamWorker.passes, __ATOMIC_ACQUIRE) < passes + 2)
+        sceKernelUsleep(1000);
+}
+
+
+/*
+ * Play path from the start of its data on the channel, replacing whatever
+ * the stream played before. Returns once the first chunks are read, so the
+ * stream starts without an underrun. Flags are ORBISAUDIO_STREAM_*.
+ */
+int orbisAudioStreamOpen(unsigned int channel, const char *path, int flags)
+{
+    OrbisAudioChannel  *ch = orbisAudioGetChannel(channel);
+    OrbisAudioStream   *s;
+    OrbisAudioStreamCmd cmd;
+    uint64_t            start;
+
+    if(!ch || channel >= ORBISAUDIO_CHANNELS || !path) return -1;
+    if(ch->orbisaudiochannel_initialized != 1) { fprintf(ERROR, "[orbisAudio] orbisAudioStreamOpen channel %u is not initialized\n", channel); return -1; }
+    if(ch->format == ORBISAUDIO_FORMAT_FLOAT_STEREO_PLANAR) { fprintf(ERROR, "[orbisAudio] stream for audio channel %u needs interleaved samples\n", channel); return -1; }
+
+    s = ch->stream;
+    if(!s)
+    {
+        // from the channel's arena region, released with the channel
+        s = (OrbisAudioStream *)orbisAudioArenaAlloc(channel, sizeof(OrbisAudioStream));
+        if(!s) return -1;
+        memset(s, 0, sizeof(OrbisAudioStream));
+        s->frameBytes = orbisAudioFormatFrameBytes(ch->format);
+        for(int i=0; i<ORBISAUDIO_STREAM_CHUNKS; i++)
+        {
+            s->chunks[i].data = (uint8_t *)orbisAudioArenaAlloc(channel, ORBISAUDIO_STREAM_CHUNK_BYTES);
+            if(!s->chunks[i].data) return -1;
+        }
+        __atomic_store_n(&ch->stream, s, __ATOMIC_RELEASE);
+        fprintf(DEBUG, "[orbisAudio] stream for audio channel %u created (%u x %u bytes)\n", channel, ORBISAUDIO_STREAM_CHUNKS, ORBISAUDIO_STREAM_CHUNK_BYTES);
+    }
+    if(orbisAudioStreamStart()) return -1;
+
+    memset(&cmd, 0, sizeof(cmd));
+    if(orbisAudioStreamOpenFile(ch, path, flags, &cmd.file)) return -1;
+    cmd.type    = ORBISAUDIO_STREAM_CMD_OPEN;
+    cmd.session = s->session + 1;
+    if(orbisAudioStreamPush(s, &cmd)) { orbisAudioStreamCloseFile(&cmd.file); return -1; }
+    __atomic_store_n(&s->session, cmd.session, __ATOMIC_RELEASE);
+
+    start = orbisAudioGetTimeUs();
+    if(!orbisAudioStreamWorker.running) orbisAudioStreamPump();
+    while(__atomic_load_n(&s->readySession, __ATOMIC_ACQUIRE) != cmd.session)
+    {
+        if(orbisAudioGetTimeUs() - start > 1000000) { fprintf(DEBUG, "[orbisAudio] stream %s slow to start\n", path); break; }
+        sceKernelUsleep(1000);
+    }
+    fprintf(DEBUG, "[orbisAudio] streaming %s on audio channel %u\n", path, channel);
+
+    return 0;
+}
+
+// play path straight after the current file ends, or its loop is turned off, replacing a file queued before
+int orbisAudioStreamQueue(unsigned int channel, const char *path, int flags)
+{
+    OrbisAudioChannel  *ch = orbisAudioGetChannel(channel);
+    OrbisAudioStream   *s  = orbisAudioGetStream(channel);
+    OrbisAudioStreamCmd cmd;
+
+    if(!s || !path) return -1;
+
+    memset(&cmd, 0, sizeof(cmd));
+    if(orbisAudioStreamOpenFile(ch, path, flags, &cmd.file)) return -1;
+    cmd.type    = ORBISAUDIO_STREAM_CMD_QUEUE;
+    cmd.session = s->session;
+    if(orbisAudioStreamPush(s, &cmd)) { orbisAudioStreamCloseFile(&cmd.file); return -1; }
+
+    return 0;
+}
+
+/*
+ * Loop frames start to end (0 for the end of the file) of the file opened or
+ * queued last, or stop looping it, while it is still being read. Files
+ * opened with ORBISAUDIO_STREAM_LOOP loop from the start.
+ */
+int orbisAudioStreamSetLoop(unsigned int channel, int loop, unsigned int start, unsigned int end)
+{
+    OrbisAudioStream   *s = orbisAudioGetStream(channel);
+    OrbisAudioStreamCmd cmd;
+
+    if(!s) return -1;
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.type           = ORBISAUDIO_STREAM_CMD_LOOP;
+    cmd.session        = s->session;
+    cmd.file.loop      = loop ? 1 : 0;
+    cmd.file.loopStart = start;
+    cmd.file.loopEnd   = end;
+
+    return orbisAudioStreamPush(s, &cmd);
+}
+
+// stop at once, what was read ahead is dropped
+int orbisAudioStreamClose(unsigned int channel)
+{
+    OrbisAudioStream   *s = orbisAudioGetStream(channel);
+    OrbisAudioStreamCmd cmd;
+
+    if(!s) return -1;
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.type    = ORBISAUDIO_STREAM_CMD_CLOSE;
+    cmd.session = s->session + 1;
+    if(orbisAudioStreamPush(s, &cmd)) return -1;
+    __atomic_store_n(&s->session, cmd.session, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+// 1 until the last file has played out, 0 once it has or the stream was closed
+int orbisAudioStreamIsPlaying(unsigned int channel)
+{
+    OrbisAudioStream *s = orbisAudioGetStream(channel);
+    uint32_t          session;
+
+    if(!s) return 0;
+    session = __atomic_load_n(&s->session, __ATOMIC_ACQUIRE);
+    if(__atomic_load_n(&s->endedSession, __ATOMIC_ACQUIRE) != session) return 1;
+
+    // ended: the channel thread may still be playing the last chunks
+    for(unsigned int t=__atomic_load_n(&s->tail, __ATOMIC_ACQUIRE); t!=__atomic_load_n(&s->head, __ATOMIC_ACQUIRE); t++)
+        if(s->chunks[t % ORBISAUDIO_STREAM_CHUNKS].session == session) return 1;
+
+    return 0;
+}
+
+/*
+ * Channel thread: copy up to frames frames, returns how many. Chunks left
+ * from an earlier session are dropped. starved is set when the stream is
+ * short of data it should have had.
+ */
+unsigned int orbisAudioStreamPop(OrbisAudioStream *s, void *dst, unsigned int frames, int *starved)
+{
+    uint32_t     session = __atomic_load_n(&s->session, __ATOMIC_ACQUIRE);
+    unsigned int tail    = s->tail;
+    unsigned int n       = 0;
+
+    while(n < frames && tail != __atomic_load_n(&s->head, __ATOMIC_ACQUIRE))
+    {
+        OrbisAudioStreamChunk *c = &s->chunks[tail % ORBISAUDIO_STREAM_CHUNKS];
+        unsigned int k = c->frames - s->offset;
+
+        if(c->session == session)
+        {
+            if(k > frames - n) k = frames - n;
+            memcpy((uint8_t *)dst + (size_t)n * s->frameBytes, c->data + (size_t)s->offset * s->frameBytes, (size_t)k * s->frameBytes);
+            n         += k;
+            s->offset += k;
+            if(s->offset < c->frames) break;
+        }
+        s->offset = 0;
+        __atomic_store_n(&s->tail, ++tail, __ATOMIC_RELEASE);
+    }
+    *starved = n < frames && __atomic_load_n(&s->endedSession, __ATOMIC_ACQUIRE) != session;
+
+    return n;
+}
+
+// channel finish: close the files and make sure the read ahead thread is done with the stream
+void orbisAudioStreamDetach(OrbisAudioChannel *ch)
+{
+    OrbisAudioStream *s = ch->stream;
+    uint64_t          start = orbisAudioGetTimeUs();
+
+    if(!s) return;
+    if(orbisAudioStreamWorker.running && orbisAudioStreamClose(ch->index) == 0)
+    {
+        while(__atomic_load_n(&s->endedSession, __ATOMIC_ACQUIRE) != s->session && orbisAudioGetTimeUs() - start < 1000000)
+            sceKernelUsleep(1000);
+    }
+    // offline there is no read ahead thread, close the files here
+    else if(orbisAudioBackendIsOffline() && orbisAudioStreamClose(ch->index) == 0) orbisAudioStreamPump();
+    __atomic_store_n(&ch->stream, NULL, __ATOMIC_RELEASE);
+    orbisAudioStreamSync();
+}
@@ -0,0 +1,348 @@
+/*
+#  ____   ____    ____         ___ ____   ____ _     _
+# |    |  ____>   ____>  |    |        | <____  \   /
+# |____| |    \   ____>  | ___|    ____| <____   \_/    ORBISDEV Open Source Project.
+#------------------------------------------------------------------------------------
+# Copyright 2010-2020, orbisdev - http://orbisdev.github.io
+# Licenced under the MIT license
+# Review README & LICENSE files for further details.
+*/
+
+/*
+ * Output tap: records what a channel submits, for replays and bug reports.
+ * Every tap owns a pool of blocks the size of its channel's port blocks, in
+ * two single producer / single consumer rings: free blocks going to the
+ * audio thread, recorded ones going to the writer thread.
+ *
+ * Blocks the library renders itself are page flipped: once the port has
+ * taken a block, the queue slot it came from gets a free pool block and the
+ * rendered one goes to the writer as it is. The port may still be reading it,
+ * but only until the next submit returns, and a block only comes back from
+ * the writer through the free ring after that. Caller driven channels give
+ * their own buffers, those are copied on the caller's thread. When the free
+ * ring is empty the block is counted as dropped, the audio thread never
+ * waits on the writer.
+ *
+ * One writer thread serves every tap, started with the first one.
+ */
+
+#include <string.h>
+#include <pthread.h>
+
+#include "orbisAudioInternal.h"
+
+
+#define ORBISAUDIO_TAP_IDLE_US		2000
+
+struct OrbisAudioTap
+{
+    unsigned int blocks;        // pool size, power of two
+    size_t       blockBytes;
+    unsigned int frames;
+    unsigned int channels;
+    unsigned int frequency;
+
+    // session, set by the game thread while nothing records
+    FILE              *fp;
+    uint32_t           dataBytes;
+    int                failed;  // write error, the rest of the session is dropped
+    OrbisAudioTapSink  sink;
+    void              *userData;
+    unsigned int       recording;   // the audio thread takes blocks while set
+    unsigned int       busy;        // the audio thread is inside orbisAudioTapSubmit
+    unsigned int       closing;     // set by the game thread, cleared by the writer once the session is finished
+
+    short      **full;          // recorded, audio thread to writer
+    short      **free;          // free, writer to audio thread
+    unsigned int fullHead __attribute__((aligned(64)));
+    unsigned int fullTail __attribute__((aligned(64)));
+    unsigned int freeHead __attribute__((aligned(64)));
+    unsigned int freeTail __attribute__((aligned(64)));
+};
+
+static struct
+{
+    pthread_t    thread;
+    int          running;
+    unsigned int stop;
+    uint64_t     passes;
+} orbisAudioTapWorker;
+
+
+static unsigned int orbisAudioTapRoundUp(unsigned int v)
+{
+    unsigned int p = 1;
+    while(p < v) p <<= 1;
+    return p;
+}
+
+/*
+ * Audio thread, after a block went to the port. slot is the queue slot buf
+ * came from when the library owns it and may swap it for a free block, NULL
+ * to copy buf instead.
+ */
+void orbisAudioTapSubmit(OrbisAudioChannel *ch, short **slot, const short *buf)
+{
+    OrbisAudioTap *tap = __atomic_load_n(&ch->tap, __ATOMIC_ACQUIRE);
+    unsigned int   mask, tail, head;
+    short         *blk;
+
+    if(!tap || !__atomic_load_n(&tap->recording, __ATOMIC_RELAXED)) return;
+
+    // pairs with orbisAudioTapClose: either it sees busy or we see recording cleared
+    __atomic_store_n(&tap->busy, 1, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&tap->recording, __ATOMIC_SEQ_CST))
+    {
+        mask = tap->blocks - 1;
+        tail = tap->freeTail;
+        if(tail == __atomic_load_n(&tap->freeHead, __ATOMIC_ACQUIRE)) orbisAudioStatAdd(&ch->stats.tapDropped, 1);
+        else
+        {
+            blk = tap->free[tail & mask];
+            __atomic_store_n(&tap->freeTail, tail + 1, __ATOMIC_RELEASE);
+
+            if(slot)
+            {
+                short *played = *slot;
+                *slot = blk;
+                blk   = played;
+            }
+            else memcpy(blk, buf, tap->blockBytes);
+
+            head = tap->fullHead;
+            tap->full[head & mask] = blk;
+            __atomic_store_n(&tap->fullHead, head + 1, __ATOMIC_RELEASE);
+            orbisAudioStatAdd(&ch->stats.tapBlocks, 1);
+        }
+    }
+    __atomic_store_n(&tap->busy, 0, __ATOMIC_RELEASE);
+}
+
+// writer: hand every recorded block over and give it back to the audio thread
+static int orbisAudioTapDrain(OrbisAudioTap *tap)
+{
+    unsigned int mask = tap->blocks - 1;
+    unsigned int tail = tap->fullTail;
+    int          n    = 0;
+
+    while(tail != __atomic_load_n(&tap->fullHead, __ATOMIC_ACQUIRE))
+    {
+        short       *blk  = tap->full[tail & mask];
+        unsigned int head = tap->freeHead;
+
+        if(tap->sink) tap->sink(blk, tap->frames, tap->channels, tap->userData);
+        else if(!tap->failed)
+        {
+            if(fwrite(blk, 1, tap->blockBytes, tap->fp) != tap->blockBytes)
+            {
+                fprintf(ERROR, "[orbisAudio] tap write error, the rest of the recording is lost\n");
+                tap->failed = 1;
+            }
+            else tap->dataBytes += tap->blockBytes;
+        }
+
+        __atomic_store_n(&tap->fullTail, ++tail, __ATOMIC_RELEASE);
+        tap->free[head & mask] = blk;
+        __atomic_store_n(&tap->freeHead, head + 1, __ATOMIC_RELEASE);
+        n++;
+    }
+    return n;
+}
+
+// writer, or the game thread when there is no writer: everything recorded is out, complete the file
+static void orbisAudioTapFinishSession(OrbisAudioTap *tap)
+{
+    orbisAudioTapDrain(tap);
+    if(tap->fp)
+    {
+        orbisAudioWavWriteHeader(tap->fp, tap->channels, tap->frequency, tap->dataBytes);
+        fclose(tap->fp);
+        tap->fp = NULL;
+    }
+    tap->sink = NULL;
+    __atomic_store_n(&tap->closing, 0, __ATOMIC_RELEASE);
+}
+
+static void *orbisAudioTapThread(void *argp)
+{
+    fprintf(DEBUG, "[orbisAudio] orbisAudioTapThread recording\n");
+
+    while(!__atomic_load_n(&orbisAudioTapWorker.stop, __ATOMIC_ACQUIRE))
+    {
+        int written = 0;
+
+        for(int i=0; i<=ORBISAUDIO_CHANNELS; i++)
+        {
+            OrbisAudioChannel *ch  = orbisAudioGetChannel(i < ORBISAUDIO_CHANNELS ? i : ORBISAUDIO_CHANNEL_MASTER);
+            OrbisAudioTap     *tap = ch ? __atomic_load_n(&ch->tap, __ATOMIC_ACQUIRE) : NULL;
+
+            if(!tap) continue;
+            if(__atomic_load_n(&tap->closing, __ATOMIC_ACQUIRE)) orbisAudioTapFinishSession(tap);
+            else written += orbisAudioTapDrain(tap);
+        }
+        __atomic_store_n(&orbisAudioTapWorker.passes, orbisAudioTapWorker.passes + 1, __ATOMIC_RELEASE);
+        if(!written) sceKernelUsleep(ORBISAUDIO_TAP_IDLE_US);
+    }
+    fprintf(DEBUG, "[orbisAudio] orbisAudioTapThread exit...\n");
+
+    return NULL;
+}
+
+static int orbisAudioTapStart(void)
+{
+    int ret;
+
+    if(orbisAudioTapWorker.running) return 0;
+
+    orbisAudioTapWorker.stop = 0;
+    ret = pthread_create(&orbisAudioTapWorker.thread, NULL, orbisAudioTapThread, NULL);
+    if(ret) { fprintf(ERROR, "[orbisAudio] tap thread could not create error: 0x%08X\n", ret); return -1; }
+    orbisAudioTapWorker.running = 1;
+
+    return 0;
+}
+
+// until the writer has made a whole pass without the tap
+static void orbisAudioTapSync(void)
+{
+    uint64_t passes = __atomic_load_n(&orbisAudioTapWorker.passes, __ATOMIC_ACQUIRE);
+
+    while(orbisAudioTapWorker.running && __atomic_load_n(&orbisAudioTapWorker.passes, __ATOMIC_ACQUIRE) < passes + 2)
+        sceKernelUsleep(1000);
+}
+
+// the channel's tap, allocated from its arena region on the first open and kept until the channel is finished
+static OrbisAudioTap *orbisAudioTapGet(OrbisAudioChannel *ch, unsigned int channel, unsigned int blocks)
+{
+    OrbisAudioTap *tap = ch->tap;
+
+    if(tap) return tap;
+
+    tap = (OrbisAudioTap *)orbisAudioArenaAlloc(channel, sizeof(OrbisAudioTap));
+    if(!tap) return NULL;
+    memset(tap, 0, sizeof(OrbisAudioTap));
+
+    tap->blocks     = orbisAudioTapRoundUp(blocks ? blocks : ORBISAUDIO_TAP_BLOCKS);
+    tap->frames     = ch->samples[0];
+    tap->channels   = ch->stereo ? 2 : 1;
+    tap->frequency  = ch->frequency ? ch->frequency : ORBISAUDIO_OUTPUT_FREQUENCY;
+    tap->blockBytes = (size_t)tap->frames * tap->channels * sizeof(short);
+    tap->full       = (short **)orbisAudioArenaAlloc(channel, tap->blocks * sizeof(short *));
+    tap->free       = (short **)orbisAudioArenaAlloc(channel, tap->blocks * sizeof(short *));
+    if(!tap->full || !tap->free) return NULL;
+
+    for(unsigned int i=0; i<tap->blocks; i++)
+    {
+        tap->free[i] = (short *)orbisAudioArenaAlloc(channel, tap->blockBytes);
+        if(!tap->free[i]) return NULL;
+    }
+    tap->freeHead = tap->blocks;
+
+    __atomic_store_n(&ch->tap, tap, __ATOMIC_RELEASE);
+    fprintf(DEBUG, "[orbisAudio] tap for audio channel %u created (%u x %zu bytes)\n", channel, tap->blocks, tap->blockBytes);
+
+    return tap;
+}
+
+static int orbisAudioTapBegin(unsigned int channel, FILE *fp, OrbisAudioTapSink sink, void *userdata, unsigned int blocks)
+{
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
+    OrbisAudioTap     *tap;
+
+    if(!ch || __atomic_load_n(&ch->orbisaudiochannel_initialized, __ATOMIC_ACQUIRE) != 1)
+    {
+        fprintf(ERROR, "[orbisAudio] orbisAudioTapOpen channel %u is not initialized\n", channel); return -1;
+    }
+    if(ch->tap && (ch->tap->recording || ch->tap->closing))
+    {
+        fprintf(DEBUG, "[orbisAudio] tap for audio channel %u already recording\n", channel); return -1;
+    }
+
+    tap = orbisAudioTapGet(ch, channel, blocks);
+    if(!tap || orbisAudioTapStart()) return -1;
+
+    tap->fp        = fp;
+    tap->dataBytes = 0;
+    tap->failed    = 0;
+    tap->sink      = sink;
+    tap->userData  = userdata;
+    if(fp) orbisAudioWavWriteHeader(fp, tap->channels, tap->frequency, 0);
+
+    __atomic_store_n(&tap->recording, 1, __ATOMIC_SEQ_CST);
+
+    return 0;
+}
+
+// record channel (or ORBISAUDIO_CHANNEL_MASTER) to a 16 bit wav file at its port rate
+int orbisAudioTapOpen(unsigned int channel, const char *path, unsigned int blocks)
+{
+    FILE *fp;
+
+    if(!path) return -1;
+
+    fp = fopen(path, "wb");
+    if(!fp) { fprintf(ERROR, "[orbisAudio] can't create %s\n", path); return -1; }
+    if(orbisAudioTapBegin(channel, fp, NULL, NULL, blocks)) { fclose(fp); return -1; }
+    fprintf(DEBUG, "[orbisAudio] recording audio channel %u to %s\n", channel, path);
+
+    return 0;
+}
+
+// record channel to sink, called on the writer thread
+int orbisAudioTapOpenSink(unsigned int channel, OrbisAudioTapSink sink, void *userdata, unsigned int blocks)
+{
+    if(!sink) return -1;
+    return orbisAudioTapBegin(channel, NULL, sink, userdata, blocks);
+}
+
+/*
+ * Stop recording, returns once every recorded block has been written and
+ * the wav file is complete. Blocks the audio thread is handing over right
+ * now still make it.
+ */
+int orbisAudioTapClose(unsigned int channel)
+{
+    OrbisAudioChannel *ch  = orbisAudioGetChannel(channel);
+    OrbisAudioTap     *tap = ch ? ch->tap : NULL;
+
+    if(!tap || !tap->recording) return -1;
+
+    __atomic_store_n(&tap->recording, 0, __ATOMIC_SEQ_CST);
+    while(__atomic_load_n(&tap->busy, __ATOMIC_SEQ_CST)) sceKernelUsleep(100);
+
+    __atomic_store_n(&tap->closing, 1, __ATOMIC_RELEASE);
+    if(!orbisAudioTapWorker.running) orbisAudioTapFinishSession(tap);
+    while(__atomic_load_n(&tap->closing, __ATOMIC_ACQUIRE)) sceKernelUsleep(1000);
+
+    fprintf(DEBUG, "[orbisAudio] tap for audio channel %u closed, %llu blocks, %llu dropped\n", channel,
+            (unsigned long long)ch->stats.tapBlocks, (unsigned long long)ch->stats.tapDropped);
+
+    return 0;
+}
+
+// channel finish: complete the recording and make sure the writer is done with the tap
+void orbisAudioTapDetach(OrbisAudioChannel *ch)
+{
+    OrbisAudioTap *tap = ch->tap;
+
+    if(!tap) return;
+    if(tap->recording) orbisAudioTapClose(ch == orbisAudioConf->master ? ORBISAUDIO_CHANNEL_MASTER : ch->index);
+
+    __atomic_store_n(&ch->tap, NULL, __ATOMIC_RELEASE);
+    orbisAudioTapSync();
+}
+
+// called by orbisAudioFinish before the channels and the mixer go
+void orbisAudioTapShutdown(void)
+{
+    for(int i=0; i<=ORBISAUDIO_CHANNELS; i++)
+    {
+        OrbisAudioChannel *ch = orbisAudioGetChannel(i < ORBISAUDIO_CHANNELS ? i : ORBISAUDIO_CHANNEL_MASTER);
+        if(ch) orbisAudioTapDetach(ch);
+    }
+    if(!orbisAudioTapWorker.running) return;
+
+    __atomic_store_n(&orbisAudioTapWorker.stop, 1, __ATOMIC_RELEASE);
+    pthread_join(orbisAudioTapWorker.thread, NULL);
+    orbisAudioTapWorker.running = 0;
+}
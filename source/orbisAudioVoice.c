@@ -0,0 +1,630 @@
+/*
+#  ____   ____    ____         ___ ____   ____ _     _
+# |    |  ____>   ____>  |    |        | <____  \   /
+# |____| |    \   ____>  | ___|    ____| <____   \_/    ORBISDEV Open Source Project.
+#------------------------------------------------------------------------------------
+# Copyright 2010-2020, orbisdev - http://orbisdev.github.io
+# Licenced under the MIT license
+# Review README & LICENSE files for further details.
+*/
+
+/*
+ * Voice pool: many sound effects mixed into one channel by its own thread.
+ *
+ * The game thread owns slot allocation and stealing, the audio thread owns
+ * playback. They only talk through a single producer / single consumer
+ * command queue, and the audio thread hands slots back by publishing the
+ * generation that ended in each one. Handles carry the generation, so a
+ * handle to a voice that was stolen or ended does nothing.
+ *
+ * Playback state is kept as structure of arrays: per block the gain ramps
+ * and end of sound checks run over all voices in flat loops, then every
+ * active voice is resampled and accumulated in float, and the sum is
+ * dithered down to s16 once, then added to the block with saturation.
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include "orbisAudioInternal.h"
+
+
+#define ORBISAUDIO_VOICE_COMMANDS	256 // minimum queue length, grows with the pool
+#define ORBISAUDIO_VOICE_GEN_MASK	0x7fff
+#define ORBISAUDIO_VOICE_WINDOW		1024 // frames of ADPCM decoded at once
+
+enum
+{
+    ORBISAUDIO_VOICE_CMD_PLAY,
+    ORBISAUDIO_VOICE_CMD_SET,
+    ORBISAUDIO_VOICE_CMD_STOP,
+};
+
+typedef struct OrbisAudioVoiceCmd
+{
+    int                    type;
+    unsigned int           slot;
+    uint32_t               gen;
+    const OrbisAudioSound *sound;
+    uint64_t               step;
+    float                  gainL;
+    float                  gainR;
+    unsigned char          loop;
+} OrbisAudioVoiceCmd;
+
+struct OrbisAudioVoicePool
+{
+    unsigned int count;
+    unsigned int channels;      // of the channel's port, 1 or 2
+
+    // audio thread side
+    const OrbisAudioSound **sound;
+    uint64_t     *pos;          // 32.32 frames into the sound
+    uint64_t     *step;         // 32.32 frames per output frame
+    float        *curL, *curR;  // gains at the start of the block
+    float        *tgtL, *tgtR;  // gains at its end
+    uint32_t     *gen;
+    unsigned char *active;
+    unsigned char *loop;
+    float        *accum;        // one block, port channels interleaved
+    short        *mix;          // the same block dithered to s16
+    OrbisAudioAdpcmState *adpcm;
+    short        *adpcmPrev;    // last frame decoded, two per voice
+    short        *adpcmFrom;    // loop start frame
+    short        *window;       // decoded ADPCM, shared by all voices
+
+    // game thread side
+    uint32_t     *callerGen;    // last generation started in the slot, 0 never used
+    const OrbisAudioSound **callerSound;
+    int          *priority;
+    uint64_t     *started;      // start order, oldest voice is stolen first on a tie
+    uint64_t      serial;
+
+    // written by the audio thread, read by the game thread
+    uint32_t     *ended;
+
+    OrbisAudioVoiceCmd *cmds;
+    unsigned int  cmdMask;      // queue length - 1, room to start every voice at once
+    unsigned int head __attribute__((aligned(64)));
+    unsigned int tail __attribute__((aligned(64)));
+};
+
+
+static OrbisAudioVoicePool *orbisAudioGetVoices(unsigned int channel)
+{
+    OrbisAudioChannel *ch = orbisAudioGetChannel(channel);
+
+    if(!ch || channel >= ORBISAUDIO_CHANNELS) return NULL;
+    return __atomic_load_n(&ch->voices, __ATOMIC_ACQUIRE);
+}
+
+// set up after orbisAudioInitChannel, the pool lives in the channel's arena region
+int orbisAudioInitVoices(unsigned int channel, unsigned int voices)
+{
+    OrbisAudioChannel   *ch = orbisAudioGetChannel(channel);
+    OrbisAudioVoicePool *pool;
+    unsigned int         n;
+
+    if(!ch || channel >= ORBISAUDIO_CHANNELS) return -1;
+    if(ch->orbisaudiochannel_initialized != 1) { fprintf(ERROR, "[orbisAudio] orbisAudioInitVoices channel %u is not initialized\n", channel); return -1; }
+    if(ch->voices) { fprintf(DEBUG, "[orbisAudio] voices for audio channel %u already created\n", channel); return -1; }
+    if(voices < 1 || voices > ORBISAUDIO_MAX_VOICES) return -1;
+
+    pool = (OrbisAudioVoicePool *)orbisAudioArenaAlloc(channel, sizeof(OrbisAudioVoicePool));
+    if(!pool) return -1;
+    memset(pool, 0, sizeof(OrbisAudioVoicePool));
+
+    n = voices;
+    pool->count     = n;
+    pool->channels  = ch->stereo + 1;
+    pool->sound     = (const OrbisAudioSound **)orbisAudioArenaAlloc(channel, n * sizeof(OrbisAudioSound *));
+    pool->pos       = (uint64_t *)orbisAudioArenaAlloc(channel, n * sizeof(uint64_t));
+    pool->step      = (uint64_t *)orbisAudioArenaAlloc(channel, n * sizeof(uint64_t));
+    pool->curL      = (float *)orbisAudioArenaAlloc(channel, n * sizeof(float));
+    pool->curR      = (float *)orbisAudioArenaAlloc(channel, n * sizeof(float));
+    pool->tgtL      = (float *)orbisAudioArenaAlloc(channel, n * sizeof(float));
+    pool->tgtR      = (float *)orbisAudioArenaAlloc(channel, n * sizeof(float));
+    pool->gen       = (uint32_t *)orbisAudioArenaAlloc(channel, n * sizeof(uint32_t));
+    pool->active    = (unsigned char *)orbisAudioArenaAlloc(channel, n);
+    pool->loop      = (unsigned char *)orbisAudioArenaAlloc(channel, n);
+    pool->accum     = (float *)orbisAudioArenaAlloc(channel, ch->samples[0] * pool->channels * sizeof(float));
+    pool->mix       = (short *)orbisAudioArenaAlloc(channel, ch->samples[0] * pool->channels * sizeof(short));
+    pool->adpcm     = (OrbisAudioAdpcmState *)orbisAudioArenaAlloc(channel, n * sizeof(OrbisAudioAdpcmState));
+    pool->adpcmPrev = (short *)orbisAudioArenaAlloc(channel, n * 2 * sizeof(short));
+    pool->adpcmFrom = (short *)orbisAudioArenaAlloc(channel, n * 2 * sizeof(short));
+    pool->window    = (short *)orbisAudioArenaAlloc(channel, ORBISAUDIO_VOICE_WINDOW * 2 * sizeof(short));
+    pool->callerGen = (uint32_t *)orbisAudioArenaAlloc(channel, n * sizeof(uint32_t));
+    pool->callerSound = (const OrbisAudioSound **)orbisAudioArenaAlloc(channel, n * sizeof(OrbisAudioSound *));
+    pool->priority  = (int *)orbisAudioArenaAlloc(channel, n * sizeof(int));
+    pool->started   = (uint64_t *)orbisAudioArenaAlloc(channel, n * sizeof(uint64_t));
+    pool->ended     = (uint32_t *)orbisAudioArenaAlloc(channel, n * sizeof(uint32_t));
+
+    pool->cmdMask   = ORBISAUDIO_VOICE_COMMANDS;
+    while(pool->cmdMask < 2 * n) pool->cmdMask <<= 1;
+    pool->cmds      = (OrbisAudioVoiceCmd *)orbisAudioArenaAlloc(channel, pool->cmdMask * sizeof(OrbisAudioVoiceCmd));
+    pool->cmdMask  -= 1;
+
+    if(!pool->sound || !pool->pos || !pool->step || !pool->curL || !pool->curR || !pool->tgtL || !pool->tgtR
+    || !pool->gen || !pool->active || !pool->loop || !pool->accum || !pool->mix || !pool->callerGen || !pool->priority
+    || !pool->adpcm || !pool->adpcmPrev || !pool->adpcmFrom || !pool->window
+    || !pool->callerSound || !pool->started || !pool->ended || !pool->cmds) return -1;
+
+    memset(pool->active,    0, n);
+    memset(pool->callerGen, 0, n * sizeof(uint32_t));
+    memset(pool->ended,     0, n * sizeof(uint32_t));
+
+    // the mix is dithered like a float source
+    if(!orbisAudioFormatIsFloat(ch->format))
+        for(unsigned int k=0; k<8; k++) ch->dither[k] = 0x9E3779B9u * (channel * 8 + k + 1);
+
+    __atomic_store_n(&ch->voices, pool, __ATOMIC_RELEASE);
+    fprintf(DEBUG, "[orbisAudio] %u voices for audio channel %u created\n", n, channel);
+
+    return 0;
+}
+
+static int orbisAudioVoicePush(OrbisAudioVoicePool *pool, const OrbisAudioVoiceCmd *cmd)
+{
+    unsigned int head = pool->head;
+
+    if(head - __atomic_load_n(&pool->tail, __ATOMIC_ACQUIRE) > pool->cmdMask) return -1;
+
+    pool->cmds[head & pool->cmdMask] = *cmd;
+    __atomic_store_n(&pool->head, head + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+// constant power pan, -1 is hard left and 1 hard right
+static void orbisAudioVoiceGains(OrbisAudioVoiceCmd *cmd, float gain, float pan)
+{
+    float a;
+
+    if(pan < -1.0f) pan = -1.0f;
+    if(pan >  1.0f) pan =  1.0f;
+    if(gain < 0.0f) gain = 0.0f;
+
+    // the mix stays in s16 units until the final conversion
+    a = (pan + 1.0f) * (float)(M_PI / 4);
+    cmd->gainL = gain * cosf(a);
+    cmd->gainR = gain * sinf(a);
+}
+
+static uint64_t orbisAudioVoiceStep(OrbisAudioChannel *ch, const OrbisAudioSound *sound, float pitch)
+{
+    unsigned int rate = ch->sourceFrequency ? ch->sourceFrequency : ch->frequency;
+
+    if(!(pitch > 0.0f)) pitch = 1.0f;
+    if(pitch > 8.0f)    pitch = 8.0f;
+
+    return (uint64_t)((double)sound->frequency / rate * pitch * 4294967296.0);
+}
+
+static int orbisAudioVoiceSlot(OrbisAudioVoicePool *pool, int voice)
+{
+    unsigned int slot = voice & 0xffff;
+    uint32_t     gen  = ((unsigned int)voice >> 16) & ORBISAUDIO_VOICE_GEN_MASK;
+
+    if(voice < 0 || slot >= pool->count || !gen || pool->callerGen[slot] != gen) return -1;
+    return slot;
+}
+
+/*
+ * Start a voice from the game thread, returns its handle or -1. With the
+ * pool full the lowest priority voice, the oldest one among equals, is
+ * stolen if its priority is not above the new sound's.
+ */
+int orbisAudioVoicePlay(unsigned int channel, const OrbisAudioSound *sound, float gain, float pan, float pitch, int loop)
+{
+    OrbisAudioChannel   *ch   = orbisAudioGetChannel(channel);
+    OrbisAudioVoicePool *pool = orbisAudioGetVoices(channel);
+    OrbisAudioVoiceCmd   cmd;
+    int                  slot = -1, stolen = 0;
+
+    if(!pool || !sound || !sound->data || !sound->frames || !sound->frequency) return -1;
+    if(sound->channels < 1 || sound->channels > 2) return -1;
+    if(sound->encoding != ORBISAUDIO_ENCODING_PCM16 && sound->encoding != ORBISAUDIO_ENCODING_ADPCM) return -1;
+
+    for(unsigned int s=0; s<pool->count; s++)
+    {
+        uint32_t gen = pool->callerGen[s];
+        if(!gen || __atomic_load_n(&pool->ended[s], __ATOMIC_ACQUIRE) == gen) { slot = s; break; }
+    }
+    if(slot < 0)
+    {
+        for(unsigned int s=0; s<pool->count; s++)
+        {
+            if(pool->priority[s] > sound->priority) continue;
+            if(slot < 0 || pool->priority[s] < pool->priority[slot]
+            || (pool->priority[s] == pool->priority[slot] && pool->started[s] < pool->started[slot])) slot = s;
+        }
+        if(slot < 0) return -1;
+        stolen = 1;
+    }
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.type  = ORBISAUDIO_VOICE_CMD_PLAY;
+    cmd.slot  = slot;
+    cmd.gen   = (pool->callerGen[slot] + 1) & ORBISAUDIO_VOICE_GEN_MASK;
+    if(!cmd.gen) cmd.gen = 1;
+    cmd.sound = sound;
+    cmd.step  = orbisAudioVoiceStep(ch, sound, pitch);
+    cmd.loop  = loop ? 1 : 0;
+    orbisAudioVoiceGains(&cmd, gain, pan);
+
+    if(orbisAudioVoicePush(pool, &cmd)) return -1;
+
+    pool->callerGen[slot] = cmd.gen;
+    pool->callerSound[slot] = sound;
+    pool->priority [slot] = sound->priority;
+    pool->started  [slot] = pool->serial++;
+    if(stolen) orbisAudioStatAdd(&ch->stats.voicesStolen, 1);
+
+    return (int)(cmd.gen << 16) | slot;
+}
+
+// new gain, pan and pitch, ramped in over the next block
+int orbisAudioVoiceSet(unsigned int channel, int voice, float gain, float pan, float pitch)
+{
+    OrbisAudioChannel   *ch   = orbisAudioGetChannel(channel);
+    OrbisAudioVoicePool *pool = orbisAudioGetVoices(channel);
+    OrbisAudioVoiceCmd   cmd;
+    int                  slot;
+
+    if(!pool || (slot = orbisAudioVoiceSlot(pool, voice)) < 0) return -1;
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.type = ORBISAUDIO_VOICE_CMD_SET;
+    cmd.slot = slot;
+    cmd.gen  = pool->callerGen[slot];
+    cmd.step = orbisAudioVoiceStep(ch, pool->callerSound[slot], pitch);
+    orbisAudioVoiceGains(&cmd, gain, pan);
+
+    return orbisAudioVoicePush(pool, &cmd);
+}
+
+/*
+ * orbisAudioVoiceSet for many voices with left and right gains worked out
+ * already, queued with a single publish. Stale handles are skipped, the
+ * voices handled so far are returned when the queue fills up.
+ */
+unsigned int orbisAudioVoiceSetGains(unsigned int channel, const int *voices, const float *gainL, const float *gainR, const float *pitch, unsigned int count)
+{
+    OrbisAudioChannel   *ch   = orbisAudioGetChannel(channel);
+    OrbisAudioVoicePool *pool = orbisAudioGetVoices(channel);
+    unsigned int         head, room, n;
+
+    if(!pool) return 0;
+
+    head = pool->head;
+    room = pool->cmdMask + 1 - (head - __atomic_load_n(&pool->tail, __ATOMIC_ACQUIRE));
+
+    for(n=0; n<count && room; n++)
+    {
+        OrbisAudioVoiceCmd *cmd;
+        int                 slot = orbisAudioVoiceSlot(pool, voices[n]);
+
+        if(slot < 0) continue;
+
+        cmd = &pool->cmds[head & pool->cmdMask];
+        memset(cmd, 0, sizeof(*cmd));
+        cmd->type  = ORBISAUDIO_VOICE_CMD_SET;
+        cmd->slot  = slot;
+        cmd->gen   = pool->callerGen[slot];
+        cmd->step  = orbisAudioVoiceStep(ch, pool->callerSound[slot], pitch[n]);
+        cmd->gainL = gainL[n] > 0.0f ? gainL[n] : 0.0f;
+        cmd->gainR = gainR[n] > 0.0f ? gainR[n] : 0.0f;
+        head++;
+        room--;
+    }
+    __atomic_store_n(&pool->head, head, __ATOMIC_RELEASE);
+
+    return n;
+}
+
+int orbisAudioVoiceStop(unsigned int channel, int voice)
+{
+    OrbisAudioVoicePool *pool = orbisAudioGetVoices(channel);
+    OrbisAudioVoiceCmd   cmd;
+    int                  slot;
+
+    if(!pool || (slot = orbisAudioVoiceSlot(pool, voice)) < 0) return -1;
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.type = ORBISAUDIO_VOICE_CMD_STOP;
+    cmd.slot = slot;
+    cmd.gen  = pool->callerGen[slot];
+
+    return orbisAudioVoicePush(pool, &cmd);
+}
+
+// 1 while the voice is queued or playing, 0 once it ended, was stopped or stolen
+int orbisAudioVoiceIsPlaying(unsigned int channel, int voice)
+{
+    OrbisAudioVoicePool *pool = orbisAudioGetVoices(channel);
+    int                  slot;
+
+    if(!pool || (slot = orbisAudioVoiceSlot(pool, voice)) < 0) return 0;
+    return __atomic_load_n(&pool->ended[slot], __ATOMIC_ACQUIRE) != pool->callerGen[slot];
+}
+
+
+// audio thread: a voice is done, its slot goes back to the game thread
+static void orbisAudioVoiceEnd(OrbisAudioVoicePool *pool, unsigned int v)
+{
+    pool->active[v] = 0;
+    pool->sound [v] = NULL;
+    __atomic_store_n(&pool->ended[v], pool->gen[v], __ATOMIC_RELEASE);
+}
+
+// a looping voice wraps at the loop end, a one shot plays to the end of the sound
+static inline unsigned int orbisAudioVoiceLength(const OrbisAudioSound *snd, int loop)
+{
+    return (loop && snd->loopEnd && snd->loopEnd <= snd->frames) ? snd->loopEnd : snd->frames;
+}
+
+// audio thread: decoder at the start, and the loop start frame a looping voice interpolates towards at the end
+static void orbisAudioVoiceStartAdpcm(OrbisAudioVoicePool *pool, unsigned int v)
+{
+    const OrbisAudioSound *snd = pool->sound[v];
+    OrbisAudioAdpcmState   st;
+    unsigned int           len = orbisAudioVoiceLength(snd, pool->loop[v]);
+
+    pool->adpcm[v].next = ~0u;
+    orbisAudioAdpcmSeek(&pool->adpcm[v], snd, 0);
+
+    if(!pool->loop[v]) return;
+    st.next = ~0u;
+    orbisAudioAdpcmSeek(&st, snd, snd->loopStart < len ? snd->loopStart : 0);
+    orbisAudioAdpcmRead(&st, snd, &pool->adpcmFrom[v * 2], 1);
+}
+
+static void orbisAudioVoiceCommands(OrbisAudioVoicePool *pool)
+{
+    unsigned int head = __atomic_load_n(&pool->head, __ATOMIC_ACQUIRE);
+    unsigned int tail = pool->tail;
+
+    for(; tail != head; tail++)
+    {
+        const OrbisAudioVoiceCmd *cmd = &pool->cmds[tail & pool->cmdMask];
+        unsigned int v = cmd->slot;
+
+        switch(cmd->type)
+        {
+            case ORBISAUDIO_VOICE_CMD_PLAY:
+                // a stolen voice is replaced in place, its generation never reports as ended
+                pool->sound [v] = cmd->sound;
+                pool->pos   [v] = 0;
+                pool->step  [v] = cmd->step;
+                pool->curL  [v] = pool->tgtL[v] = cmd->gainL;
+                pool->curR  [v] = pool->tgtR[v] = cmd->gainR;
+                pool->loop  [v] = cmd->loop;
+                pool->gen   [v] = cmd->gen;
+                pool->active[v] = 1;
+                if(cmd->sound->encoding == ORBISAUDIO_ENCODING_ADPCM) orbisAudioVoiceStartAdpcm(pool, v);
+                break;
+            case ORBISAUDIO_VOICE_CMD_SET:
+                if(!pool->active[v] || pool->gen[v] != cmd->gen) break;
+                pool->tgtL[v] = cmd->gainL;
+                pool->tgtR[v] = cmd->gainR;
+                if(cmd->step) pool->step[v] = cmd->step;
+                break;
+            case ORBISAUDIO_VOICE_CMD_STOP:
+                if(pool->active[v] && pool->gen[v] == cmd->gen) orbisAudioVoiceEnd(pool, v);
+                break;
+        }
+    }
+    __atomic_store_n(&pool->tail, tail, __ATOMIC_RELEASE);
+}
+
+static inline float orbisAudioVoiceSample(const short *data, unsigned int channels, unsigned int c, unsigned int idx)
+{
+    return data[idx * channels + c];
+}
+
+/*
+ * Accumulate up to frames output frames from len frames of s16 data starting
+ * at *pos, linear interpolation between source frames, gains ramping from
+ * gl, gr by dl, dr a frame. Returns the frames written, fewer when a one shot
+ * sound ends.
+ */
+static unsigned int orbisAudioVoiceMixSpan(const short *data, unsigned int sc, unsigned int oc, unsigned int len, unsigned int from, int loop,
+                                           uint64_t *ppos, uint64_t step, float gl, float gr, float dl, float dr, float *acc, unsigned int frames)
+{
+    uint64_t     pos = *ppos;
+    uint64_t     end = (uint64_t)len << 32;
+    unsigned int i;
+
+    // unit step, contiguous source: no interpolation and a loop the compiler can vectorize
+    if(step == ((uint64_t)1 << 32) && !(pos & 0xffffffff))
+    {
+        unsigned int idx = (unsigned int)(pos >> 32);
+
+        for(i=0; i<frames; )
+        {
+            unsigned int n = frames - i;
+            const short *s;
+
+            if(idx >= len)
+            {
+                if(!loop) break;
+                idx = from;
+            }
+            if(n > len - idx) n = len - idx;
+            s = data + idx * sc;
+
+            if(oc == 2 && sc == 1)
+                for(unsigned int k=0; k<n; k++) { float m = s[k]; acc[2*(i+k)] += m * (gl + dl * (i+k)); acc[2*(i+k)+1] += m * (gr + dr * (i+k)); }
+            else if(oc == 2)
+                for(unsigned int k=0; k<n; k++) { acc[2*(i+k)] += s[2*k] * (gl + dl * (i+k)); acc[2*(i+k)+1] += s[2*k+1] * (gr + dr * (i+k)); }
+            else if(sc == 1)
+                for(unsigned int k=0; k<n; k++) acc[i+k] += s[k] * ((gl + gr + (dl + dr) * (i+k)) * 0.70710678f);
+            else
+                for(unsigned int k=0; k<n; k++) acc[i+k] += (s[2*k] * (gl + dl * (i+k)) + s[2*k+1] * (gr + dr * (i+k))) * 0.70710678f;
+
+            i   += n;
+            idx += n;
+        }
+        *ppos = (uint64_t)idx << 32;
+        return i;
+    }
+
+    for(i=0; i<frames; i++)
+    {
+        unsigned int idx, next;
+        float        frac, l, r;
+
+        if(pos >= end)
+        {
+            if(!loop) break;
+            // keep the fractional part so looping doesn't drift
+            pos = ((uint64_t)from << 32) + (pos - end);
+            if(pos >= end) pos = 0;
+        }
+        idx  = (unsigned int)(pos >> 32);
+        next = idx + 1 < len ? idx + 1 : (loop ? from : idx);
+        frac = (float)(pos & 0xffffffff) * (1.0f / 4294967296.0f);
+
+        l = orbisAudioVoiceSample(data, sc, 0, idx);
+        l = l + (orbisAudioVoiceSample(data, sc, 0, next) - l) * frac;
+        if(sc == 2)
+        {
+            r = orbisAudioVoiceSample(data, sc, 1, idx);
+            r = r + (orbisAudioVoiceSample(data, sc, 1, next) - r) * frac;
+        }
+        else r = l;
+
+        if(oc == 2) { acc[2*i] += l * gl; acc[2*i+1] += r * gr; }
+        else        acc[i] += (l * gl + r * gr) * 0.70710678f;
+
+        gl  += dl;
+        gr  += dr;
+        pos += step;
+    }
+    *ppos = pos;
+    return i;
+}
+
+/*
+ * ADPCM voices decode just the source frames the block needs into the
+ * window, in runs that never cross the loop end, and mix each run like PCM.
+ * The decoder state stays on the last frame read, so the next block goes on
+ * from there instead of from its block header.
+ */
+static unsigned int orbisAudioVoiceMixAdpcm(OrbisAudioVoicePool *pool, unsigned int v, unsigned int len, unsigned int from,
+                                            float gl, float gr, float dl, float dr, float *acc, unsigned int frames)
+{
+    const OrbisAudioSound *snd  = pool->sound[v];
+    OrbisAudioAdpcmState  *st   = &pool->adpcm[v];
+    short                 *win  = pool->window;
+    unsigned int           sc   = snd->channels, oc = pool->channels;
+    uint64_t               pos  = pool->pos[v], step = pool->step[v];
+    uint64_t               end  = (uint64_t)len << 32;
+    unsigned int           i;
+
+    for(i=0; i<frames; )
+    {
+        unsigned int first, last, count;
+        uint64_t     n, rel;
+
+        if(pos >= end)
+        {
+            if(!pool->loop[v]) break;
+            pos = ((uint64_t)from << 32) + (pos - end);
+            if(pos >= end) pos = 0;
+        }
+
+        // output frames before the source runs past its end, and that fit the window
+        n = (end - pos + step - 1) / step;
+        if(n > frames - i) n = frames - i;
+        if(n > ((uint64_t)(ORBISAUDIO_VOICE_WINDOW - 2) << 32) / step) n = ((uint64_t)(ORBISAUDIO_VOICE_WINDOW - 2) << 32) / step;
+
+        first = (unsigned int)(pos >> 32);
+        last  = (unsigned int)((pos + (n - 1) * step) >> 32);
+        count = last - first + 1;
+
+        if(first + 1 == st->next)
+        {
+            memcpy(win, &pool->adpcmPrev[v * 2], sc * sizeof(short));
+            orbisAudioAdpcmRead(st, snd, win + sc, count - 1);
+        }
+        else
+        {
+            orbisAudioAdpcmSeek(st, snd, first);
+            orbisAudioAdpcmRead(st, snd, win, count);
+        }
+        memcpy(&pool->adpcmPrev[v * 2], win + (count - 1) * sc, sc * sizeof(short));
+
+        // the frame the last one interpolates towards, without moving the state off it
+        if(last + 1 < len)
+        {
+            OrbisAudioAdpcmState peek = *st;
+            orbisAudioAdpcmRead(&peek, snd, win + count * sc, 1);
+        }
+        else memcpy(win + count * sc, pool->loop[v] ? &pool->adpcmFrom[v * 2] : win + (count - 1) * sc, sc * sizeof(short));
+
+        rel = pos - ((uint64_t)first << 32);
+        orbisAudioVoiceMixSpan(win, sc, oc, count + 1, 0, 0, &rel, step, gl + dl * i, gr + dr * i, dl, dr, acc + i * oc, (unsigned int)n);
+        pos  = ((uint64_t)first << 32) + rel;
+        i   += (unsigned int)n;
+    }
+    pool->pos[v] = pos;
+    return i;
+}
+
+// up to frames output frames of voice v, fewer when a one shot sound ends
+static unsigned int orbisAudioVoiceMixOne(OrbisAudioVoicePool *pool, unsigned int v, float *acc, unsigned int frames)
+{
+    const OrbisAudioSound *snd  = pool->sound[v];
+    unsigned int           len  = orbisAudioVoiceLength(snd, pool->loop[v]);
+    unsigned int           from = snd->loopStart < len ? snd->loopStart : 0;
+    float                  gl   = pool->curL[v], gr = pool->curR[v];
+    float                  dl   = (pool->tgtL[v] - gl) / frames, dr = (pool->tgtR[v] - gr) / frames;
+
+    if(snd->encoding == ORBISAUDIO_ENCODING_ADPCM) return orbisAudioVoiceMixAdpcm(pool, v, len, from, gl, gr, dl, dr, acc, frames);
+
+    return orbisAudioVoiceMixSpan(snd->data, snd->channels, pool->channels, len, from, pool->loop[v],
+                                  &pool->pos[v], pool->step[v], gl, gr, dl, dr, acc, frames);
+}
+
+/*
+ * Mix every active voice into one block of the channel, on top of what its
+ * callback or ring already rendered there. Called from the channel (or
+ * mixer) thread with the block in the port's s16 format.
+ */
+void orbisAudioVoiceRender(OrbisAudioChannel *ch, short *buf, unsigned int samples)
+{
+    OrbisAudioVoicePool *pool = __atomic_load_n(&ch->voices, __ATOMIC_ACQUIRE);
+    unsigned int         count, n, playing = 0;
+    float               *acc;
+
+    if(!pool) return;
+    orbisAudioVoiceCommands(pool);
+
+    count = samples * pool->channels;
+    acc   = pool->accum;
+
+    for(n=0; n<pool->count; n++) playing |= pool->active[n];
+    if(!playing) return;
+
+    memset(acc, 0, count * sizeof(float));
+
+    for(unsigned int v=0; v<pool->count; v++)
+    {
+        if(!pool->active[v]) continue;
+        if(orbisAudioVoiceMixOne(pool, v, acc, samples) < samples) orbisAudioVoiceEnd(pool, v);
+    }
+
+    // gain ramps land on their targets, over every voice at once
+    for(unsigned int v=0; v<pool->count; v++)
+    {
+        pool->curL[v] = pool->tgtL[v];
+        pool->curR[v] = pool->tgtR[v];
+    }
+
+    // back to [-1, 1] for the shared dither and clip kernel, only the voices get dithered:
+    // whatever already is in the block goes through untouched
+    for(unsigned int i=0; i<count; i++) acc[i] *= (1.0f / 32767);
+    orbisAudioConvertF32ToS16(pool->mix, acc, count, ch->dither);
+    orbisAudioMixS16(buf, pool->mix, count);
+}
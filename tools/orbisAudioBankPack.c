@@ -0,0 +1,253 @@
+/*
+#  ____   ____    ____         ___ ____   ____ _     _
+# |    |  ____>   ____>  |    |        | <____  \   /
+# |____| |    \   ____>  | ___|    ____| <____   \_/    ORBISDEV Open Source Project.
+#------------------------------------------------------------------------------------
+# Copyright 2010-2020, orbisdev - http://orbisdev.github.io
+# Licenced under the MIT license
+# Review README & LICENSE files for further details.
+*/
+
+/*
+ * Sound bank packer: turns a list of wav files (16 bit or float PCM, mono or
+ * stereo) into one bank file for orbisAudioBankOpen. Sounds are named after
+ * their file without directory and extension, loop points come from the
+ * first loop of a smpl chunk when there is one. -a stores the following
+ * files as IMA ADPCM, about a quarter of the size.
+ *
+ *   orbisAudioBankPack -o sfx.bank [-p priority] [-a] a.wav b.wav ...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "orbisAudio.h"
+
+
+typedef struct PackSound
+{
+    OrbisAudioBankEntry entry;
+    void               *payload;
+} PackSound;
+
+
+static uint32_t packLe32(const uint8_t *p) { return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24; }
+static uint16_t packLe16(const uint8_t *p) { return p[0] | p[1] << 8; }
+
+static uint8_t *packLoad(const char *path, size_t *size)
+{
+    FILE    *f = fopen(path, "rb");
+    uint8_t *buf;
+    long     n;
+
+    if(!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = (n > 0) ? malloc(n) : NULL;
+    if(buf && fread(buf, 1, n, f) != (size_t)n) { free(buf); buf = NULL; }
+    fclose(f);
+    *size = n;
+
+    return buf;
+}
+
+static void packName(char *name, const char *path)
+{
+    const char *base = strrchr(path, '/');
+    const char *dot;
+    size_t      len;
+
+    base = base ? base + 1 : path;
+    dot  = strrchr(base, '.');
+    len  = dot ? (size_t)(dot - base) : strlen(base);
+    if(len > ORBISAUDIO_BANK_NAME_LEN - 1)
+    {
+        fprintf(stderr, "%s: name truncated to %d characters\n", path, ORBISAUDIO_BANK_NAME_LEN - 1);
+        len = ORBISAUDIO_BANK_NAME_LEN - 1;
+    }
+    memset(name, 0, ORBISAUDIO_BANK_NAME_LEN);
+    memcpy(name, base, len);
+}
+
+static int packWav(PackSound *s, const char *path, int priority, int adpcm)
+{
+    const uint8_t *data = NULL, *fmt = NULL, *smpl = NULL;
+    uint32_t       dataBytes = 0, smplBytes = 0;
+    unsigned int   tag, channels, rate, bits, samples;
+    uint8_t       *buf;
+    short         *pcm;
+    size_t         size, pos;
+
+    buf = packLoad(path, &size);
+    if(!buf) { fprintf(stderr, "%s: can't read\n", path); return -1; }
+    if(size < 12 || memcmp(buf, "RIFF", 4) || memcmp(buf + 8, "WAVE", 4)) { fprintf(stderr, "%s: not a wav file\n", path); free(buf); return -1; }
+
+    for(pos = 12; pos + 8 <= size; )
+    {
+        uint32_t bytes = packLe32(buf + pos + 4);
+
+        if(bytes > size - pos - 8) bytes = size - pos - 8;
+        if(!memcmp(buf + pos, "fmt ", 4) && bytes >= 16) fmt = buf + pos + 8;
+        else if(!memcmp(buf + pos, "data", 4)) { data = buf + pos + 8; dataBytes = bytes; }
+        else if(!memcmp(buf + pos, "smpl", 4)) { smpl = buf + pos + 8; smplBytes = bytes; }
+        pos += 8 + bytes + (bytes & 1);
+    }
+    if(!fmt || !data) { fprintf(stderr, "%s: no fmt or data chunk\n", path); free(buf); return -1; }
+
+    tag      = packLe16(fmt);
+    channels = packLe16(fmt + 2);
+    rate     = packLe32(fmt + 4);
+    bits     = packLe16(fmt + 14);
+    if(tag == 0xfffe && packLe16(fmt + 16) >= 22) tag = packLe16(fmt + 24); // WAVE_FORMAT_EXTENSIBLE subformat
+
+    if(channels < 1 || channels > 2 || !rate || !((tag == 1 && bits == 16) || (tag == 3 && bits == 32)))
+    {
+        fprintf(stderr, "%s: only 16 bit or float, mono or stereo wav files are supported\n", path);
+        free(buf);
+        return -1;
+    }
+
+    samples = dataBytes / (bits / 8) / channels * channels;
+    pcm = malloc(samples * sizeof(short) + 1);
+    if(!pcm) { free(buf); return -1; }
+
+    for(unsigned int i=0; i<samples; i++)
+    {
+        if(tag == 1) pcm[i] = (short)packLe16(data + i * 2);
+        else
+        {
+            uint32_t u = packLe32(data + i * 4);
+            float    x;
+
+            memcpy(&x, &u, sizeof(x));
+            x = x * 32768.0f;
+            pcm[i] = (short)lrintf(x > 32767.0f ? 32767.0f : x < -32768.0f ? -32768.0f : x);
+        }
+    }
+
+    memset(&s->entry, 0, sizeof(s->entry));
+    packName(s->entry.name, path);
+    s->entry.frames    = samples / channels;
+    s->entry.frequency = rate;
+    s->entry.channels  = channels;
+    s->entry.priority  = priority;
+
+    if(adpcm)
+    {
+        s->entry.format = ORBISAUDIO_ENCODING_ADPCM;
+        s->entry.bytes  = orbisAudioAdpcmBytes(s->entry.frames, channels);
+        s->payload      = malloc(s->entry.bytes + 1);
+        if(!s->payload || orbisAudioAdpcmEncode(s->payload, pcm, s->entry.frames, channels)) { free(pcm); free(buf); return -1; }
+        free(pcm);
+    }
+    else
+    {
+        s->entry.format = ORBISAUDIO_ENCODING_PCM16;
+        s->entry.bytes  = samples * sizeof(short);
+        s->payload      = pcm;
+    }
+
+    // smpl: 36 bytes of header, loop count at 28, then 24 byte loops with start and inclusive end at 8 and 12
+    if(smpl && smplBytes >= 36 + 24 && packLe32(smpl + 28) > 0)
+    {
+        uint32_t start = packLe32(smpl + 36 + 8);
+        uint32_t end   = packLe32(smpl + 36 + 12) + 1;
+
+        if(start < end && end <= s->entry.frames)
+        {
+            s->entry.loopStart = start;
+            s->entry.loopEnd   = end;
+        }
+        else fprintf(stderr, "%s: loop %u-%u outside the sound, ignored\n", path, start, end);
+    }
+    free(buf);
+
+    return 0;
+}
+
+static uint64_t packAlign(uint64_t n)
+{
+    return (n + ORBISAUDIO_BANK_ALIGN - 1) & ~(uint64_t)(ORBISAUDIO_BANK_ALIGN - 1);
+}
+
+static int packWrite(const char *path, PackSound *sounds, unsigned int count)
+{
+    static const uint8_t zero[ORBISAUDIO_BANK_ALIGN];
+    OrbisAudioBankHeader header;
+    uint64_t             offset;
+    FILE                *f;
+
+    memset(&header, 0, sizeof(header));
+    header.magic       = ORBISAUDIO_BANK_MAGIC;
+    header.version     = ORBISAUDIO_BANK_VERSION;
+    header.count       = count;
+    header.indexOffset = sizeof(header);
+
+    offset = packAlign(sizeof(header) + count * sizeof(OrbisAudioBankEntry));
+    for(unsigned int i=0; i<count; i++)
+    {
+        sounds[i].entry.offset = offset;
+        offset = packAlign(offset + sounds[i].entry.bytes);
+    }
+    header.size = offset;
+
+    f = fopen(path, "wb");
+    if(!f) { fprintf(stderr, "%s: can't create\n", path); return -1; }
+
+    fwrite(&header, sizeof(header), 1, f);
+    for(unsigned int i=0; i<count; i++) fwrite(&sounds[i].entry, sizeof(OrbisAudioBankEntry), 1, f);
+    for(unsigned int i=0; i<count; i++)
+    {
+        fwrite(zero, 1, sounds[i].entry.offset - ftell(f), f);
+        fwrite(sounds[i].payload, 1, sounds[i].entry.bytes, f);
+    }
+    fwrite(zero, 1, header.size - ftell(f), f);
+
+    if(fclose(f)) { fprintf(stderr, "%s: write failed\n", path); return -1; }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *out = NULL;
+    PackSound  *sounds;
+    unsigned int count = 0;
+    int         priority = 0, adpcm = 0;
+    int         ret = 0;
+
+    sounds = calloc(argc, sizeof(PackSound));
+    if(!sounds) return 1;
+
+    for(int i=1; i<argc; i++)
+    {
+        if(!strcmp(argv[i], "-o") && i + 1 < argc) out = argv[++i];
+        else if(!strcmp(argv[i], "-p") && i + 1 < argc) priority = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "-a")) adpcm = 1;
+        else if(argv[i][0] == '-') { out = NULL; count = 0; break; }
+        else if(packWav(&sounds[count], argv[i], priority, adpcm) == 0)
+        {
+            for(unsigned int j=0; j<count; j++)
+                if(!strcmp(sounds[j].entry.name, sounds[count].entry.name))
+                    fprintf(stderr, "%s: name %s already used, orbisAudioBankFind returns the first\n", argv[i], sounds[count].entry.name);
+            count++;
+        }
+        else ret = 1;
+    }
+    if(!out || !count)
+    {
+        fprintf(stderr, "usage: %s -o out.bank [-p priority] [-a] file.wav ...\n", argv[0]);
+        return 1;
+    }
+
+    if(packWrite(out, sounds, count)) ret = 1;
+    else printf("%s: %u sounds\n", out, count);
+
+    for(unsigned int i=0; i<count; i++) free(sounds[i].payload);
+    free(sounds);
+
+    return ret;
+}
@@ -0,0 +1,745 @@
+/*
+#  ____   ____    ____         ___ ____   ____ _     _
+# |    |  ____>   ____>  |    |        | <____  \   /
+# |____| |    \   ____>  | ___|    ____| <____   \_/    ORBISDEV Open Source Project.
+#------------------------------------------------------------------------------------
+# Copyright 2010-2020, orbisdev - http://orbisdev.github.io
+# Licenced under the MIT license
+# Review README & LICENSE files for further details.
+*/
+
+/*
+ * Host benchmark: drives the library against the null fast backend and
+ * writes machine readable json.
+ *
+ *  - blocks per second for every block size from ORBISAUDIO_MIN_LEN to
+ *    ORBISAUDIO_MAX_LEN, mono and stereo, one to five channels, with one
+ *    thread per channel and in mixer mode
+ *  - distribution of render start to submit latency (log2 us buckets)
+ *  - cpu time spent per second of rendered audio
+ *  - a stress pass starting and stopping all five channels at once
+ *  - resampler output samples per second on one core, per quality level
+ *  - float to s16 conversion samples per second on one core, simd and scalar
+ *  - constant gain and gain ramps samples per second on one core, simd and scalar
+ *  - DSP chain cost per sample of each stage, in ns and in cycles on x86
+ *  - IMA ADPCM decode samples per second on one core, against memcpy of s16
+ *  - voice pool: seconds of audio mixed per cpu second, 64 to 1024 voices
+ *  - emitters: 3D gains and Doppler per emitter on one core, simd and scalar,
+ *    and the voice pool mixing 64 to 1024 of them repositioned every ms
+ *  - output tap: channel thread time per block without and with a tap,
+ *    and how many blocks the tap recorded or dropped against a null fast port
+ *  - offline rendering: seconds of audio per wall second with one and five
+ *    channels, per channel and mixed, and whether two runs render the same
+ *  - sound bank: time to open a 40 MB bank and how much of it is resident
+ *
+ * usage: orbisAudioBench [-d ms per case] [-o out.json]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#if defined (__x86_64__) || defined (__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "orbisAudio.h"
+
+
+static unsigned int benchDurationMs = 100;
+
+static double benchNow(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// cheap deterministic pattern, the benchmark measures the library not the callback
+static void benchCallback(OrbisAudioSample *buf, unsigned int samples, void *userdata)
+{
+    unsigned int stereo = (unsigned int)(uintptr_t)userdata;
+    short *s = (short *)buf;
+
+    for(unsigned int i=0; i<samples * (stereo + 1); i++) s[i] = (short)(i * 37);
+}
+
+static void benchJsonHist(FILE *fp, const uint64_t *hist)
+{
+    fprintf(fp, "[");
+    for(int i=0; i<ORBISAUDIO_STATS_BUCKETS; i++) fprintf(fp, "%s%llu", i ? "," : "", (unsigned long long)hist[i]);
+    fprintf(fp, "]");
+}
+
+static int benchCase(FILE *fp, int first, int mixer, unsigned int samples, int format, unsigned int channels)
+{
+    uint64_t submitHist[ORBISAUDIO_STATS_BUCKETS];
+    uint64_t blocks = 0;
+    double wall, cpu, rendered;
+    OrbisAudioStats stats;
+
+    memset(submitHist, 0, sizeof(submitHist));
+
+    orbisAudioSetBackend(ORBISAUDIO_BACKEND_NULL_FAST, NULL);
+    if(orbisAudioInit() != 1) return -1;
+    if(mixer)
+    {
+        if(orbisAudioInitMixer(samples, 48000)) { orbisAudioFinish(); return -1; }
+        orbisAudioSetPacing(ORBISAUDIO_CHANNEL_MASTER, ORBISAUDIO_PACING_BLOCKING);
+    }
+
+    wall = benchNow(CLOCK_MONOTONIC);
+    cpu  = benchNow(CLOCK_PROCESS_CPUTIME_ID);
+
+    for(unsigned int c=0; c<channels; c++)
+    {
+        orbisAudioSetPacing(c, ORBISAUDIO_PACING_BLOCKING);
+        orbisAudioSetCallback(c, benchCallback, (void *)(uintptr_t)format);
+        orbisAudioResume(c);
+        if(orbisAudioInitChannel(c, samples, 48000, format)) { orbisAudioFinish(); return -1; }
+    }
+
+    usleep(benchDurationMs * 1000);
+    orbisAudioStop();
+
+    wall = benchNow(CLOCK_MONOTONIC) - wall;
+    cpu  = benchNow(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+
+    for(unsigned int c=0; c<channels; c++)
+    {
+        orbisAudioGetStats(c, &stats);
+        blocks += stats.blocksPlayed;
+        if(!mixer) for(int i=0; i<ORBISAUDIO_STATS_BUCKETS; i++) submitHist[i] += stats.submitHist[i];
+    }
+    if(mixer)
+    {
+        orbisAudioGetStats(ORBISAUDIO_CHANNEL_MASTER, &stats);
+        memcpy(submitHist, stats.submitHist, sizeof(submitHist));
+    }
+    orbisAudioFinish();
+
+    // seconds of audio rendered, summed over every channel
+    rendered = (double)blocks * samples / 48000;
+
+    fprintf(fp, "%s\n    {\"mode\":\"%s\",\"samples\":%u,\"format\":\"%s\",\"channels\":%u,"
+                "\"blocks_per_sec\":%.1f,\"cpu_sec_per_rendered_sec\":%.6f,\"submit_latency_log2us\":",
+            first ? "" : ",", mixer ? "mixer" : "threads", samples,
+            format == ORBISAUDIO_FORMAT_S16_STEREO ? "s16_stereo" : "s16_mono", channels,
+            blocks / wall, rendered > 0 ? cpu / rendered : 0.0);
+    benchJsonHist(fp, submitHist);
+    fprintf(fp, "}");
+
+    return 0;
+}
+
+static void *benchStressStart(void *arg)
+{
+    unsigned int c = (unsigned int)(uintptr_t)arg;
+
+    orbisAudioSetPacing(c, ORBISAUDIO_PACING_BLOCKING);
+    orbisAudioSetCallback(c, benchCallback, (void *)(uintptr_t)ORBISAUDIO_FORMAT_S16_STEREO);
+    orbisAudioResume(c);
+    return (void *)(intptr_t)orbisAudioInitChannel(c, 256, 48000, ORBISAUDIO_FORMAT_S16_STEREO);
+}
+
+static void *benchStressStop(void *arg)
+{
+    return (void *)(intptr_t)orbisAudioFinishChannel((unsigned int)(uintptr_t)arg);
+}
+
+// start and stop all five channels concurrently, every channel must have played
+static void benchStress(FILE *fp, unsigned int iterations)
+{
+    unsigned int failures = 0;
+    pthread_t threads[ORBISAUDIO_CHANNELS];
+    OrbisAudioStats stats;
+    void *ret;
+
+    orbisAudioSetBackend(ORBISAUDIO_BACKEND_NULL_FAST, NULL);
+    orbisAudioInit();
+
+    for(unsigned int it=0; it<iterations; it++)
+    {
+        for(unsigned int c=0; c<ORBISAUDIO_CHANNELS; c++) pthread_create(&threads[c], NULL, benchStressStart, (void *)(uintptr_t)c);
+        for(unsigned int c=0; c<ORBISAUDIO_CHANNELS; c++) { pthread_join(threads[c], &ret); if(ret) failures++; }
+
+        // give every channel up to a second to play its first block
+        for(unsigned int c=0; c<ORBISAUDIO_CHANNELS; c++)
+        {
+            unsigned int wait = 0;
+
+            orbisAudioGetStats(c, &stats);
+            while(stats.blocksPlayed == 0 && wait++ < 1000)
+            {
+                usleep(1000);
+                orbisAudioGetStats(c, &stats);
+            }
+            if(stats.blocksPlayed == 0) failures++;
+        }
+        for(unsigned int c=0; c<ORBISAUDIO_CHANNELS; c++) pthread_create(&threads[c], NULL, benchStressStop, (void *)(uintptr_t)c);
+        for(unsigned int c=0; c<ORBISAUDIO_CHANNELS; c++) { pthread_join(threads[c], &ret); if(ret) failures++; }
+    }
+    orbisAudioFinish();
+
+    fprintf(fp, "  \"stress\": {\"iterations\":%u,\"failures\":%u}", iterations, failures);
+}
+
+static void benchResamplerPull(short *buf, unsigned int frames, void *ctx)
+{
+    benchCallback((OrbisAudioSample *)buf, frames, (void *)(uintptr_t)ORBISAUDIO_FORMAT_S16_STEREO);
+}
+
+// runs on the calling thread only, so the rate is per core
+static void benchResampler(FILE *fp)
+{
+    static const char *names[] = { "fast", "medium", "best" };
+    static const unsigned int rates[] = { 44100, 32000, 22050 };
+    static short out[1024 * 2];
+    int first = 1;
+
+    fprintf(fp, "  \"resampler\": [");
+    for(int q=ORBISAUDIO_RESAMPLE_FAST; q<=ORBISAUDIO_RESAMPLE_BEST; q++)
+    for(unsigned int r=0; r<sizeof(rates)/sizeof(rates[0]); r++)
+    {
+        OrbisAudioResampler *rs = orbisAudioResamplerCreate(rates[r], 48000, 2, q, 1024);
+        unsigned long frames = 0;
+        double start = benchNow(CLOCK_THREAD_CPUTIME_ID), elapsed;
+
+        do
+        {
+            orbisAudioResamplerProcess(rs, out, 1024, benchResamplerPull, NULL);
+            frames += 1024;
+            elapsed = benchNow(CLOCK_THREAD_CPUTIME_ID) - start;
+        } while(elapsed * 1000 < benchDurationMs);
+        orbisAudioResamplerDestroy(rs);
+
+        fprintf(fp, "%s\n    {\"quality\":\"%s\",\"in_rate\":%u,\"out_rate\":48000,\"channels\":2,\"samples_per_sec_per_core\":%.0f}",
+                first ? "" : ",", names[q], rates[r], frames / elapsed);
+        first = 0;
+    }
+    fprintf(fp, "\n  ],\n");
+}
+
+// float to s16 with dither, interleaved and planar, SIMD kernels against their scalar reference
+static void benchConvert(FILE *fp)
+{
+    static const char *names[] = { "f32", "f32_ref", "f32_planar", "f32_planar_ref" };
+    static float in[2048 * 2];
+    static short out[2048 * 2];
+    uint32_t dither[8];
+
+    for(unsigned int i=0; i<2048 * 2; i++) in[i] = (float)((int)(i * 37 % 2001) - 1000) / 1000;
+    for(unsigned int k=0; k<8; k++) dither[k] = k + 1;
+
+    fprintf(fp, "  \"convert\": [");
+    for(int k=0; k<4; k++)
+    {
+        unsigned long samples = 0;
+        double start = benchNow(CLOCK_THREAD_CPUTIME_ID), elapsed;
+
+        do
+        {
+            switch(k)
+            {
+                case 0: orbisAudioConvertF32ToS16      (out, in, 2048 * 2, dither); break;
+                case 1: orbisAudioConvertF32ToS16Ref   (out, in, 2048 * 2, dither); break;
+                case 2: orbisAudioInterleaveF32ToS16   (out, in, in + 2048, 2048, dither); break;
+                case 3: orbisAudioInterleaveF32ToS16Ref(out, in, in + 2048, 2048, dither); break;
+            }
+            samples += 2048 * 2;
+            elapsed = benchNow(CLOCK_THREAD_CPUTIME_ID) - start;
+        } while(elapsed * 1000 < benchDurationMs);
+
+        fprintf(fp, "%s\n    {\"kernel\":\"%s\",\"samples_per_sec_per_core\":%.0f}", k ? "," : "", names[k], samples / elapsed);
+    }
+    fprintf(fp, "\n  ],\n");
+}
+
+// constant gain and per sample gain ramps on stereo blocks, SIMD against the scalar reference
+static void benchGain(FILE *fp)
+{
+    static const char *names[] = { "gain", "gain_ref", "gain_ramp", "gain_ramp_ref" };
+    static short buf[2048 * 2];
+
+    for(unsigned int i=0; i<2048 * 2; i++) buf[i] = (short)((int)(i * 37 % 2001) - 1000) * 16;
+
+    fprintf(fp, "  \"gain\": [");
+    for(int k=0; k<4; k++)
+    {
+        unsigned long samples = 0;
+        double start = benchNow(CLOCK_THREAD_CPUTIME_ID), elapsed;
+
+        do
+        {
+            switch(k)
+            {
+                case 0: orbisAudioGainS16       (buf, buf, 2048, 1, 32000, 31000); break;
+                case 1: orbisAudioGainS16Ref    (buf, buf, 2048, 1, 32000, 31000); break;
+                case 2: orbisAudioGainRampS16   (buf, buf, 2048, 1, 32768, 32768, 30000, 31000); break;
+                case 3: orbisAudioGainRampS16Ref(buf, buf, 2048, 1, 32768, 32768, 30000, 31000); break;
+            }
+            samples += 2048 * 2;
+            elapsed = benchNow(CLOCK_THREAD_CPUTIME_ID) - start;
+        } while(elapsed * 1000 < benchDurationMs);
+
+        fprintf(fp, "%s\n    {\"kernel\":\"%s\",\"samples_per_sec_per_core\":%.0f}", k ? "," : "", names[k], samples / elapsed);
+    }
+    fprintf(fp, "\n  ],\n");
+}
+
+static uint64_t benchCycles(void)
+{
+#if defined (__x86_64__) || defined (__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// one stereo chain per stage on 256 frame blocks, then all of them together; every
+// case refills its block, bypass is that refill alone
+static void benchDsp(FILE *fp)
+{
+    static const char *names[] = { "bypass", "dc_block", "eq_1_band", "eq_4_bands", "eq_8_bands", "limiter", "chain" };
+    static short buf[256 * 2];
+
+    fprintf(fp, "  \"dsp\": [");
+    for(int k=0; k<7; k++)
+    {
+        OrbisAudioDsp *dsp = orbisAudioDspCreate(48000, 2, 256);
+        unsigned int bands = k == 2 ? 1 : k == 3 ? 4 : k == 4 || k == 6 ? ORBISAUDIO_DSP_BANDS : 0;
+        unsigned long samples = 0;
+        uint64_t cycles;
+        double start, elapsed;
+
+        for(unsigned int b=0; b<bands; b++) orbisAudioDspSetEq(dsp, b, ORBISAUDIO_EQ_PEAK, 60.0f * (b + 1) * (b + 1), 3.0f, 1.0f);
+        if(k == 1 || k == 6) orbisAudioDspSetDcBlock(dsp, 1);
+        if(k == 5 || k == 6) orbisAudioDspSetLimiter(dsp, 1, -3.0f, 50.0f);
+        if(k == 0) orbisAudioDspSetBypass(dsp, 1);
+
+        start  = benchNow(CLOCK_THREAD_CPUTIME_ID);
+        cycles = benchCycles();
+        do
+        {
+            for(unsigned int i=0; i<256 * 2; i++) buf[i] = (short)(((int)(i * 37 % 2001) - 1000) * 30);
+            orbisAudioDspProcess(dsp, buf, 256);
+            samples += 256 * 2;
+            elapsed = benchNow(CLOCK_THREAD_CPUTIME_ID) - start;
+        } while(elapsed * 1000 < benchDurationMs);
+        cycles = benchCycles() - cycles;
+        orbisAudioDspDestroy(dsp);
+
+        fprintf(fp, "%s\n    {\"stage\":\"%s\",\"ns_per_sample\":%.3f,\"cycles_per_sample\":%.2f}",
+                k ? "," : "", names[k], elapsed * 1e9 / samples, (double)cycles / samples);
+    }
+    fprintf(fp, "\n  ],\n");
+}
+
+// ADPCM decode of a 2 s sound against copying the same sound as plain s16
+static void benchAdpcm(FILE *fp)
+{
+    enum { FRAMES = 96000 };
+    static short pcm[FRAMES * 2], out[FRAMES * 2];
+    static uint8_t adpcm[FRAMES * 2];
+    OrbisAudioSound sound = { .data = (const short *)adpcm, .frames = FRAMES, .frequency = 48000, .encoding = ORBISAUDIO_ENCODING_ADPCM };
+
+    for(unsigned int i=0; i<FRAMES * 2; i++) pcm[i] = (short)((int)(i * 37 % 2001) - 1000) * 8;
+
+    fprintf(fp, "  \"adpcm\": [");
+    for(unsigned int k=0; k<4; k++)
+    {
+        unsigned long samples = 0;
+        double start, elapsed;
+
+        sound.channels = k / 2 + 1;
+        orbisAudioAdpcmEncode(adpcm, pcm, FRAMES, sound.channels);
+
+        start = benchNow(CLOCK_THREAD_CPUTIME_ID);
+        do
+        {
+            if(k & 1) memcpy(out, pcm, FRAMES * sound.channels * sizeof(short));
+            else      orbisAudioAdpcmDecode(out, &sound, 0, FRAMES);
+            samples += FRAMES * sound.channels;
+            elapsed = benchNow(CLOCK_THREAD_CPUTIME_ID) - start;
+        } while(elapsed * 1000 < benchDurationMs);
+
+        fprintf(fp, "%s\n    {\"kernel\":\"%s\",\"channels\":%u,\"bytes_per_sample\":%.3f,\"samples_per_sec_per_core\":%.0f}", k ? "," : "",
+                (k & 1) ? "memcpy" : "adpcm", sound.channels,
+                (k & 1) ? 2.0 : (double)orbisAudioAdpcmBytes(FRAMES, sound.channels) / (FRAMES * sound.channels), samples / elapsed);
+    }
+    fprintf(fp, "\n  ],\n");
+}
+
+/*
+ * Voice pool on one channel thread, every voice looping at its own pitch so
+ * the interpolating path is measured. realtime_factor above 1 means the
+ * voices fit on one core at 48 kHz.
+ */
+static void benchVoices(FILE *fp)
+{
+    static const unsigned int counts[] = { 64, 256, 1024 };
+    static short tone[4800 * 2];
+    OrbisAudioSound sounds[2];
+    OrbisAudioStats stats;
+
+    for(unsigned int i=0; i<4800 * 2; i++) tone[i] = (short)((int)(i * 37 % 2001) - 1000);
+    sounds[0] = (OrbisAudioSound){ .data = tone, .frames = 4800 * 2, .frequency = 44100, .channels = 1 };
+    sounds[1] = (OrbisAudioSound){ .data = tone, .frames = 4800,     .frequency = 48000, .channels = 2 };
+
+    fprintf(fp, "  \"voices\": [");
+    for(unsigned int k=0; k<sizeof(counts)/sizeof(counts[0]); k++)
+    {
+        double cpu, rendered;
+        uint64_t blocks;
+        clockid_t clock;
+
+        orbisAudioSetBackend(ORBISAUDIO_BACKEND_NULL_FAST, NULL);
+        orbisAudioInit();
+        orbisAudioSetPacing(0, ORBISAUDIO_PACING_BLOCKING);
+        orbisAudioResume(0);
+        orbisAudioInitChannel(0, 1024, 48000, ORBISAUDIO_FORMAT_S16_STEREO);
+        orbisAudioInitVoices(0, counts[k]);
+        for(unsigned int v=0; v<counts[k]; v++)
+            orbisAudioVoicePlay(0, &sounds[v & 1], 0.05f, (float)(v % 17) / 8 - 1, 0.75f + (float)(v % 11) / 20, 1);
+
+        // measure the channel thread alone, once it has picked up every voice
+        usleep(10000);
+        pthread_getcpuclockid(orbisAudioGetConf()->channels[0]->threadHandle, &clock);
+        orbisAudioGetStats(0, &stats);
+        blocks = stats.blocksPlayed;
+        cpu    = benchNow(clock);
+
+        usleep(benchDurationMs * 1000);
+
+        cpu = benchNow(clock) - cpu;
+        orbisAudioGetStats(0, &stats);
+        orbisAudioFinish();
+
+        rendered = (double)(stats.blocksPlayed - blocks) * 1024 / 48000;
+        fprintf(fp, "%s\n    {\"voices\":%u,\"realtime_factor\":%.2f}", k ? "," : "", counts[k], cpu > 0 ? rendered / cpu : 0.0);
+    }
+    fprintf(fp, "\n  ],\n");
+}
+
+// emitters on a circle around the listener, turning a little every call
+static void benchEmitterPlace(float *x, float *y, float *z, float *vx, float *vy, float *vz, unsigned int count, float t)
+{
+    for(unsigned int i=0; i<count; i++)
+    {
+        float a = t + i * 0.37f, r = 2.0f + (i % 13);
+
+        x[i]  = r * cosf(a);   y[i]  = (float)(i % 5) - 2;  z[i]  = r * sinf(a);
+        vx[i] = -r * sinf(a);  vy[i] = 0.0f;                vz[i] = r * cosf(a);
+    }
+}
+
+static void benchEmitters(FILE *fp)
+{
+    static const unsigned int counts[] = { 64, 256, 1024 };
+    static float x[1024], y[1024], z[1024], vx[1024], vy[1024], vz[1024], gainL[1024], gainR[1024], pitch[1024];
+    static short tone[4800];
+    static int voices[1024];
+    OrbisAudioListener listener = { {0, 0, 0}, {1, 0, 0}, {0, 0, -1}, {0, 1, 0}, 1.0f, 50.0f, 1.0f, 343.0f };
+    OrbisAudioSound sound;
+    OrbisAudioStats stats;
+    int first = 1;
+
+    for(unsigned int i=0; i<4800; i++) tone[i] = (short)((int)(i * 37 % 2001) - 1000);
+    sound = (OrbisAudioSound){ .data = tone, .frames = 4800, .frequency = 48000, .channels = 1 };
+
+    fprintf(fp, "  \"emitters\": [");
+    for(unsigned int k=0; k<sizeof(counts)/sizeof(counts[0]); k++)
+    {
+        OrbisAudioEmitters e = { voices, x, y, z, vx, vy, vz, NULL, NULL, counts[k] };
+        double ns[2], cpu, rendered, start, elapsed;
+        unsigned long updates = 0;
+        uint64_t blocks;
+        clockid_t clock;
+
+        benchEmitterPlace(x, y, z, vx, vy, vz, counts[k], 0.0f);
+        for(int ref=0; ref<2; ref++)
+        {
+            unsigned long n = 0;
+
+            start = benchNow(CLOCK_THREAD_CPUTIME_ID);
+            do
+            {
+                if(ref) orbisAudioEmitterComputeRef(&listener, &e, gainL, gainR, pitch);
+                else    orbisAudioEmitterCompute   (&listener, &e, gainL, gainR, pitch);
+                n += counts[k];
+                elapsed = benchNow(CLOCK_THREAD_CPUTIME_ID) - start;
+            } while(elapsed * 1000 < benchDurationMs);
+            ns[ref] = elapsed * 1e9 / n;
+        }
+
+        // the whole path: a 1 kHz game loop moving every emitter, the channel thread mixing them
+        orbisAudioSetBackend(ORBISAUDIO_BACKEND_NULL_FAST, NULL);
+        orbisAudioInit();
+        orbisAudioSetPacing(0, ORBISAUDIO_PACING_BLOCKING);
+        orbisAudioResume(0);
+        orbisAudioInitChannel(0, 1024, 48000, ORBISAUDIO_FORMAT_S16_STEREO);
+        orbisAudioInitVoices(0, counts[k]);
+        for(unsigned int v=0; v<counts[k]; v++) voices[v] = orbisAudioVoicePlay(0, &sound, 0.05f, 0.0f, 1.0f, 1);
+
+        usleep(10000);
+        pthread_getcpuclockid(orbisAudioGetConf()->channels[0]->threadHandle, &clock);
+        orbisAudioGetStats(0, &stats);
+        blocks = stats.blocksPlayed;
+        cpu    = benchNow(clock);
+        start  = benchNow(CLOCK_MONOTONIC);
+        elapsed = 0.0;
+
+        do
+        {
+            double t = benchNow(CLOCK_THREAD_CPUTIME_ID);
+
+            benchEmitterPlace(x, y, z, vx, vy, vz, counts[k], updates * 0.001f);
+            orbisAudioEmitterUpdate(0, &listener, &e);
+            elapsed += benchNow(CLOCK_THREAD_CPUTIME_ID) - t;
+            updates++;
+            usleep(1000);
+        } while((benchNow(CLOCK_MONOTONIC) - start) * 1000 < benchDurationMs);
+
+        cpu = benchNow(clock) - cpu;
+        orbisAudioGetStats(0, &stats);
+        orbisAudioFinish();
+
+        rendered = (double)(stats.blocksPlayed - blocks) * 1024 / 48000;
+        fprintf(fp, "%s\n    {\"emitters\":%u,\"compute_ns_per_emitter\":%.2f,\"compute_ref_ns_per_emitter\":%.2f,\"update_us\":%.2f,\"realtime_factor\":%.2f}",
+                first ? "" : ",", counts[k], ns[0], ns[1], elapsed * 1e6 / updates, cpu > 0 ? rendered / cpu : 0.0);
+        first = 0;
+    }
+    fprintf(fp, "\n  ],\n");
+}
+
+// discards what the tap hands over, the writer keeps up as well as it can
+static void benchTapSink(const short *buf, unsigned int frames, unsigned int channels, void *userdata)
+{
+    *(volatile short *)userdata = buf[0];
+}
+
+static void benchTap(FILE *fp)
+{
+    static volatile short last;
+    OrbisAudioStats stats;
+
+    fprintf(fp, "  \"tap\": [");
+    for(int tap=0; tap<2; tap++)
+    {
+        double cpu;
+        uint64_t blocks, recorded, dropped;
+        clockid_t clock;
+
+        orbisAudioSetBackend(ORBISAUDIO_BACKEND_NULL_FAST, NULL);
+        orbisAudioInit();
+        orbisAudioSetPacing(0, ORBISAUDIO_PACING_BLOCKING);
+        orbisAudioSetCallback(0, benchCallback, (void *)(uintptr_t)ORBISAUDIO_FORMAT_S16_STEREO);
+        orbisAudioResume(0);
+        orbisAudioInitChannel(0, ORBISAUDIO_MIN_LEN, 48000, ORBISAUDIO_FORMAT_S16_STEREO);
+        if(tap) orbisAudioTapOpenSink(0, benchTapSink, (void *)&last, 64);
+
+        // the channel thread alone: render and submit, plus handing blocks to the tap
+        usleep(10000);
+        pthread_getcpuclockid(orbisAudioGetConf()->channels[0]->threadHandle, &clock);
+        orbisAudioGetStats(0, &stats);
+        blocks   = stats.blocksPlayed;
+        recorded = stats.tapBlocks;
+        dropped  = stats.tapDropped;
+        cpu      = benchNow(clock);
+
+        usleep(benchDurationMs * 1000);
+
+        cpu = benchNow(clock) - cpu;
+        orbisAudioGetStats(0, &stats);
+        orbisAudioFinish();
+
+        blocks = stats.blocksPlayed - blocks;
+        fprintf(fp, "%s\n    {\"tap\":%d,\"samples\":%u,\"ns_per_block\":%.1f,\"tap_blocks\":%llu,\"tap_dropped\":%llu}",
+                tap ? "," : "", tap, ORBISAUDIO_MIN_LEN, blocks ? cpu * 1e9 / blocks : 0.0,
+                (unsigned long long)(stats.tapBlocks - recorded), (unsigned long long)(stats.tapDropped - dropped));
+    }
+    fprintf(fp, "\n  ],\n");
+}
+
+// FNV-1a over everything rendered offline, per run
+static void benchOfflineSink(unsigned int channel, const short *buf, unsigned int frames, unsigned int channels, void *userdata)
+{
+    uint64_t *hash = (uint64_t *)userdata;
+
+    for(unsigned int i=0; i<frames * channels; i++) *hash = (*hash ^ (uint16_t)buf[i]) * 1099511628211ull;
+}
+
+static uint64_t benchOfflineRun(int mixer, unsigned int channels, double seconds, double *wall)
+{
+    uint64_t hash = 14695981039346656037ull;
+
+    orbisAudioSetBackend(ORBISAUDIO_BACKEND_OFFLINE, NULL);
+    orbisAudioInit();
+    if(mixer) orbisAudioInitMixer(ORBISAUDIO_MIN_LEN, 48000);
+    for(unsigned int c=0; c<channels; c++)
+    {
+        orbisAudioSetCallback(c, benchCallback, (void *)(uintptr_t)ORBISAUDIO_FORMAT_S16_STEREO);
+        orbisAudioResume(c);
+        orbisAudioInitChannel(c, ORBISAUDIO_MIN_LEN, 48000, ORBISAUDIO_FORMAT_S16_STEREO);
+    }
+
+    *wall = benchNow(CLOCK_MONOTONIC);
+    orbisAudioRenderOffline(seconds, benchOfflineSink, &hash);
+    *wall = benchNow(CLOCK_MONOTONIC) - *wall;
+    orbisAudioFinish();
+
+    return hash;
+}
+
+// the whole pipeline on the calling thread, seconds of audio per wall second and whether two runs match
+static void benchOffline(FILE *fp)
+{
+    double seconds = benchDurationMs * 0.6;
+    int    first   = 1;
+
+    fprintf(fp, "  \"offline\": [");
+    for(int mixer=0; mixer<2; mixer++)
+    for(unsigned int channels=1; channels<=ORBISAUDIO_CHANNELS; channels+=ORBISAUDIO_CHANNELS-1)
+    {
+        double   wall, wall2;
+        uint64_t hash  = benchOfflineRun(mixer, channels, seconds, &wall);
+        uint64_t hash2 = benchOfflineRun(mixer, channels, seconds, &wall2);
+
+        fprintf(fp, "%s\n    {\"mode\":\"%s\",\"channels\":%u,\"seconds\":%.1f,\"realtime_factor\":%.1f,\"deterministic\":%s}",
+                first ? "" : ",", mixer ? "mixer" : "per_channel", channels, seconds, wall > 0 ? seconds / wall : 0.0, hash == hash2 ? "true" : "false");
+        first = 0;
+    }
+    fprintf(fp, "\n  ],\n");
+}
+
+static size_t benchResident(const void *addr, size_t bytes)
+{
+    size_t page = sysconf(_SC_PAGESIZE), skip = (uintptr_t)addr & (page - 1);
+    size_t pages = (bytes + skip + page - 1) / page, resident = 0;
+    unsigned char *vec = malloc(pages);
+
+    if(vec && mincore((uint8_t *)addr - skip, bytes + skip, vec) == 0)
+        for(size_t i=0; i<pages; i++) resident += vec[i] & 1;
+    free(vec);
+
+    return resident * page;
+}
+
+/*
+ * Sound bank of 400 sounds of 100 KB each: time for orbisAudioBankOpen, and
+ * the bytes resident after opening, after touching one sound and after a
+ * prefetch. The file is dropped from the page cache first where allowed, so
+ * resident counts the pages actually brought in.
+ */
+static void benchBank(FILE *fp)
+{
+    enum { COUNT = 400, BYTES = 100 * 1024 };
+    char path[] = "/tmp/orbisAudioBenchXXXXXX";
+    OrbisAudioBankHeader header = { .magic = ORBISAUDIO_BANK_MAGIC, .version = ORBISAUDIO_BANK_VERSION, .count = COUNT, .indexOffset = sizeof(header) };
+    OrbisAudioBankEntry entry = { .bytes = BYTES, .frames = BYTES / 4, .frequency = 48000, .channels = 2 };
+    static short pcm[BYTES / 2];
+    const OrbisAudioSound *snd;
+    OrbisAudioBank *bank;
+    size_t opened, touched, prefetched;
+    double start, elapsed;
+    volatile long sum = 0;  // keeps the reads that fault the pages in
+    FILE *f;
+    int fd;
+
+    fd = mkstemp(path);
+    f  = fd < 0 ? NULL : fdopen(fd, "wb");
+    if(!f) return;
+
+    header.size = sizeof(header) + COUNT * sizeof(entry) + (uint64_t)COUNT * BYTES;
+    fwrite(&header, sizeof(header), 1, f);
+    for(unsigned int i=0; i<COUNT; i++)
+    {
+        snprintf(entry.name, sizeof(entry.name), "sfx%u", i);
+        entry.offset = sizeof(header) + COUNT * sizeof(entry) + (uint64_t)i * BYTES;
+        fwrite(&entry, sizeof(entry), 1, f);
+    }
+    for(unsigned int i=0; i<BYTES / 2; i++) pcm[i] = (short)(i * 37);
+    for(unsigned int i=0; i<COUNT; i++) fwrite(pcm, BYTES, 1, f);
+    fflush(f);
+    fsync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    fclose(f);
+
+    start   = benchNow(CLOCK_MONOTONIC);
+    bank    = orbisAudioBankOpen(path);
+    elapsed = benchNow(CLOCK_MONOTONIC) - start;
+    unlink(path);
+    if(!bank) return;
+
+    snd    = orbisAudioBankSound(bank, 0);
+    opened = benchResident(snd->data, (size_t)COUNT * BYTES);
+    snd    = orbisAudioBankSound(bank, orbisAudioBankFind(bank, "sfx200"));
+    for(unsigned int i=0; i<snd->frames * 2; i++) sum += snd->data[i];
+    touched = benchResident(orbisAudioBankSound(bank, 0)->data, (size_t)COUNT * BYTES);
+    orbisAudioBankPrefetch(bank, 300);
+    prefetched = benchResident(orbisAudioBankSound(bank, 0)->data, (size_t)COUNT * BYTES);
+    orbisAudioBankClose(bank);
+
+    fprintf(fp, "  \"bank\": {\"sounds\":%u,\"bytes\":%llu,\"open_us\":%.1f,\"resident_open\":%zu,\"resident_one_played\":%zu,\"resident_one_prefetched\":%zu},\n",
+            COUNT, (unsigned long long)header.size, elapsed * 1e6, opened, touched, prefetched);
+}
+
+int main(int argc, char **argv)
+{
+    const char *out = "bench.json";
+    int opt, first = 1;
+    FILE *fp;
+
+    while((opt = getopt(argc, argv, "d:o:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'd': benchDurationMs = atoi(optarg); break;
+            case 'o': out = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-d ms per case] [-o out.json]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    fp = fopen(out, "w");
+    if(!fp) { perror(out); return 1; }
+
+    fprintf(fp, "{\n  \"duration_ms\": %u,\n  \"throughput\": [", benchDurationMs);
+    for(int mixer=0; mixer<2; mixer++)
+    for(unsigned int samples=ORBISAUDIO_MIN_LEN; samples<=ORBISAUDIO_MAX_LEN; samples+=ORBISAUDIO_MIN_LEN)
+    for(int format=ORBISAUDIO_FORMAT_S16_MONO; format<=ORBISAUDIO_FORMAT_S16_STEREO; format++)
+    for(unsigned int channels=1; channels<=ORBISAUDIO_CHANNELS; channels++)
+    {
+        if(benchCase(fp, first, mixer, samples, format, channels))
+        {
+            fprintf(stderr, "case %s/%u/%d/%u failed\n", mixer ? "mixer" : "threads", samples, format, channels);
+            fclose(fp);
+            return 1;
+        }
+        first = 0;
+    }
+    fprintf(fp, "\n  ],\n");
+
+    benchResampler(fp);
+    benchConvert(fp);
+    benchGain(fp);
+    benchDsp(fp);
+    benchAdpcm(fp);
+    benchVoices(fp);
+    benchEmitters(fp);
+    benchTap(fp);
+    benchOffline(fp);
+    benchBank(fp);
+    benchStress(fp, 20);
+    fprintf(fp, "\n}\n");
+    fclose(fp);
+
+    return 0;
+}
@@ -0,0 +1,670 @@
+/*
+#  ____   ____    ____         ___ ____   ____ _     _
+# |    |  ____>   ____>  |    |        | <____  \   /
+# |____| |    \   ____>  | ___|    ____| <____   \_/    ORBISDEV Open Source Project.
+#------------------------------------------------------------------------------------
+# Copyright 2010-2020, orbisdev - http://orbisdev.github.io
+# Licenced under the MIT license
+# Review README & LICENSE files for further details.
+*/
+
+/*
+ * Kernel check: every SIMD sample kernel against its scalar reference, on
+ * random data and on saturation edges (full scale samples, unity and above
+ * unity gains, floats beyond +-1, NaN), at every length up to a few vectors
+ * and from unaligned offsets so the tails are covered too. The s16 kernels
+ * and the float conversions must match bit for bit, dither state included;
+ * emitters within float rounding. The resampler is run on ratios whose
+ * step is longer than its filter, which must skip input rather than run
+ * off its history. Channel volume, ramps, pause and crossfade are rendered
+ * through the offline backend and their levels and slopes checked. ADPCM
+ * must decode close to what was encoded, and from any seek exactly as a
+ * decode from the start does. A scene of callbacks, voices, a stream and
+ * DSP is rendered twice, with and without the mixer, and must give the
+ * same samples. Prints each mismatch and exits non zero.
+ *
+ * usage: orbisAudioCheck [-s seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "orbisAudio.h"
+#include "orbisAudioInternal.h"
+
+
+#define CHECK_MAX		1100 // frames, longest case
+#define CHECK_ROUNDS	64   // random fills per kernel
+
+static uint32_t checkSeed = 0x2545f491;
+static unsigned int checkFailures;
+
+static uint32_t checkRand(void)
+{
+    checkSeed ^= checkSeed << 13;
+    checkSeed ^= checkSeed >> 17;
+    checkSeed ^= checkSeed << 5;
+    return checkSeed;
+}
+
+// lengths: every one up to 72 then a few long ones, so each vector width meets every tail
+static unsigned int checkLength(unsigned int k)
+{
+    static const unsigned int longer[] = { 127, 128, 129, 255, 256, 1023, 1024, 1025 };
+    return k < 73 ? k : longer[(k - 73) % (sizeof(longer)/sizeof(longer[0]))];
+}
+#define CHECK_LENGTHS	(73 + 8)
+
+// random samples, one in four from the rails and around zero when edges is set
+static void checkFillS16(short *buf, unsigned int count, int edges)
+{
+    static const short edge[] = { 32767, -32768, 32766, -32767, 0, 1, -1 };
+
+    for(unsigned int i=0; i<count; i++)
+    {
+        uint32_t x = checkRand();
+        buf[i] = (edges && (x & 3) == 0) ? edge[(x >> 2) % (sizeof(edge)/sizeof(edge[0]))] : (short)(x >> 16);
+    }
+}
+
+// mostly [-1, 1], with values past the rails, exact rails and NaN when edges is set
+static void checkFillF32(float *buf, unsigned int count, int edges)
+{
+    static const float edge[] = { 1.0f, -1.0f, 1.5f, -1.5f, 1.00002f, -1.00002f, 0.0f, 100.0f, -100.0f };
+
+    for(unsigned int i=0; i<count; i++)
+    {
+        uint32_t x = checkRand();
+        if(edges && (x & 3) == 0) buf[i] = (x & 0x3f0) == 0 ? NAN : edge[(x >> 2) % (sizeof(edge)/sizeof(edge[0]))];
+        else buf[i] = (float)(int32_t)x * (1.0f / 2147483648.0f);
+    }
+}
+
+// gains around the Q15 cases the kernels special case: 0, unity and over unity
+static unsigned int checkGain(void)
+{
+    static const unsigned int edge[] = { 0, 1, 16384, 32767, ORBISAUDIO_VOLUME_MAX, ORBISAUDIO_VOLUME_MAX + 1, 65535 };
+    uint32_t x = checkRand();
+
+    return (x & 1) ? edge[(x >> 1) % (sizeof(edge)/sizeof(edge[0]))] : (x >> 8) % (ORBISAUDIO_VOLUME_MAX + 1);
+}
+
+static int checkS16(const char *name, const short *a, const short *b, unsigned int count, unsigned int frames)
+{
+    for(unsigned int i=0; i<count; i++)
+    {
+        if(a[i] == b[i]) continue;
+        printf("%s: frames %u, sample %u: simd %d ref %d\n", name, frames, i, a[i], b[i]);
+        checkFailures++;
+        return 1;
+    }
+    return 0;
+}
+
+static int checkBits(const char *name, const void *a, const void *b, size_t bytes, unsigned int frames)
+{
+    if(!memcmp(a, b, bytes)) return 0;
+    printf("%s: frames %u differ\n", name, frames);
+    checkFailures++;
+    return 1;
+}
+
+static int checkNear(const char *name, const float *a, const float *b, unsigned int count, float tolerance)
+{
+    for(unsigned int i=0; i<count; i++)
+    {
+        if(fabsf(a[i] - b[i]) <= tolerance * fmaxf(1.0f, fabsf(b[i]))) continue;
+        printf("%s: %u of %u: simd %g ref %g\n", name, i, count, a[i], b[i]);
+        checkFailures++;
+        return 1;
+    }
+    return 0;
+}
+
+static void checkMix(void)
+{
+    static short src[2*CHECK_MAX + 8], base[2*CHECK_MAX + 8], a[2*CHECK_MAX + 8], b[2*CHECK_MAX + 8];
+
+    for(unsigned int k=0; k<CHECK_LENGTHS; k++)
+    {
+        unsigned int n   = checkLength(k);
+        unsigned int off = k & 7;
+
+        for(int edges=0; edges<2; edges++)
+        {
+            checkFillS16(src, 2*CHECK_MAX + 8, edges);
+            checkFillS16(base, 2*CHECK_MAX + 8, edges);
+
+            memcpy(a, base, sizeof(a)); memcpy(b, base, sizeof(b));
+            orbisAudioMixS16(a + off, src + off, 2*n);
+            orbisAudioMixS16Ref(b + off, src + off, 2*n);
+            if(checkS16("MixS16", a, b, 2*CHECK_MAX + 8, n)) return;
+
+            memcpy(a, base, sizeof(a)); memcpy(b, base, sizeof(b));
+            orbisAudioMixMonoS16(a + off, src + off, n);
+            orbisAudioMixMonoS16Ref(b + off, src + off, n);
+            if(checkS16("MixMonoS16", a, b, 2*CHECK_MAX + 8, n)) return;
+        }
+    }
+}
+
+static void checkGains(void)
+{
+    static short src[2*CHECK_MAX + 8], a[2*CHECK_MAX + 8], b[2*CHECK_MAX + 8];
+
+    for(unsigned int round=0; round<CHECK_ROUNDS; round++)
+    {
+        for(unsigned int k=0; k<CHECK_LENGTHS; k++)
+        {
+            unsigned int n      = checkLength(k);
+            unsigned int off    = k & 7;
+            int          stereo = (round + k) & 1;
+            unsigned int l0 = checkGain(), r0 = checkGain(), l1 = checkGain(), r1 = checkGain();
+
+            checkFillS16(src, 2*CHECK_MAX + 8, round & 1);
+
+            memset(a, 0x55, sizeof(a)); memset(b, 0x55, sizeof(b));
+            orbisAudioGainS16(a + off, src + off, n, stereo, l0, r0);
+            orbisAudioGainS16Ref(b + off, src + off, n, stereo, l0, r0);
+            if(checkS16("GainS16", a, b, 2*CHECK_MAX + 8, n)) return;
+
+            memset(a, 0x55, sizeof(a)); memset(b, 0x55, sizeof(b));
+            orbisAudioGainRampS16(a + off, src + off, n, stereo, l0, r0, l1, r1);
+            orbisAudioGainRampS16Ref(b + off, src + off, n, stereo, l0, r0, l1, r1);
+            if(checkS16("GainRampS16", a, b, 2*CHECK_MAX + 8, n)) return;
+
+            // in place, the way the channel pipeline calls them
+            memcpy(a, src, sizeof(a));
+            orbisAudioGainRampS16(a + off, a + off, n, stereo, l0, r0, l1, r1);
+            orbisAudioGainRampS16Ref(src + off, src + off, n, stereo, l0, r0, l1, r1);
+            if(checkS16("GainRampS16 in place", a, src, 2*CHECK_MAX + 8, n)) return;
+        }
+    }
+}
+
+static void checkExpand(void)
+{
+    static short src[CHECK_MAX + 8], a[2*CHECK_MAX + 8], b[2*CHECK_MAX + 8];
+
+    for(unsigned int k=0; k<CHECK_LENGTHS; k++)
+    {
+        unsigned int n = checkLength(k);
+
+        checkFillS16(src, CHECK_MAX + 8, 1);
+        memset(a, 0x55, sizeof(a)); memset(b, 0x55, sizeof(b));
+        orbisAudioExpandMonoS16(a, src + (k & 7), n);
+        orbisAudioExpandMonoS16Ref(b, src + (k & 7), n);
+        if(checkS16("ExpandMonoS16", a, b, 2*CHECK_MAX + 8, n)) return;
+
+        // mono in the upper half of the stereo buffer
+        memcpy(a + n, src, n * sizeof(short));
+        orbisAudioExpandMonoS16(a, a + n, n);
+        orbisAudioExpandMonoS16Ref(b, src, n);
+        if(checkS16("ExpandMonoS16 in place", a, b, 2*n, n)) return;
+    }
+}
+
+static void checkConvert(void)
+{
+    static float l[CHECK_MAX + 8], r[CHECK_MAX + 8], src[2*CHECK_MAX + 8];
+    static short a[2*CHECK_MAX + 8], b[2*CHECK_MAX + 8];
+
+    for(unsigned int round=0; round<4; round++)
+    {
+        for(unsigned int k=0; k<CHECK_LENGTHS; k++)
+        {
+            unsigned int n   = checkLength(k);
+            unsigned int off = k & 7;
+            uint32_t da[8], db[8], *pa = NULL, *pb = NULL;
+
+            if(round & 2)
+            {
+                for(int i=0; i<8; i++) da[i] = db[i] = checkRand() | 1;
+                pa = da; pb = db;
+            }
+            checkFillF32(src, 2*CHECK_MAX + 8, round & 1);
+            checkFillF32(l, CHECK_MAX + 8, round & 1);
+            checkFillF32(r, CHECK_MAX + 8, round & 1);
+
+            memset(a, 0x55, sizeof(a)); memset(b, 0x55, sizeof(b));
+            orbisAudioConvertF32ToS16(a + off, src + off, 2*n, pa);
+            orbisAudioConvertF32ToS16Ref(b + off, src + off, 2*n, pb);
+            if(checkS16("ConvertF32ToS16", a, b, 2*CHECK_MAX + 8, n)) return;
+            if(pa && checkBits("ConvertF32ToS16 dither state", da, db, sizeof(da), n)) return;
+
+            memset(a, 0x55, sizeof(a)); memset(b, 0x55, sizeof(b));
+            orbisAudioInterleaveF32ToS16(a + off, l + off, r + off, n, pa);
+            orbisAudioInterleaveF32ToS16Ref(b + off, l + off, r + off, n, pb);
+            if(checkS16("InterleaveF32ToS16", a, b, 2*CHECK_MAX + 8, n)) return;
+            if(pa && checkBits("InterleaveF32ToS16 dither state", da, db, sizeof(da), n)) return;
+        }
+    }
+}
+
+static void checkDownmix(void)
+{
+    static short src[8*CHECK_MAX], a[8*CHECK_MAX], b[8*CHECK_MAX];
+    static float fsrc[8*CHECK_MAX], fa[8*CHECK_MAX], fb[8*CHECK_MAX];
+
+    for(unsigned int k=0; k<CHECK_LENGTHS; k++)
+    {
+        unsigned int n = checkLength(k);
+
+        for(int edges=0; edges<2; edges++)
+        {
+            checkFillS16(src, 8*CHECK_MAX, edges);
+            memset(a, 0x55, sizeof(a)); memset(b, 0x55, sizeof(b));
+            orbisAudioDownmix8S16(a, src, n);
+            orbisAudioDownmix8S16Ref(b, src, n);
+            if(checkS16("Downmix8S16", a, b, 8*CHECK_MAX, n)) return;
+
+            // in place
+            memcpy(a, src, sizeof(a));
+            orbisAudioDownmix8S16(a, a, n);
+            if(checkS16("Downmix8S16 in place", a, b, 2*n, n)) return;
+
+            // floats stay in range here, NaN never compares equal
+            checkFillF32(fsrc, 8*CHECK_MAX, 0);
+            if(edges) for(unsigned int i=0; i<8*CHECK_MAX; i+=3) fsrc[i] = (i & 1) ? 1.0f : -1.0f;
+            memset(fa, 0, sizeof(fa)); memset(fb, 0, sizeof(fb));
+            orbisAudioDownmix8F32(fa, fsrc, n);
+            orbisAudioDownmix8F32Ref(fb, fsrc, n);
+            if(checkBits("Downmix8F32", fa, fb, sizeof(fa), n)) return;
+
+            memcpy(fa, fsrc, sizeof(fa));
+            orbisAudioDownmix8F32(fa, fa, n);
+            if(checkBits("Downmix8F32 in place", fa, fb, 2*n*sizeof(float), n)) return;
+        }
+    }
+}
+
+static float checkUniform(float range)
+{
+    return ((float)(checkRand() >> 8) * (1.0f / 8388608.0f) - 0.5f) * 2.0f * range;
+}
+
+static void checkEmitters(void)
+{
+    static float x[CHECK_MAX], y[CHECK_MAX], z[CHECK_MAX], vx[CHECK_MAX], vy[CHECK_MAX], vz[CHECK_MAX], gain[CHECK_MAX], pitch[CHECK_MAX];
+    static float la[CHECK_MAX], ra[CHECK_MAX], pa[CHECK_MAX], lb[CHECK_MAX], rb[CHECK_MAX], pb[CHECK_MAX];
+    OrbisAudioListener listener = { {1, 2, 3}, {3, 0, -1}, {0, 0, -1}, {0, 1, 0}, 1.0f, 50.0f, 1.0f, 343.0f };
+
+    for(unsigned int k=0; k<CHECK_LENGTHS; k++)
+    {
+        unsigned int n = checkLength(k);
+        OrbisAudioEmitters e = { NULL, x, y, z, (k & 1) ? vx : NULL, (k & 1) ? vy : NULL, (k & 1) ? vz : NULL,
+                                 (k & 2) ? gain : NULL, (k & 2) ? pitch : NULL, n };
+
+        for(unsigned int i=0; i<n; i++)
+        {
+            x[i]  = checkUniform(80.0f);  y[i] = checkUniform(80.0f);   z[i] = checkUniform(80.0f);
+            vx[i] = checkUniform(400.0f); vy[i] = checkUniform(400.0f); vz[i] = checkUniform(400.0f);
+            gain[i] = checkUniform(1.0f) + 1.0f; pitch[i] = checkUniform(1.0f) + 1.5f;
+        }
+        // on top of the listener, where there is no direction
+        if(n > 1) { x[1] = listener.position[0]; y[1] = listener.position[1]; z[1] = listener.position[2]; }
+
+        orbisAudioEmitterCompute(&listener, &e, la, ra, pa);
+        orbisAudioEmitterComputeRef(&listener, &e, lb, rb, pb);
+        if(checkNear("EmitterCompute gainL", la, lb, n, 1e-5f)) return;
+        if(checkNear("EmitterCompute gainR", ra, rb, n, 1e-5f)) return;
+        if(checkNear("EmitterCompute pitch", pa, pb, n, 1e-5f)) return;
+    }
+}
+
+typedef struct CheckPull
+{
+    unsigned int channels;
+    uint64_t     frames;
+} CheckPull;
+
+// a constant level, counting the frames the resampler asked for
+static void checkPull(short *buf, unsigned int frames, void *ctx)
+{
+    CheckPull *p = (CheckPull *)ctx;
+
+    for(unsigned int i=0; i<frames * p->channels; i++) buf[i] = 10000;
+    p->frames += frames;
+}
+
+// downsampling by more than the filter is long: 12x on the 8 tap filter, 48x on the 32 tap one
+static void checkResampler(void)
+{
+    static const struct { unsigned int in, out, channels, block; int quality; } cases[] =
+    {
+        { 48000, 4000, 1, 256, ORBISAUDIO_RESAMPLE_FAST },
+        { 48000, 4000, 2, 16,  ORBISAUDIO_RESAMPLE_FAST },
+        { 192000, 4000, 2, 64, ORBISAUDIO_RESAMPLE_MEDIUM },
+    };
+    static short out[2 * 4000];
+
+    for(unsigned int k=0; k<sizeof(cases)/sizeof(cases[0]); k++)
+    {
+        OrbisAudioResampler *rs = orbisAudioResamplerCreate(cases[k].in, cases[k].out, cases[k].channels, cases[k].quality, cases[k].block);
+        CheckPull p = { cases[k].channels, 0 };
+        uint64_t expect = (uint64_t)cases[k].in * 4000 / cases[k].out;
+
+        if(!rs) { printf("Resampler %u -> %u: create failed\n", cases[k].in, cases[k].out); checkFailures++; continue; }
+        orbisAudioResamplerProcess(rs, out, 4000, checkPull, &p);
+        orbisAudioResamplerDestroy(rs);
+
+        // one second of output takes one second of input, give or take a block and the filter
+        if(p.frames + 2 * cases[k].block + 64 < expect || p.frames > expect + 2 * cases[k].block + 64)
+        {
+            printf("Resampler %u -> %u: pulled %llu frames for %llu\n", cases[k].in, cases[k].out, (unsigned long long)p.frames, (unsigned long long)expect);
+            checkFailures++;
+            continue;
+        }
+        for(unsigned int i=100 * cases[k].channels; i<4000 * cases[k].channels; i++)
+        {
+            if(abs(out[i] - 10000) <= 100) continue;
+            printf("Resampler %u -> %u: sample %u is %d, not the input level\n", cases[k].in, cases[k].out, i, out[i]);
+            checkFailures++;
+            break;
+        }
+    }
+}
+
+// left side of channel 0 as the offline backend renders it
+static short checkCapture[48000];
+static unsigned int checkCaptured;
+
+static void checkCaptureSink(unsigned int channel, const short *buf, unsigned int frames, unsigned int channels, void *userdata)
+{
+    if(channel != 0) return;
+    for(unsigned int i=0; i<frames && checkCaptured<sizeof(checkCapture)/sizeof(checkCapture[0]); i++) checkCapture[checkCaptured++] = buf[i * channels];
+}
+
+static void checkConstCallback(OrbisAudioSample *buf, unsigned int samples, void *userdata)
+{
+    short *s = (short *)buf;
+
+    for(unsigned int i=0; i<samples * 2; i++) s[i] = (short)(intptr_t)userdata;
+}
+
+/*
+ * Render seconds of channel 0 and check it moves towards end in one
+ * direction (dir +1 up, -1 down, 0 either), never by more than maxStep a
+ * sample, and finishes exactly on end.
+ */
+static void checkRenderLevel(const char *name, double seconds, int dir, int maxStep, int end)
+{
+    checkCaptured = 0;
+    orbisAudioRenderOffline(seconds, checkCaptureSink, NULL);
+
+    for(unsigned int i=1; i<checkCaptured; i++)
+    {
+        int step = checkCapture[i] - checkCapture[i-1];
+
+        if((dir > 0 && step < 0) || (dir < 0 && step > 0) || abs(step) > maxStep)
+        {
+            printf("%s: frame %u goes from %d to %d\n", name, i, checkCapture[i-1], checkCapture[i]);
+            checkFailures++;
+            return;
+        }
+    }
+    if(!checkCaptured || checkCapture[checkCaptured-1] != end)
+    {
+        printf("%s: ends on %d, not %d\n", name, checkCaptured ? checkCapture[checkCaptured-1] : 0, end);
+        checkFailures++;
+    }
+}
+
+// one channel of a constant 16384 callback, each control after the previous one settled
+static void checkControls(void)
+{
+    orbisAudioSetBackend(ORBISAUDIO_BACKEND_OFFLINE, NULL);
+    orbisAudioInit();
+    orbisAudioSetCallback(0, checkConstCallback, (void *)(intptr_t)16384);
+    orbisAudioResume(0);
+    orbisAudioInitChannel(0, 256, 48000, ORBISAUDIO_FORMAT_S16_STEREO);
+
+    // resume from the initial pause fades in over ORBISAUDIO_FADE_MS, 240 frames
+    checkRenderLevel("fade in", 0.05, 1, 2 * 16384 / 240 + 1, 16384);
+
+    // half volume over 10 ms: 8192 down in 480 frames
+    orbisAudioSetVolumeRamp(0, 10);
+    orbisAudioSetVolume(0, 16384, 16384);
+    checkRenderLevel("volume ramp", 0.05, -1, 2 * 8192 / 480 + 1, 8192);
+
+    orbisAudioPause(0);
+    checkRenderLevel("pause", 0.05, -1, 2 * 8192 / 240 + 1, 0);
+    checkRenderLevel("paused", 0.05, 0, 0, 0);
+
+    orbisAudioResume(0);
+    checkRenderLevel("resume", 0.05, 1, 2 * 8192 / 240 + 1, 8192);
+
+    // equal power over 20 ms to a -8000 callback, at the half volume still set
+    orbisAudioCrossfade(0, checkConstCallback, (void *)(intptr_t)-8000, 20);
+    checkRenderLevel("crossfade", 0.1, -1, 2 * (16384 + 8000) / 2 * 2 / 960 + 1, -4000);
+
+    orbisAudioFinish();
+}
+
+// saw on the left and its negation on the right, from a phase the scene resets every run
+static void checkSawCallback(OrbisAudioSample *buf, unsigned int samples, void *userdata)
+{
+    unsigned int *phase = (unsigned int *)userdata;
+    short        *s     = (short *)buf;
+
+    for(unsigned int i=0; i<samples; i++, (*phase)++)
+    {
+        s[2*i]   = (short)((*phase * 97) % 20000 - 10000);
+        s[2*i+1] = (short)-s[2*i];
+    }
+}
+
+static void checkHashSink(unsigned int channel, const short *buf, unsigned int frames, unsigned int channels, void *userdata)
+{
+    uint64_t *hash = &((uint64_t *)userdata)[channel];
+
+    for(unsigned int i=0; i<frames * channels; i++) *hash = (*hash ^ (uint16_t)buf[i]) * 1099511628211ull;
+}
+
+// 16 bit stereo wav of a triangle, for the stream
+static int checkWriteWav(const char *path, unsigned int frequency, unsigned int frames)
+{
+    uint8_t hdr[44] = { 'R','I','F','F', 0,0,0,0, 'W','A','V','E', 'f','m','t',' ', 16,0,0,0, 1,0, 2,0,
+                        0,0,0,0, 0,0,0,0, 4,0, 16,0, 'd','a','t','a', 0,0,0,0 };
+    uint32_t data = frames * 4, fields[4] = { 36 + data, frequency, frequency * 4, data };
+    FILE    *f = fopen(path, "wb");
+
+    if(!f) return -1;
+    for(int k=0; k<4; k++)
+        for(int b=0; b<4; b++) hdr[(k == 0 ? 4 : k == 1 ? 24 : k == 2 ? 28 : 40) + b] = (uint8_t)(fields[k] >> (8 * b));
+    fwrite(hdr, 1, sizeof(hdr), f);
+    for(unsigned int i=0; i<frames; i++)
+    {
+        short v[2] = { (short)(abs((int)(i * 150 % 24000) - 12000)), (short)(6000 - (int)(i * 40 % 12000)) };
+        fwrite(v, sizeof(v), 1, f);
+    }
+    return fclose(f);
+}
+
+/*
+ * One render of the scene: a callback with EQ and limiter, voices in PCM and
+ * ADPCM at other pitches, a 44.1 kHz stream resampled to the port, and a
+ * volume change, a pause and a new voice halfway. Hashes per channel, or of
+ * the master alone with the mixer.
+ */
+static void checkScene(int mixer, const char *wav, const OrbisAudioSound *pcm, const OrbisAudioSound *adpcm, uint64_t *hash)
+{
+    unsigned int   phase = 0;
+    OrbisAudioDsp *dsp;
+
+    for(int c=0; c<=ORBISAUDIO_CHANNEL_MASTER; c++) hash[c] = 14695981039346656037ull;
+
+    orbisAudioSetBackend(ORBISAUDIO_BACKEND_OFFLINE, NULL);
+    orbisAudioInit();
+    if(mixer) orbisAudioInitMixer(256, 48000);
+    for(unsigned int c=0; c<3; c++) orbisAudioResume(c);
+
+    orbisAudioSetCallback(0, checkSawCallback, &phase);
+    orbisAudioInitChannel(0, 256, 48000, ORBISAUDIO_FORMAT_S16_STEREO);
+    dsp = orbisAudioInitDsp(0);
+    if(dsp)
+    {
+        orbisAudioDspSetEq(dsp, 0, ORBISAUDIO_EQ_PEAK, 1000.0f, 6.0f, 1.0f);
+        orbisAudioDspSetLimiter(dsp, 1, -3.0f, 50.0f);
+    }
+
+    orbisAudioInitChannel(1, 512, 48000, ORBISAUDIO_FORMAT_S16_STEREO);
+    orbisAudioInitVoices(1, 8);
+    if(!dsp || orbisAudioVoicePlay(1, pcm, 0.7f, -0.5f, 1.0f, 1) < 0 || orbisAudioVoicePlay(1, adpcm, 0.5f, 0.3f, 1.37f, 1) < 0)
+    {
+        printf("Offline %s: can't set up the dsp or the voices\n", mixer ? "mixer" : "per channel");
+        checkFailures++;
+    }
+
+    orbisAudioInitChannel(2, 256, 44100, ORBISAUDIO_FORMAT_S16_STEREO);
+    if(orbisAudioStreamOpen(2, wav, ORBISAUDIO_STREAM_LOOP) < 0)
+    {
+        printf("Offline %s: can't stream %s\n", mixer ? "mixer" : "per channel", wav);
+        checkFailures++;
+    }
+
+    orbisAudioRenderOffline(0.3, checkHashSink, hash);
+    orbisAudioSetVolume(0, 20000, 12000);
+    orbisAudioPause(2);
+    orbisAudioVoicePlay(1, pcm, 0.4f, 0.8f, 0.61f, 0);
+    orbisAudioRenderOffline(0.3, checkHashSink, hash);
+
+    orbisAudioFinish();
+}
+
+static void checkDeterminism(void)
+{
+    static short tone[2 * 6000];
+    static uint8_t packed[2 * 6000];
+    char wav[] = "/tmp/orbisAudioCheckXXXXXX";
+    OrbisAudioSound pcm, adpcm;
+    uint64_t a[ORBISAUDIO_CHANNEL_MASTER + 1], b[ORBISAUDIO_CHANNEL_MASTER + 1];
+    int fd;
+
+    for(unsigned int i=0; i<6000; i++)
+    {
+        tone[2*i]   = (short)(8000 * sin(i * 0.05));
+        tone[2*i+1] = (short)(8000 * sin(i * 0.031));
+    }
+    pcm   = (OrbisAudioSound){ .data = tone, .frames = 6000, .frequency = 48000, .channels = 2 };
+    adpcm = (OrbisAudioSound){ .data = (const short *)packed, .frames = 6000, .frequency = 32000, .channels = 1, .encoding = ORBISAUDIO_ENCODING_ADPCM };
+    orbisAudioAdpcmEncode(packed, tone, 6000, 1);
+
+    fd = mkstemp(wav);
+    if(fd < 0 || checkWriteWav(wav, 44100, 30000)) { printf("Offline: can't write %s\n", wav); checkFailures++; if(fd >= 0) { close(fd); unlink(wav); } return; }
+    close(fd);
+
+    for(int mixer=0; mixer<2; mixer++)
+    {
+        checkScene(mixer, wav, &pcm, &adpcm, a);
+        checkScene(mixer, wav, &pcm, &adpcm, b);
+        for(int c=0; c<=ORBISAUDIO_CHANNEL_MASTER; c++)
+        {
+            if(a[c] == b[c]) continue;
+            printf("Offline %s: channel %d renders differently twice\n", mixer ? "mixer" : "per channel", c);
+            checkFailures++;
+        }
+    }
+    unlink(wav);
+}
+
+/*
+ * ADPCM round trip, mono and stereo, on a length that ends in a partial
+ * block: the decode must keep CHECK_ADPCM_SNR and never stray more than
+ * CHECK_ADPCM_ERROR from the source (IMA trails fast noise), and
+ * seeking forward, backward and within a block, or decoding from a frame
+ * inside a block, must give the samples of the decode from the start.
+ */
+#define CHECK_ADPCM_FRAMES	1000
+#define CHECK_ADPCM_SNR		30.0 // dB, 35 to 42 measured
+#define CHECK_ADPCM_ERROR	4096 // worst sample, 3140 measured
+
+static void checkAdpcm(void)
+{
+    static short src[2 * CHECK_ADPCM_FRAMES], linear[2 * CHECK_ADPCM_FRAMES], part[2 * CHECK_ADPCM_FRAMES];
+    static uint8_t packed[2 * CHECK_ADPCM_FRAMES];
+    static const unsigned int seeks[][2] = { { 300, 100 }, { 700, 300 }, { 40, 200 }, { 260, 5 }, { 900, CHECK_ADPCM_FRAMES - 900 }, { 513, 0 }, { 0, 64 } };
+
+    for(unsigned int sc=1; sc<=2; sc++)
+    {
+        OrbisAudioSound      sound = { .data = (const short *)packed, .frames = CHECK_ADPCM_FRAMES, .frequency = 48000, .channels = sc, .encoding = ORBISAUDIO_ENCODING_ADPCM };
+        OrbisAudioAdpcmState st = { .next = ~0u };
+        int                  worst = 0;
+        double               err = 0.0, sig = 0.0;
+
+        for(unsigned int i=0; i<CHECK_ADPCM_FRAMES * sc; i++)
+            src[i] = (short)(12000 * sin(i / sc * (0.02 + 0.03 * (i % sc))) + (int)(checkRand() % 1001) - 500);
+
+        if(orbisAudioAdpcmBytes(CHECK_ADPCM_FRAMES, sc) > sizeof(packed) || orbisAudioAdpcmEncode(packed, src, CHECK_ADPCM_FRAMES, sc) < 0 ||
+           orbisAudioAdpcmDecode(linear, &sound, 0, CHECK_ADPCM_FRAMES) < 0)
+        {
+            printf("ADPCM %u ch: encode or decode refused %u frames\n", sc, CHECK_ADPCM_FRAMES);
+            checkFailures++;
+            continue;
+        }
+        for(unsigned int i=0; i<CHECK_ADPCM_FRAMES * sc; i++)
+        {
+            int d = abs(linear[i] - src[i]);
+            if(d > worst) worst = d;
+            err += (double)d * d;
+            sig += (double)src[i] * src[i];
+        }
+        if(worst > CHECK_ADPCM_ERROR || err * pow(10.0, CHECK_ADPCM_SNR / 10.0) > sig)
+        {
+            printf("ADPCM %u ch: decode is %d off the source at worst, snr %.1f dB\n", sc, worst, 10.0 * log10(sig / (err + 1.0)));
+            checkFailures++;
+        }
+
+        // frames decode the same however they are reached
+        for(unsigned int k=0; k<sizeof(seeks)/sizeof(seeks[0]); k++)
+        {
+            unsigned int first = seeks[k][0], frames = seeks[k][1];
+            char name[64];
+
+            orbisAudioAdpcmSeek(&st, &sound, first);
+            orbisAudioAdpcmRead(&st, &sound, part, frames);
+            snprintf(name, sizeof(name), "ADPCM %u ch seek to %u", sc, first);
+            checkS16(name, linear + first * sc, part, frames * sc, frames);
+
+            if(orbisAudioAdpcmDecode(part, &sound, first, frames) < 0)
+            {
+                printf("ADPCM %u ch: decode from %u refused\n", sc, first);
+                checkFailures++;
+                continue;
+            }
+            snprintf(name, sizeof(name), "ADPCM %u ch decode from %u", sc, first);
+            checkS16(name, linear + first * sc, part, frames * sc, frames);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    for(int i=1; i<argc; i++)
+    {
+        if(!strcmp(argv[i], "-s") && i + 1 < argc) checkSeed = (uint32_t)strtoul(argv[++i], NULL, 0) | 1;
+        else { fprintf(stderr, "usage: %s [-s seed]\n", argv[0]); return 2; }
+    }
+
+    checkMix();
+    checkGains();
+    checkExpand();
+    checkConvert();
+    checkDownmix();
+    checkEmitters();
+    checkResampler();
+    checkAdpcm();
+    checkControls();
+    checkDeterminism();
+
+    if(checkFailures)
+    {
+        printf("%u check(s) failed\n", checkFailures);
+        return 1;
+    }
+    printf("all kernels match their reference, resampler, ADPCM, controls and offline renders ok\n");
+    return 0;
+}